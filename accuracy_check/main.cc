@@ -0,0 +1,148 @@
+/*
+ * Randomized check of CoverageAccuracy (btb/accuracy.h).
+ *
+ * CoverageAccuracy answers "how many distinct branches of the victim's set are accessed
+ * before its next use" with a forward sweep over a Fenwick tree. This tool compares it with
+ * the direct implementation it replaced (a std::set of access times per branch and a walk
+ * over every timestamp of the reuse window) on random OPT access records, with the same
+ * monotonic query times the BTBs produce. It exits with 1 on the first mismatch.
+ *
+ * Usage: accuracy_check [-seed N] [-rounds N]
+ */
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+#include "../btb/accuracy.h"
+
+// The std::set implementation CoverageAccuracy replaced.
+class ReferenceCoverageAccuracy {
+    vector<unordered_map<uint64_t, uint64_t>> access_record; // key: timestamp, value: ip
+    unordered_map<uint64_t, set<uint64_t>> future_accesses;
+    uint64_t total_sets;
+
+public:
+    ReferenceCoverageAccuracy(const vector<std::pair<uint64_t, uint64_t>> &accesses, uint64_t num_sets) :
+            access_record(num_sets), total_sets(num_sets) {
+        for (auto &access : accesses) {
+            future_accesses[access.first].insert(access.second);
+            access_record[find_set_index(access.first)].emplace(access.second, access.first);
+        }
+    }
+
+    uint64_t find_set_index(uint64_t ip) {
+        return ((ip >> 2) & (total_sets - 1));
+    }
+
+    uint64_t get_reuse_distance(uint64_t ip, uint64_t curr_time) {
+        auto it = future_accesses[ip].upper_bound(curr_time);
+        if (it == future_accesses[ip].end()) {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        unordered_set<uint64_t> unique_cache_lines;
+        for (uint64_t i = curr_time + 1; i < *it; i++) {
+            auto taken_access_it = access_record[find_set_index(ip)].find(i);
+            if (taken_access_it != access_record[find_set_index(ip)].end()) {
+                unique_cache_lines.insert(taken_access_it->second);
+            }
+        }
+        return unique_cache_lines.size();
+    }
+};
+
+// One random record and query sequence; returns false on a mismatch.
+bool check_round(std::mt19937_64 &rng, uint64_t round) {
+    const uint64_t num_sets = 1ULL << (rng() % 4);
+    const uint64_t num_ways = 1 + rng() % 8;
+    const uint64_t num_ips = 4 + rng() % 200;
+    const uint64_t num_accesses = 1 + rng() % 5000;
+
+    vector<uint64_t> ips(num_ips);
+    for (auto &ip : ips) ip = 0x400000 + (rng() % 100000) * 4;
+    // Like OPT records, several taken accesses can share a timestamp gap, but times only grow.
+    vector<std::pair<uint64_t, uint64_t>> accesses;
+    uint64_t time = 0;
+    for (uint64_t i = 0; i < num_accesses; i++) {
+        time += 1 + rng() % 3;
+        accesses.emplace_back(ips[rng() % num_ips], time);
+    }
+
+    FILE *record = tmpfile();
+    OptAccessWriter writer;
+    writer.open(record);
+    for (auto &access : accesses) writer.append(access.first, access.second);
+    writer.close();
+
+    CoverageAccuracy accuracy;
+    accuracy.init(record, num_sets, num_ways);
+    fclose(record);
+    ReferenceCoverageAccuracy reference(accesses, num_sets);
+
+    uint64_t now = 0;
+    while (now <= time + 2) {
+        auto ip = ips[rng() % num_ips];
+        auto expected = reference.get_reuse_distance(ip, now);
+        auto actual = accuracy.get_reuse_distance(ip, now, false);
+        if (expected != actual) {
+            cerr << "Round " << round << ": ip " << std::hex << ip << std::dec << " at " << now
+                 << " expected " << expected << " got " << actual << endl;
+            return false;
+        }
+        now += rng() % 4;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint64_t seed = 1, rounds = 200;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"seed", required_argument, 0, 's'},
+            {"rounds", required_argument, 0, 'r'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 's':
+                seed = atol(optarg);
+                break;
+            case 'r':
+                rounds = atol(optarg);
+                break;
+            default:
+                abort();
+        }
+    }
+
+    std::mt19937_64 rng(seed);
+    for (uint64_t round = 0; round < rounds; round++) {
+        if (!check_round(rng, round)) {
+            return 1;
+        }
+    }
+    cout << "CoverageAccuracy matches the reference in " << rounds << " rounds" << endl;
+    return 0;
+}
@@ -21,6 +21,16 @@ uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t a
     return prediction;
 }
 
+uint8_t O3_CPU::peek_direction(uint64_t ip)
+{
+    return predict_branch(ip, 0, 0, 0);
+}
+
+string O3_CPU::branch_predictor_name()
+{
+    return "bimodal";
+}
+
 void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
 {
     uint32_t hash = ip % BIMODAL_PRIME;
@@ -30,3 +40,13 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
     else if ((taken == 0) && (bimodal_table[cpu][hash] > 0))
         bimodal_table[cpu][hash]--;
 }
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    // no history: the table index only depends on ip
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    last_branch_result(ip, branch_target, taken, branch_type);
+}
@@ -1,3 +1,5 @@
+#include <deque>
+
 #include "ooo_cpu.h"
 
 #define GLOBAL_HISTORY_LENGTH 14
@@ -7,6 +9,8 @@ int branch_history_vector[NUM_CPUS];
 #define GS_HISTORY_TABLE_SIZE 16384
 int gs_history_table[NUM_CPUS][GS_HISTORY_TABLE_SIZE];
 int my_last_prediction[NUM_CPUS];
+// -bp_update_delay: table index of each branch whose counter is not trained yet, oldest first
+std::deque<int> gs_pending_hash[NUM_CPUS];
 
 void O3_CPU::initialize_branch_predictor()
 {
@@ -45,6 +49,18 @@ uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t a
     return prediction;
 }
 
+uint8_t O3_CPU::peek_direction(uint64_t ip)
+{
+    int gs_hash = gs_table_hash(ip, branch_history_vector[cpu]);
+
+    return gs_history_table[cpu][gs_hash] >= 2 ? 1 : 0;
+}
+
+string O3_CPU::branch_predictor_name()
+{
+    return "gshare";
+}
+
 void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
 {
     int gs_hash = gs_table_hash(ip, branch_history_vector[cpu]);
@@ -62,3 +78,27 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
     branch_history_vector[cpu] &= GLOBAL_HISTORY_MASK;
     branch_history_vector[cpu] |= taken;
 }
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    // the counter this branch was predicted with
+    gs_pending_hash[cpu].push_back(gs_table_hash(ip, branch_history_vector[cpu]));
+
+    branch_history_vector[cpu] <<= 1;
+    branch_history_vector[cpu] &= GLOBAL_HISTORY_MASK;
+    branch_history_vector[cpu] |= taken;
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    int gs_hash = gs_pending_hash[cpu].front();
+    gs_pending_hash[cpu].pop_front();
+
+    if(taken == 1) {
+        if(gs_history_table[cpu][gs_hash] < 3)
+            gs_history_table[cpu][gs_hash]++;
+    } else {
+        if(gs_history_table[cpu][gs_hash] > 0)
+            gs_history_table[cpu][gs_hash]--;
+    }
+}
@@ -51,6 +51,7 @@ sources for you to plagiarize.
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
+#include <deque>
 
 #include "ooo_cpu.h"
 
@@ -105,6 +106,15 @@ int
 // perceptron sum
 	yout[NUM_CPUS];
 
+// -bp_update_delay: indices and sum of each branch whose weights are not trained yet, oldest first
+
+struct hp_prediction {
+	unsigned int indices[NTABLES];
+	int yout;
+};
+
+std::deque<hp_prediction> pending_predictions[NUM_CPUS];
+
 void O3_CPU::initialize_branch_predictor () {
 	// zero out the weights tables
 
@@ -173,14 +183,63 @@ uint8_t O3_CPU::predict_branch(uint64_t pc, uint64_t predicted_target, uint8_t a
 	return yout[cpu] >= 1;
 }
 
-void O3_CPU::last_branch_result(uint64_t pc, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+uint8_t O3_CPU::peek_direction(uint64_t pc) {
 
-	// was this prediction correct?
+	// same sum as predict_branch, kept local so update still sees the last prediction
+
+	int sum = 0;
+
+	// for each table...
+
+	for (int i=0; i<NTABLES; i++) {
+
+		// n is the history length for this table
+
+		int n = history_lengths[i];
+
+		// hash global history bits 0..n-1 into x by XORing the words from the ghist_words array
+
+		unsigned int x = 0;
+
+		// most of the words are 12 bits long
+
+		int most_words = n / LOG_TABLE_SIZE;
+
+		// the last word is fewer than 12 bits
+
+		int last_word = n % LOG_TABLE_SIZE;
+
+		// XOR up to the next-to-the-last word
+
+		int j;
+		for (j=0; j<most_words; j++) x ^= ghist_words[cpu][j];
+
+		// XOR in the last word
+
+		x ^= ghist_words[cpu][j] & ((1<<last_word)-1);
+
+		// XOR in the PC to spread accesses around (like gshare)
+
+		x ^= pc;
+
+		// stay within the table size
+
+		x &= TABLE_SIZE-1;
+
+		// add the selected weight to the perceptron sum
+
+		sum += tables[cpu][i][x];
+	}
+	return sum >= 1;
+}
 
-	bool correct = taken == (yout[cpu] >= 1);
+string O3_CPU::branch_predictor_name() {
+	return "hashed_perceptron";
+}
 
-	// insert this branch outcome into the global history
+// insert a branch outcome into the global history
 
+static void update_ghist(int cpu, bool taken) {
 	bool b = taken;
 	for (int i=0; i<NGHIST_WORDS; i++) {
 
@@ -194,10 +253,19 @@ void O3_CPU::last_branch_result(uint64_t pc, uint64_t branch_target, uint8_t tak
 		b = !!(ghist_words[cpu][i] & TABLE_SIZE);
 		ghist_words[cpu][i] &= TABLE_SIZE-1;
 	}
+}
+
+// train the weights a prediction used, given its indices and sum
+
+static void train_weights(int cpu, const unsigned int *idx, int y, bool taken) {
+
+	// was this prediction correct?
+
+	bool correct = taken == (y >= 1);
 
 	// get the magnitude of yout
 
-	int a = (yout[cpu] < 0) ? -yout[cpu] : yout[cpu];
+	int a = (y < 0) ? -y : y;
 
 	// perceptron learning rule: train if misprediction or weak correct prediction
 
@@ -206,7 +274,7 @@ void O3_CPU::last_branch_result(uint64_t pc, uint64_t branch_target, uint8_t tak
 		for (int i=0; i<NTABLES; i++) {
 			// which weight did we use to compute yout?
 
-			int *c = &tables[cpu][i][indices[cpu][i]];
+			int *c = &tables[cpu][i][idx[i]];
 
 			// increment if taken, decrement if not, saturating at 127/-128
 
@@ -240,3 +308,25 @@ void O3_CPU::last_branch_result(uint64_t pc, uint64_t branch_target, uint8_t tak
 		}
 	}
 }
+
+void O3_CPU::last_branch_result(uint64_t pc, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+	update_ghist(cpu, taken);
+	train_weights(cpu, indices[cpu], yout[cpu], taken);
+}
+
+void O3_CPU::update_branch_history(uint64_t pc, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+
+	// keep the indices and the sum of this prediction for train_branch
+
+	hp_prediction p;
+	memcpy(p.indices, indices[cpu], sizeof(p.indices));
+	p.yout = yout[cpu];
+	pending_predictions[cpu].push_back(p);
+	update_ghist(cpu, taken);
+}
+
+void O3_CPU::train_branch(uint64_t pc, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+	const hp_prediction &p = pending_predictions[cpu].front();
+	train_weights(cpu, p.indices, p.yout, taken);
+	pending_predictions[cpu].pop_front();
+}
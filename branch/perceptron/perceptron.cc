@@ -137,7 +137,13 @@ perceptron_state
 int 
 	/* index of the next "free" perceptron_state */
 
-	perceptron_state_buf_ctr[NUM_CPUS];
+	perceptron_state_buf_ctr[NUM_CPUS],
+
+	/* index of the oldest perceptron_state not trained yet (-bp_update_delay) */
+
+	perceptron_state_train_ctr[NUM_CPUS];
+
+extern uint64_t bp_update_delay;
 
 unsigned long long int
 
@@ -163,6 +169,12 @@ void O3_CPU::initialize_branch_predictor()
     spec_global_history[cpu] = 0;
     global_history[cpu] = 0;
     perceptron_state_buf_ctr[cpu] = 0;
+    perceptron_state_train_ctr[cpu] = 0;
+    if (bp_update_delay >= NUM_UPDATE_ENTRIES) {
+        cerr << "-bp_update_delay " << bp_update_delay << ": the perceptron keeps "
+             << NUM_UPDATE_ENTRIES << " branches in flight" << endl;
+        exit(1);
+    }
     for (int i=0; i<NUM_PERCEPTRONS; i++)
         initialize_perceptron (&perceptrons[cpu][i]);
 }
@@ -234,8 +246,31 @@ uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t a
     return u[cpu]->prediction;
 }
 
-void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+uint8_t O3_CPU::peek_direction(uint64_t ip)
 {
+    /* same dot product as predict_branch, without taking a perceptron_state
+     * or updating the speculative history
+     */
+    int *w = &perceptrons[cpu][ip % NUM_PERCEPTRONS].weights[0];
+    int output = *w++;
+    unsigned long long int mask;
+    int i;
+    for (mask=1,i=0; i<PERCEPTRON_HISTORY; i++,mask<<=1,w++) {
+        if (spec_global_history[cpu] & mask)
+            output += *w;
+        else
+            output += -*w;
+    }
+    return output >= 0;
+}
+
+string O3_CPU::branch_predictor_name()
+{
+    return "perceptron";
+}
+
+/* train the perceptron that made the prediction in state s */
+void train_perceptron (perceptron_state *s, int taken) {
     int	
         i,
         y, 
@@ -245,25 +280,14 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
         mask, 
         history;
 
-    /* update the real global history shift register */
-
-    global_history[cpu] <<= 1;
-    global_history[cpu] |= taken;
-
-    /* if this branch was mispredicted, restore the speculative
-     * history to the last known real history
-     */
-
-    if (u[cpu]->prediction != taken) spec_global_history[cpu] = global_history[cpu];
-
     /* if the output of the perceptron predictor is outside of
      * the range [-THETA,THETA] *and* the prediction was correct,
      * then we don't need to adjust the weights
      */
 
-    if (u[cpu]->output > THETA)
+    if (s->output > THETA)
         y = 1;
-    else if (u[cpu]->output < -THETA)
+    else if (s->output < -THETA)
         y = 0;
     else
         y = 2;
@@ -272,7 +296,7 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
 
     /* w is a pointer to the first weight (the bias weight) */
 
-    w = &u[cpu]->perc->weights[0];
+    w = &s->perc->weights[0];
 
     /* if the branch was taken, increment the bias weight,
      * else decrement it, with saturating arithmetic
@@ -291,7 +315,7 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
 
     /* get the history that led to this prediction */
 
-    history = u[cpu]->history;
+    history = s->history;
 
     /* for each weight and corresponding bit in the history register... */
 
@@ -311,3 +335,35 @@ void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t tak
         }
     }
 }
+
+void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    update_branch_history(ip, branch_target, taken, branch_type);
+    train_perceptron(u[cpu], taken);
+}
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    /* update the real global history shift register */
+
+    global_history[cpu] <<= 1;
+    global_history[cpu] |= taken;
+
+    /* if this branch was mispredicted, restore the speculative
+     * history to the last known real history
+     */
+
+    if (u[cpu]->prediction != taken) spec_global_history[cpu] = global_history[cpu];
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+    /* branches are trained in fetch order, so the state of this one is
+     * the oldest untrained perceptron_state
+     */
+
+    perceptron_state *s = &perceptron_state_buf[cpu][perceptron_state_train_ctr[cpu]++];
+    if (perceptron_state_train_ctr[cpu] >= NUM_UPDATE_ENTRIES)
+        perceptron_state_train_ctr[cpu] = 0;
+    train_perceptron(s, taken);
+}
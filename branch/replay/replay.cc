@@ -0,0 +1,59 @@
+#include "ooo_cpu.h"
+#include "branch_outcome_record.h"
+#include "direction_memo.h"
+
+/*
+ * Replays the predictions of another direction predictor from its branch outcome record
+ * (branch_outcome_record.h) instead of computing them. Run that predictor's binary once with
+ * -record_branch_outcomes, then any BTB variant linked with this module and given the same
+ * -replay_branch_predictor, trace, lengths and -bp_update_delay sees the same predictions for free.
+ */
+
+extern string replay_branch_predictor;
+extern BranchOutcomeRecord branch_outcome_record[NUM_CPUS];
+extern uint64_t bp_update_delay;
+
+// Last replayed direction per branch, for peek_direction.
+DirectionMemo<12> replay_direction_memo[NUM_CPUS];
+
+void O3_CPU::initialize_branch_predictor()
+{
+    cout << "CPU " << cpu << " Replay branch predictor" << endl;
+}
+
+uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type)
+{
+    // The trace name is only known after construction, so open the record on first use.
+    if (!branch_outcome_record[cpu].is_replaying())
+        branch_outcome_record[cpu].open_replay(find_trace_short_name(trace_name, O3_CPU::NameKind::TRACE),
+                                               replay_branch_predictor, cpu, warmup_instructions,
+                                               simulation_instructions, bp_update_delay);
+    uint8_t prediction = branch_outcome_record[cpu].replay();
+    replay_direction_memo[cpu].record(ip, prediction);
+    return prediction;
+}
+
+uint8_t O3_CPU::peek_direction(uint64_t ip)
+{
+    uint8_t prediction;
+    if (replay_direction_memo[cpu].lookup(ip, prediction))
+        return prediction;
+    return 0;
+}
+
+string O3_CPU::branch_predictor_name()
+{
+    return "replay";
+}
+
+void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+}
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type)
+{
+}
@@ -0,0 +1,207 @@
+// Batched TAGE-SC-L index and tag hashing.
+//
+// Tagepred hashes every TAGE bank, and GetPrediction every SC GEHL table, with the same
+// formula and per-bank constants. The banks are laid out as lanes: the constants are
+// computed once at reinit, the per-branch inputs are copied in, and one kernel computes
+// every lane. The AVX2 kernels are picked at run time on CPUs that have AVX2; the scalar
+// kernels are the reference and give bit-identical results (define TAGE_SC_L_SCALAR to
+// force them).
+
+#ifndef TAGE_SC_L_BATCHED_HASH_H
+#define TAGE_SC_L_BATCHED_HASH_H
+
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(TAGE_SC_L_SCALAR)
+#define TAGE_SC_L_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef TAGE_SC_L_AVX2
+// Lanes i to i + 3 (64-bit) or i + 7 (32-bit) of an array of lanes.
+#define TAGE_SC_L_LOAD(lanes) _mm256_loadu_si256((const __m256i *) ((lanes) + i))
+
+static bool tage_sc_l_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+// TAGE banks: index = gindex() and tag = gtag() of the bank, including the path history mix F().
+struct TageHashLanes {
+    static const int LANES = 24; // a multiple of 8 32-bit lanes
+
+    int count = 0;
+    // per-bank constants
+    uint32_t path_mask[LANES] = {}; // path history bits used, (1 << min(m, PHISTWIDTH)) - 1
+    uint32_t index_bits[LANES] = {}; // logg
+    uint32_t index_mask[LANES] = {};
+    uint32_t rotate[LANES] = {}; // F rotates by the bank number when it is below logg
+    uint32_t rotate_back[LANES] = {}; // index_bits - rotate
+    uint32_t rotated[LANES] = {}; // all ones for rotated lanes
+    uint32_t pc_shift[LANES] = {}; // abs(logg - bank) + 1
+    uint32_t tag_mask[LANES] = {};
+    // per-branch inputs, the folded histories of the bank
+    uint32_t comp_index[LANES] = {};
+    uint32_t comp_tag0[LANES] = {};
+    uint32_t comp_tag1[LANES] = {};
+    // outputs
+    uint32_t index[LANES] = {};
+    uint32_t tag[LANES] = {};
+
+    void add(int bank, int path_bits, int logg, int tag_bits) {
+        path_mask[count] = (1u << path_bits) - 1;
+        index_bits[count] = logg;
+        index_mask[count] = (1u << logg) - 1;
+        rotate[count] = bank < logg ? bank : 0;
+        rotate_back[count] = logg - rotate[count];
+        rotated[count] = bank < logg ? ~0u : 0;
+        pc_shift[count] = (bank > logg ? bank - logg : logg - bank) + 1;
+        tag_mask[count] = (1u << tag_bits) - 1;
+        count++;
+    }
+
+    void hash_scalar(uint32_t pc, uint32_t path) {
+        for (int i = 0; i < count; i++) {
+            uint32_t a = path & path_mask[i];
+            uint32_t a1 = a & index_mask[i];
+            uint32_t a2 = a >> index_bits[i];
+            if (rotated[i]) {
+                a2 = ((a2 << rotate[i]) & index_mask[i]) + (a2 >> rotate_back[i]);
+            }
+            a = a1 ^ a2;
+            if (rotated[i]) {
+                a = ((a << rotate[i]) & index_mask[i]) + (a >> rotate_back[i]);
+            }
+            index[i] = (pc ^ (pc >> pc_shift[i]) ^ comp_index[i] ^ a) & index_mask[i];
+            tag[i] = (pc ^ comp_tag0[i] ^ (comp_tag1[i] << 1)) & tag_mask[i];
+        }
+    }
+
+#ifdef TAGE_SC_L_AVX2
+    __attribute__((target("avx2"))) void hash_avx2(uint32_t pc, uint32_t path) {
+        const __m256i pcs = _mm256_set1_epi32(pc);
+        const __m256i paths = _mm256_set1_epi32(path);
+        for (int i = 0; i < count; i += 8) {
+            const __m256i mask = TAGE_SC_L_LOAD(index_mask);
+            const __m256i rot = TAGE_SC_L_LOAD(rotate);
+            const __m256i back = TAGE_SC_L_LOAD(rotate_back);
+            const __m256i is_rotated = TAGE_SC_L_LOAD(rotated);
+
+            __m256i a = _mm256_and_si256(paths, TAGE_SC_L_LOAD(path_mask));
+            __m256i a1 = _mm256_and_si256(a, mask);
+            __m256i a2 = _mm256_srlv_epi32(a, TAGE_SC_L_LOAD(index_bits));
+            __m256i a2_rotated = _mm256_add_epi32(_mm256_and_si256(_mm256_sllv_epi32(a2, rot), mask),
+                                                  _mm256_srlv_epi32(a2, back));
+            a2 = _mm256_blendv_epi8(a2, a2_rotated, is_rotated);
+            a = _mm256_xor_si256(a1, a2);
+            __m256i a_rotated = _mm256_add_epi32(_mm256_and_si256(_mm256_sllv_epi32(a, rot), mask),
+                                                 _mm256_srlv_epi32(a, back));
+            a = _mm256_blendv_epi8(a, a_rotated, is_rotated);
+
+            __m256i idx = _mm256_xor_si256(pcs, _mm256_srlv_epi32(pcs, TAGE_SC_L_LOAD(pc_shift)));
+            idx = _mm256_xor_si256(idx, _mm256_xor_si256(TAGE_SC_L_LOAD(comp_index), a));
+            _mm256_storeu_si256((__m256i *) (index + i), _mm256_and_si256(idx, mask));
+
+            __m256i t = _mm256_xor_si256(pcs, TAGE_SC_L_LOAD(comp_tag0));
+            t = _mm256_xor_si256(t, _mm256_slli_epi32(TAGE_SC_L_LOAD(comp_tag1), 1));
+            _mm256_storeu_si256((__m256i *) (tag + i), _mm256_and_si256(t, TAGE_SC_L_LOAD(tag_mask)));
+        }
+    }
+#endif
+
+    void hash(uint32_t pc, uint32_t path) {
+#ifdef TAGE_SC_L_AVX2
+        if (tage_sc_l_has_avx2()) {
+            hash_avx2(pc, path);
+            return;
+        }
+#endif
+        hash_scalar(pc, path);
+    }
+};
+
+// SC GEHL tables: index = GINDEX of table i of its GEHL component.
+struct GehlHashLanes {
+    static const int LANES = 20; // a multiple of 4 64-bit lanes
+
+    int count = 0;
+    // per-table constants
+    int64_t history_mask[LANES] = {};
+    uint64_t shift[5][LANES] = {}; // 8 - i, 16 - 2i, 24 - 3i, 32 - 3i, 40 - 4i
+    int64_t index_mask[LANES] = {};
+    int8_t *table[LANES] = {};
+    // per-branch inputs
+    int64_t pc[LANES] = {};
+    int64_t history[LANES] = {};
+    // outputs
+    int64_t index[LANES] = {};
+
+    // Adds the NBR tables of a GEHL component and returns its first lane.
+    int add(int *length, int8_t **tab, int NBR, int logs) {
+        int first = count;
+        for (int i = 0; i < NBR; i++) {
+            // The original mask (1 << length[i]) - 1 shifts an int, which x86 does modulo 32.
+            history_mask[count] = (int64_t) (int) ((1u << (length[i] & 31)) - 1);
+            shift[0][count] = 8 - i;
+            shift[1][count] = 16 - 2 * i;
+            shift[2][count] = 24 - 3 * i;
+            shift[3][count] = 32 - 3 * i;
+            shift[4][count] = 40 - 4 * i;
+            index_mask[count] = (1 << (logs - (i >= (NBR - 2)))) - 1;
+            table[count] = tab[i];
+            count++;
+        }
+        return first;
+    }
+
+    void set(int first, int NBR, int64_t component_pc, int64_t component_history) {
+        for (int i = first; i < first + NBR; i++) {
+            pc[i] = component_pc;
+            history[i] = component_history;
+        }
+    }
+
+    void hash_scalar() {
+        for (int i = 0; i < count; i++) {
+            int64_t bhist = history[i] & history_mask[i];
+            index[i] = (pc[i] ^ bhist ^ (bhist >> shift[0][i]) ^ (bhist >> shift[1][i]) ^ (bhist >> shift[2][i]) ^
+                        (bhist >> shift[3][i]) ^ (bhist >> shift[4][i])) & index_mask[i];
+        }
+    }
+
+#ifdef TAGE_SC_L_AVX2
+    // The masked histories are not negative, so logical shifts match the scalar arithmetic ones.
+    __attribute__((target("avx2"))) void hash_avx2() {
+        for (int i = 0; i < count; i += 4) {
+            __m256i bhist = _mm256_and_si256(TAGE_SC_L_LOAD(history), TAGE_SC_L_LOAD(history_mask));
+            __m256i idx = _mm256_xor_si256(TAGE_SC_L_LOAD(pc), bhist);
+            for (auto &s : shift) {
+                idx = _mm256_xor_si256(idx, _mm256_srlv_epi64(bhist, TAGE_SC_L_LOAD(s)));
+            }
+            _mm256_storeu_si256((__m256i *) (index + i), _mm256_and_si256(idx, TAGE_SC_L_LOAD(index_mask)));
+        }
+    }
+#endif
+
+    void hash() {
+#ifdef TAGE_SC_L_AVX2
+        if (tage_sc_l_has_avx2()) {
+            hash_avx2();
+            return;
+        }
+#endif
+        hash_scalar();
+    }
+
+    // Sum of the (2 * ctr + 1) of the component's tables, as Gpredict.
+    int sum(int first, int NBR) const {
+        int percsum = 0;
+        for (int i = first; i < first + NBR; i++) {
+            percsum += 2 * table[i][index[i]] + 1;
+        }
+        return percsum;
+    }
+};
+
+#endif //TAGE_SC_L_BATCHED_HASH_H
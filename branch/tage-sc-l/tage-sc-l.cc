@@ -1,4 +1,6 @@
 #include "ooo_cpu.h"
+#include "direction_memo.h"
+#include "batched_hash.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +17,7 @@
 #define PRINTSIZE
 
 #include <vector>
+#include <deque>
 
 long long IMLIcount;        // use to monitor the iteration number
 
@@ -297,6 +300,14 @@ int logg[NHIST + 1];
 int GI[NHIST + 1];        // indexes to the different tables are computed only once
 unsigned int GTAG[NHIST + 1];        // tags for the different tables are computed only once
 int BI;                // index of the bimodal table
+
+TageHashLanes tage_lanes;    // one lane per bank Tagepred hashes (the odd banks)
+GehlHashLanes gehl_lanes;    // one lane per SC GEHL table
+// first lanes of the GEHL components
+int GGEHL_LANE, PGEHL_LANE, LGEHL_LANE, SGEHL_LANE, TGEHL_LANE, IMGEHL_LANE, IGEHL_LANE;
+// the GEHL lanes hold the indices of this branch until the next history update
+bool gehl_lanes_valid = false;
+uint64_t gehl_lanes_pc;
 bool pred_taken;        // prediction
 bool alttaken;            // alternate  TAGEprediction
 bool tage_pred;            // TAGE prediction
@@ -444,6 +455,24 @@ predictorsize() {
 }
 
 
+// The state of one prediction that UpdateTables() trains with: the TAGE indices and tags, the
+// matching banks and confidences, the SC sum and GEHL indices, and the loop predictor lookup.
+struct TagePrediction {
+    int GI[NHIST + 1];
+    unsigned int GTAG[NHIST + 1];
+    int BI;
+    int8_t BIM;
+    bool LowConf, HighConf, MedConf, AltConf;
+    bool pred_taken, alttaken, tage_pred, LongestMatchPred, pred_inter;
+    int HitBank, AltBank;
+    int LSUM, THRES;
+    int64_t gehl_index[GehlHashLanes::LANES];
+#ifdef LOOPPREDICTOR
+    bool predloop, LVALID;
+    int LIB, LI, LHIT, LTAG;
+#endif
+};
+
 class PREDICTOR {
 public:
     int THRES;
@@ -701,6 +730,28 @@ public:
         ptghist = 0;
         phist = 0;
 
+        tage_lanes = TageHashLanes();
+        for (int i = 1; i <= NHIST; i += 2) {
+            int M = (m[i] > PHISTWIDTH) ? PHISTWIDTH : m[i];
+            tage_lanes.add(i, M, logg[i], TB[i]);
+        }
+        gehl_lanes = GehlHashLanes();
+        GGEHL_LANE = gehl_lanes.add(Gm, GGEHL, GNB, LOGGNB);
+        PGEHL_LANE = gehl_lanes.add(Pm, PGEHL, PNB, LOGPNB);
+#ifdef LOCALH
+        LGEHL_LANE = gehl_lanes.add(Lm, LGEHL, LNB, LOGLNB);
+#ifdef LOCALS
+        SGEHL_LANE = gehl_lanes.add(Sm, SGEHL, SNB, LOGSNB);
+#endif
+#ifdef LOCALT
+        TGEHL_LANE = gehl_lanes.add(Tm, TGEHL, TNB, LOGTNB);
+#endif
+#endif
+#ifdef IMLI
+        IMGEHL_LANE = gehl_lanes.add(IMm, IMGEHL, IMNB, LOGIMNB);
+        IGEHL_LANE = gehl_lanes.add(Im, IGEHL, INB, LOGINB);
+#endif
+        gehl_lanes_valid = false;
     }
 
 
@@ -713,44 +764,8 @@ public:
     }
 
 
-// the index functions for the tagged tables uses path history as in the OGEHL predictor
-//F serves to mix path history: not very important impact
-
-    int F(long long A, int size, int bank) {
-        int A1, A2;
-        A = A & ((1 << size) - 1);
-        A1 = (A & ((1 << logg[bank]) - 1));
-        A2 = (A >> logg[bank]);
-
-        if (bank < logg[bank])
-            A2 =
-                    ((A2 << bank) & ((1 << logg[bank]) - 1)) +
-                    (A2 >> (logg[bank] - bank));
-        A = A1 ^ A2;
-        if (bank < logg[bank])
-            A =
-                    ((A << bank) & ((1 << logg[bank]) - 1)) + (A >> (logg[bank] - bank));
-        return (A);
-    }
-
-// gindex computes a full hash of PC, ghist and phist
-    int gindex(unsigned int PC, int bank, long long hist,
-               folded_history *ch_i) {
-        int index;
-        int M = (m[bank] > PHISTWIDTH) ? PHISTWIDTH : m[bank];
-        index =
-                PC ^ (PC >> (abs(logg[bank] - bank) + 1))
-                ^ ch_i[bank].comp ^ F(hist, M, bank);
-
-        return (index & ((1 << (logg[bank])) - 1));
-    }
-
-    //  tag computation
-    uint16_t gtag(unsigned int PC, int bank, folded_history *ch0,
-                  folded_history *ch1) {
-        int tag = (PC) ^ch0[bank].comp ^(ch1[bank].comp << 1);
-        return (tag & ((1 << (TB[bank])) - 1));
-    }
+// the index functions for the tagged tables use path history as in the OGEHL predictor;
+// gindex, gtag and the path mix F are computed for all banks by TageHashLanes (batched_hash.h)
 
     // up-down saturating counter
     void ctrupdate(int8_t &ctr, bool taken, int nbits) {
@@ -800,9 +815,16 @@ public:
     void Tagepred(uint64_t PC) {
         HitBank = 0;
         AltBank = 0;
-        for (int i = 1; i <= NHIST; i += 2) {
-            GI[i] = gindex(PC, i, phist, ch_i);
-            GTAG[i] = gtag(PC, i, ch_t[0], ch_t[1]);
+        // gindex and gtag of the odd banks, all at once
+        for (int i = 1, lane = 0; i <= NHIST; i += 2, lane++) {
+            tage_lanes.comp_index[lane] = ch_i[i].comp;
+            tage_lanes.comp_tag0[lane] = ch_t[0][i].comp;
+            tage_lanes.comp_tag1[lane] = ch_t[1][i].comp;
+        }
+        tage_lanes.hash((unsigned int) PC, (uint32_t) (phist & ((1 << PHISTWIDTH) - 1)));
+        for (int i = 1, lane = 0; i <= NHIST; i += 2, lane++) {
+            GI[i] = tage_lanes.index[lane];
+            GTAG[i] = tage_lanes.tag[lane];
             GTAG[i + 1] = GTAG[i];
             GI[i + 1] = GI[i] ^ (GTAG[i] & ((1 << LOGG) - 1));
         }
@@ -915,23 +937,22 @@ public:
         LSUM = (1 + (WB[INDUPDS] >= 0)) * LSUM;
 #endif
 //integrate the GEHL predictions
-        LSUM +=
-                Gpredict((PC << 1) + pred_inter, GHIST, Gm, GGEHL, GNB, LOGGNB, WG);
-        LSUM += Gpredict(PC, phist, Pm, PGEHL, PNB, LOGPNB, WP);
+        GehlHash(PC);
+        LSUM += Gpredict(PC, GGEHL_LANE, GNB, WG);
+        LSUM += Gpredict(PC, PGEHL_LANE, PNB, WP);
 #ifdef LOCALH
-        LSUM += Gpredict(PC, L_shist[INDLOCAL], Lm, LGEHL, LNB, LOGLNB, WL);
+        LSUM += Gpredict(PC, LGEHL_LANE, LNB, WL);
 #ifdef LOCALS
-        LSUM += Gpredict(PC, S_slhist[INDSLOCAL], Sm, SGEHL, SNB, LOGSNB, WS);
+        LSUM += Gpredict(PC, SGEHL_LANE, SNB, WS);
 #endif
 #ifdef LOCALT
-        LSUM += Gpredict(PC, T_slhist[INDTLOCAL], Tm, TGEHL, TNB, LOGTNB, WT);
+        LSUM += Gpredict(PC, TGEHL_LANE, TNB, WT);
 #endif
 #endif
 
 #ifdef IMLI
-        LSUM +=
-                Gpredict(PC, IMHIST[(IMLIcount)], IMm, IMGEHL, IMNB, LOGIMNB, WIM);
-        LSUM += Gpredict(PC, IMLIcount, Im, IGEHL, INB, LOGINB, WI);
+        LSUM += Gpredict(PC, IMGEHL_LANE, IMNB, WIM);
+        LSUM += Gpredict(PC, IGEHL_LANE, INB, WI);
 #endif
         bool SCPRED = (LSUM >= 0);
 //just  an heuristic if the respective contribution of component groups can be multiplied by 2 or not
@@ -975,6 +996,7 @@ public:
                        uint64_t target, long long &X, int &Y,
                        folded_history *H, folded_history *G,
                        folded_history *J) {
+        gehl_lanes_valid = false;
         int brtype = 0;
 
         switch (opType) {
@@ -1107,6 +1129,75 @@ public:
 
     void UpdatePredictor(uint64_t PC, uint8_t opType, bool resolveDir,
                          bool predDir, uint64_t branchTarget) {
+        UpdateTables(PC, resolveDir);
+        HistoryUpdate(PC, opType, resolveDir, branchTarget,
+                      phist, ptghist, ch_i, ch_t[0], ch_t[1]);
+    }
+
+    // State of the last prediction, for a delayed UpdateTables().
+    void SavePrediction(TagePrediction &p) const {
+        memcpy(p.GI, GI, sizeof(GI));
+        memcpy(p.GTAG, GTAG, sizeof(GTAG));
+        p.BI = BI;
+        p.BIM = BIM;
+        p.LowConf = LowConf;
+        p.HighConf = HighConf;
+        p.MedConf = MedConf;
+        p.AltConf = AltConf;
+        p.pred_taken = pred_taken;
+        p.alttaken = alttaken;
+        p.tage_pred = tage_pred;
+        p.LongestMatchPred = LongestMatchPred;
+        p.pred_inter = pred_inter;
+        p.HitBank = HitBank;
+        p.AltBank = AltBank;
+        p.LSUM = LSUM;
+        p.THRES = THRES;
+        memcpy(p.gehl_index, gehl_lanes.index, sizeof(p.gehl_index));
+#ifdef LOOPPREDICTOR
+        p.predloop = predloop;
+        p.LVALID = LVALID;
+        p.LIB = LIB;
+        p.LI = LI;
+        p.LHIT = LHIT;
+        p.LTAG = LTAG;
+#endif
+    }
+
+    // Restores a saved prediction of PC; the next prediction recomputes all of it.
+    void RestorePrediction(uint64_t PC, const TagePrediction &p) {
+        memcpy(GI, p.GI, sizeof(GI));
+        memcpy(GTAG, p.GTAG, sizeof(GTAG));
+        BI = p.BI;
+        BIM = p.BIM;
+        LowConf = p.LowConf;
+        HighConf = p.HighConf;
+        MedConf = p.MedConf;
+        AltConf = p.AltConf;
+        pred_taken = p.pred_taken;
+        alttaken = p.alttaken;
+        tage_pred = p.tage_pred;
+        LongestMatchPred = p.LongestMatchPred;
+        pred_inter = p.pred_inter;
+        HitBank = p.HitBank;
+        AltBank = p.AltBank;
+        LSUM = p.LSUM;
+        THRES = p.THRES;
+        memcpy(gehl_lanes.index, p.gehl_index, sizeof(p.gehl_index));
+        gehl_lanes_valid = true;
+        gehl_lanes_pc = PC;
+#ifdef LOOPPREDICTOR
+        predloop = p.predloop;
+        LVALID = p.LVALID;
+        LIB = p.LIB;
+        LI = p.LI;
+        LHIT = p.LHIT;
+        LTAG = p.LTAG;
+#endif
+    }
+
+    // Trains the SC, loop and TAGE tables with the last (or restored) prediction of PC.
+    void UpdateTables(uint64_t PC, bool resolveDir) {
 
 
 #ifdef SC
@@ -1175,28 +1266,26 @@ public:
             ctrupdate(Bias[INDBIAS], resolveDir, PERCWIDTH);
             ctrupdate(BiasSK[INDBIASSK], resolveDir, PERCWIDTH);
             ctrupdate(BiasBank[INDBIASBANK], resolveDir, PERCWIDTH);
-            Gupdate((PC << 1) + pred_inter, resolveDir,
-                    GHIST, Gm, GGEHL, GNB, LOGGNB, WG);
-            Gupdate(PC, resolveDir, phist, Pm, PGEHL, PNB, LOGPNB, WP);
+            // the indices of the prediction, unless the histories moved since
+            if (!gehl_lanes_valid || gehl_lanes_pc != PC)
+                GehlHash(PC);
+            Gupdate(PC, GGEHL_LANE, resolveDir, GNB, WG);
+            Gupdate(PC, PGEHL_LANE, resolveDir, PNB, WP);
 #ifdef LOCALH
-            Gupdate(PC, resolveDir, L_shist[INDLOCAL], Lm, LGEHL, LNB, LOGLNB,
-                    WL);
+            Gupdate(PC, LGEHL_LANE, resolveDir, LNB, WL);
 #ifdef LOCALS
-            Gupdate(PC, resolveDir, S_slhist[INDSLOCAL], Sm,
-                    SGEHL, SNB, LOGSNB, WS);
+            Gupdate(PC, SGEHL_LANE, resolveDir, SNB, WS);
 #endif
 #ifdef LOCALT
 
-            Gupdate(PC, resolveDir, T_slhist[INDTLOCAL], Tm, TGEHL, TNB, LOGTNB,
-                    WT);
+            Gupdate(PC, TGEHL_LANE, resolveDir, TNB, WT);
 #endif
 #endif
 
 
 #ifdef IMLI
-            Gupdate(PC, resolveDir, IMHIST[(IMLIcount)], IMm, IMGEHL, IMNB,
-                    LOGIMNB, WIM);
-            Gupdate(PC, resolveDir, IMLIcount, Im, IGEHL, INB, LOGINB, WI);
+            Gupdate(PC, IMGEHL_LANE, resolveDir, IMNB, WIM);
+            Gupdate(PC, IGEHL_LANE, resolveDir, INB, WI);
 #endif
 
 
@@ -1375,49 +1464,48 @@ public:
                     gtable[HitBank][GI[HitBank]].u++;
             }
 //END TAGE UPDATE
-
-
-        HistoryUpdate(PC, opType, resolveDir, branchTarget,
-                      phist, ptghist, ch_i, ch_t[0], ch_t[1]);
-
-
-//END PREDICTOR UPDATE
-
-
     }
 
-#define GINDEX (((long long) PC) ^ bhist ^ (bhist >> (8 - i)) ^ (bhist >> (16 - 2 * i)) ^ (bhist >> (24 - 3 * i)) ^ (bhist >> (32 - 3 * i)) ^ (bhist >> (40 - 4 * i))) & ((1 << (logs - (i >= (NBR - 2)))) - 1)
-
-    int Gpredict(uint64_t PC, long long BHIST, int *length,
-                 int8_t **tab, int NBR, int logs, int8_t *W) {
-        int PERCSUM = 0;
-        for (int i = 0; i < NBR; i++) {
-            long long bhist = BHIST & ((long long) ((1 << length[i]) - 1));
-            long long index = GINDEX;
-
-            int8_t ctr = tab[i][index];
-
-            PERCSUM += (2 * ctr + 1);
-
+// GINDEX of every GEHL table (see GehlHashLanes):
+// (PC ^ bhist ^ (bhist >> (8 - i)) ^ (bhist >> (16 - 2 * i)) ^ (bhist >> (24 - 3 * i)) ^ (bhist >> (32 - 3 * i)) ^ (bhist >> (40 - 4 * i))) & ((1 << (logs - (i >= (NBR - 2)))) - 1)
+    void GehlHash(uint64_t PC) {
+        gehl_lanes.set(GGEHL_LANE, GNB, (PC << 1) + pred_inter, GHIST);
+        gehl_lanes.set(PGEHL_LANE, PNB, PC, phist);
+#ifdef LOCALH
+        gehl_lanes.set(LGEHL_LANE, LNB, PC, L_shist[INDLOCAL]);
+#ifdef LOCALS
+        gehl_lanes.set(SGEHL_LANE, SNB, PC, S_slhist[INDSLOCAL]);
+#endif
+#ifdef LOCALT
+        gehl_lanes.set(TGEHL_LANE, TNB, PC, T_slhist[INDTLOCAL]);
+#endif
+#endif
+#ifdef IMLI
+        gehl_lanes.set(IMGEHL_LANE, IMNB, PC, IMHIST[(IMLIcount)]);
+        gehl_lanes.set(IGEHL_LANE, INB, PC, IMLIcount);
+#endif
+        gehl_lanes.hash();
+        gehl_lanes_valid = true;
+        gehl_lanes_pc = PC;
+    }
 
-        }
+    int Gpredict(uint64_t PC, int lane, int NBR, int8_t *W) {
+        int PERCSUM = gehl_lanes.sum(lane, NBR);
 #ifdef VARTHRES
         PERCSUM = (1 + (W[INDUPDS] >= 0)) * PERCSUM;
 #endif
         return ((PERCSUM));
     }
 
-    void Gupdate(uint64_t PC, bool taken, long long BHIST, int *length,
-                 int8_t **tab, int NBR, int logs, int8_t *W) {
+    void Gupdate(uint64_t PC, int lane, bool taken, int NBR, int8_t *W) {
 
         int PERCSUM = 0;
 
-        for (int i = 0; i < NBR; i++) {
-            long long bhist = BHIST & ((long long) ((1 << length[i]) - 1));
-            long long index = GINDEX;
+        for (int i = lane; i < lane + NBR; i++) {
+            int8_t &ctr = gehl_lanes.table[i][gehl_lanes.index[i]];
 
-            PERCSUM += (2 * tab[i][index] + 1);
-            ctrupdate(tab[i][index], taken, PERCWIDTH);
+            PERCSUM += (2 * ctr + 1);
+            ctrupdate(ctr, taken, PERCWIDTH);
         }
 #ifdef VARTHRES
         {
@@ -1563,6 +1651,9 @@ public:
 };
 
 PREDICTOR tage_predictors[NUM_CPUS];
+DirectionMemo<12> tage_direction_memo[NUM_CPUS];
+// -bp_update_delay: predictions whose tables are not trained yet, oldest first
+std::deque<TagePrediction> tage_pending_predictions[NUM_CPUS];
 
 
 void O3_CPU::initialize_branch_predictor() {
@@ -1571,9 +1662,36 @@ void O3_CPU::initialize_branch_predictor() {
 
 uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type) {
     tage_predictors[cpu].predDir = tage_predictors[cpu].GetPrediction(ip);
+    tage_direction_memo[cpu].record(ip, tage_predictors[cpu].predDir ? 1 : 0);
     return tage_predictors[cpu].predDir ? 1 : 0;
 }
 
+uint8_t O3_CPU::peek_direction(uint64_t ip) {
+    uint8_t prediction;
+    if (tage_direction_memo[cpu].lookup(ip, prediction))
+        return prediction;
+    // read-only base prediction, indexed like BI in GetPrediction
+    return btable[(ip ^ (ip >> 2)) & ((1 << LOGB) - 1)].pred > 0 ? 1 : 0;
+}
+
+string O3_CPU::branch_predictor_name() {
+    return "tage-sc-l";
+}
+
 void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
     tage_predictors[cpu].UpdatePredictor(ip, branch_type, (taken != 0), tage_predictors[cpu].predDir, branch_target);
 }
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+    tage_pending_predictions[cpu].emplace_back();
+    tage_predictors[cpu].SavePrediction(tage_pending_predictions[cpu].back());
+    tage_predictors[cpu].HistoryUpdate(ip, branch_type, (taken != 0), branch_target,
+                                       phist, ptghist, ch_i, ch_t[0], ch_t[1]);
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+    // the indices, tags and sums this branch was predicted with
+    tage_predictors[cpu].RestorePrediction(ip, tage_pending_predictions[cpu].front());
+    tage_pending_predictions[cpu].pop_front();
+    tage_predictors[cpu].UpdateTables(ip, (taken != 0));
+}
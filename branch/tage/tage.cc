@@ -1,7 +1,9 @@
 #include "ooo_cpu.h"
+#include "direction_memo.h"
 #include <cstdlib>
 #include <time.h>
 #include <bitset>
+#include <deque>
 
 #define BIMODAL_CTR_MAX  3
 #define BIMODAL_CTR_INIT 2
@@ -55,6 +57,18 @@ struct CompressedHist {
 };
 
 
+// The state of one prediction that UpdateTables() trains the tables with.
+struct TagePrediction {
+    bool primePred;
+    bool altPred;
+    bool predDir;
+    int primeBank;
+    int altBank;
+    uint32_t indexTagPred[NUMTAGTABLES];
+    uint32_t tag[NUMTAGTABLES];
+};
+
+
 class TagePredictor {
     // The state is defined for Gshare, change for your design
 private:
@@ -185,6 +199,11 @@ public:
         altBetterCount = 8;
     }
 
+    // Base (bimodal) prediction, read only.
+    bool GetBasePrediction(uint32_t PC) const {
+        return bimodal[PC % numBimodalEntries] > BIMODAL_CTR_MAX / 2;
+    }
+
     bool GetPrediction(uint32_t PC) {
         /// Base Prediction
 
@@ -291,6 +310,39 @@ public:
     }
 
     void UpdatePredictor(uint32_t PC, bool resolveDir, uint32_t branchTarget) {
+        UpdateTables(PC, resolveDir);
+        UpdateHistory(PC, resolveDir);
+    }
+
+    // State of the last prediction, for a delayed UpdateTables().
+    TagePrediction SavePrediction() const {
+        TagePrediction p;
+        p.primePred = primePred;
+        p.altPred = altPred;
+        p.predDir = predDir;
+        p.primeBank = primeBank;
+        p.altBank = altBank;
+        for (int i = 0; i < NUMTAGTABLES; i++) {
+            p.indexTagPred[i] = indexTagPred[i];
+            p.tag[i] = tag[i];
+        }
+        return p;
+    }
+
+    void RestorePrediction(const TagePrediction &p) {
+        primePred = p.primePred;
+        altPred = p.altPred;
+        predDir = p.predDir;
+        primeBank = p.primeBank;
+        altBank = p.altBank;
+        for (int i = 0; i < NUMTAGTABLES; i++) {
+            indexTagPred[i] = p.indexTagPred[i];
+            tag[i] = p.tag[i];
+        }
+    }
+
+    // Trains the counters, useful bits and allocation with the last (or restored) prediction.
+    void UpdateTables(uint32_t PC, bool resolveDir) {
         bool strong_old_present = false;
         bool new_entry = 0;
         if (primeBank < NUMTAGTABLES) {
@@ -432,8 +484,9 @@ public:
             }
 
         }
+    }
 
-
+    void UpdateHistory(uint32_t PC, bool resolveDir) {
         // update the GHR
         GHR = (GHR << 1);
 
@@ -465,6 +518,9 @@ public:
 
 
 TagePredictor tage_predictors[NUM_CPUS];
+DirectionMemo<12> tage_direction_memo[NUM_CPUS];
+// -bp_update_delay: predictions whose tables are not trained yet, oldest first
+std::deque<TagePrediction> tage_pending_predictions[NUM_CPUS];
 
 
 void O3_CPU::initialize_branch_predictor() {
@@ -472,9 +528,34 @@ void O3_CPU::initialize_branch_predictor() {
 }
 
 uint8_t O3_CPU::predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type) {
-    return tage_predictors[cpu].GetPrediction(ip) ? 1 : 0;
+    uint8_t prediction = tage_predictors[cpu].GetPrediction(ip) ? 1 : 0;
+    tage_direction_memo[cpu].record(ip, prediction);
+    return prediction;
+}
+
+uint8_t O3_CPU::peek_direction(uint64_t ip) {
+    uint8_t prediction;
+    if (tage_direction_memo[cpu].lookup(ip, prediction))
+        return prediction;
+    return tage_predictors[cpu].GetBasePrediction(ip) ? 1 : 0;
+}
+
+string O3_CPU::branch_predictor_name() {
+    return "tage";
 }
 
 void O3_CPU::last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
     tage_predictors[cpu].UpdatePredictor(ip, (taken != 0), branch_target);
 }
+
+void O3_CPU::update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+    tage_pending_predictions[cpu].push_back(tage_predictors[cpu].SavePrediction());
+    tage_predictors[cpu].UpdateHistory(ip, (taken != 0));
+}
+
+void O3_CPU::train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+    // the indices and tags this branch was predicted with
+    tage_predictors[cpu].RestorePrediction(tage_pending_predictions[cpu].front());
+    tage_pending_predictions[cpu].pop_front();
+    tage_predictors[cpu].UpdateTables(ip, (taken != 0));
+}
@@ -6,14 +6,19 @@
 #define CHAMPSIM_PT_ACCESS_RECORD_H
 
 #include "ooo_cpu.h"
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <fstream>
 #include <boost/filesystem.hpp>
+#include <zlib.h>
+#include "artifact_store.h"
 namespace fs = boost::filesystem;
 
 extern uint8_t total_btb_ways;
 extern uint64_t total_btb_entries;
+extern uint64_t warmup_instructions, simulation_instructions;
+extern string access_record_format;
 
 enum class RecordType {
     HIT,
@@ -53,26 +58,152 @@ string btb_type_to_suffix(BTBType btbType) {
     }
 }
 
+// OPT access record of short_name in the artifact store; the kind is the legacy directory name.
+Artifact opt_access_record_artifact(const fs::path &record_dir, const string &short_name, uint64_t ways,
+                                    uint64_t entries, const string &extension = ".csv") {
+    return Artifact(record_dir.filename().string(), short_name, extension)
+            .with("btb_ways", ways)
+            .with("btb_entries", entries)
+            .with("ifetch_buffer_size", IFETCH_BUFFER_SIZE)
+            .with("warmup_instructions", warmup_instructions)
+            .with("simulation_instructions", simulation_instructions);
+}
+
+/*
+ * Output of AccessRecord (-access_record_format):
+ *   full:  "PC,Target,Type,Access Record" with every access of every branch (default)
+ *   short: "PC,Hit,Taken" counts only, which is all Thermometer reads; no sequence is kept
+ *   rle:   short, plus the sequences as a gzip run-length log (<trace>.rle.csv.gz) in which a
+ *          run of n equal records is written as "record*n"
+ * Sequences are kept as runs in every mode that writes them, so long hit streaks cost one
+ * word instead of one word per access.
+ */
+enum class AccessRecordFormat {
+    FULL,
+    SHORT,
+    RLE
+};
+
 struct RecordEntry {
+    static const uint32_t RUN_TYPE_BITS = 2;
+    static const uint32_t RUN_LENGTH_MAX = (1u << (32 - RUN_TYPE_BITS)) - 1;
+
     uint64_t ip = 0;
     uint64_t target = 0;
     uint8_t branch_type = BRANCH_CONDITIONAL;
-    vector<RecordType> record;
+    uint64_t count[4] = {}; // Indexed by RecordType
+    vector<uint32_t> runs;  // Run length << RUN_TYPE_BITS | RecordType
 
     RecordEntry() = default;
 
-    RecordEntry(const RecordEntry &other) {
-        ip = other.ip;
-        target = other.target;
-        branch_type = other.branch_type;
-    }
-
     RecordEntry(uint64_t ip, uint64_t target, uint8_t branch_type) :
     ip(ip), target(target), branch_type(branch_type) {}
+
+    void add(RecordType type, bool keep_sequence) {
+        count[(int) type]++;
+        if (!keep_sequence) return;
+        if (!runs.empty() && run_type(runs.back()) == type && run_length(runs.back()) < RUN_LENGTH_MAX) {
+            runs.back() += 1u << RUN_TYPE_BITS;
+        } else {
+            runs.push_back((1u << RUN_TYPE_BITS) | (uint32_t) type);
+        }
+    }
+
+    static RecordType run_type(uint32_t run) {
+        return (RecordType) (run & ((1u << RUN_TYPE_BITS) - 1));
+    }
+
+    static uint32_t run_length(uint32_t run) {
+        return run >> RUN_TYPE_BITS;
+    }
+
+    uint64_t hit() const {
+        return count[(int) RecordType::HIT];
+    }
+
+    uint64_t taken() const {
+        return hit() + count[(int) RecordType::MISS_ONLY] + count[(int) RecordType::MISS_INSERT];
+    }
+};
+
+// Open-addressing map from ip to RecordEntry (ip 0 marks an empty slot).
+class RecordTable {
+    vector<RecordEntry> slots;
+    uint64_t used = 0;
+
+    uint64_t slot_index(uint64_t ip) const {
+        return ((ip >> 2) * 0x9E3779B97F4A7C15ULL) & (slots.size() - 1);
+    }
+
+    void grow() {
+        vector<RecordEntry> old(slots.empty() ? 1024 : slots.size() * 2);
+        old.swap(slots);
+        for (auto &entry : old) {
+            if (entry.ip == 0) continue;
+            auto i = slot_index(entry.ip);
+            while (slots[i].ip != 0) i = (i + 1) & (slots.size() - 1);
+            slots[i] = std::move(entry);
+        }
+    }
+
+public:
+    RecordEntry *find(uint64_t ip) {
+        if (slots.empty()) return nullptr;
+        for (auto i = slot_index(ip); slots[i].ip != 0; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].ip == ip) return &slots[i];
+        }
+        return nullptr;
+    }
+
+    RecordEntry *find_or_insert(uint64_t ip, uint64_t target, uint8_t branch_type) {
+        assert(ip != 0);
+        auto entry = find(ip);
+        if (entry != nullptr) return entry;
+        if (2 * (used + 1) > slots.size()) grow();
+        auto i = slot_index(ip);
+        while (slots[i].ip != 0) i = (i + 1) & (slots.size() - 1);
+        slots[i] = RecordEntry(ip, target, branch_type);
+        used++;
+        return &slots[i];
+    }
+
+    // Entries in ascending ip order, the order of the old std::map output.
+    vector<const RecordEntry *> sorted() const {
+        vector<const RecordEntry *> entries;
+        entries.reserve(used);
+        for (auto &entry : slots) {
+            if (entry.ip != 0) entries.push_back(&entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const RecordEntry *a, const RecordEntry *b) {
+            return a->ip < b->ip;
+        });
+        return entries;
+    }
 };
 
 class AccessRecord {
-    vector<map<uint64_t, RecordEntry>> branch_record;
+    vector<RecordTable> branch_record;
+    AccessRecordFormat format = AccessRecordFormat::FULL;
+    bool format_known = false;
+
+    void load_format() {
+        if (!format_known) {
+            // Knobs are parsed after global records are constructed, so the format is read lazily.
+            format = parse_format(access_record_format);
+            format_known = true;
+        }
+    }
+
+    bool keep_sequence() const {
+        return format != AccessRecordFormat::SHORT;
+    }
+
+    static AccessRecordFormat parse_format(const string &name) {
+        if (name == "short") return AccessRecordFormat::SHORT;
+        if (name == "rle") return AccessRecordFormat::RLE;
+        assert(name.empty() || name == "full");
+        return AccessRecordFormat::FULL;
+    }
 
 public:
     BTBType btb_type;
@@ -82,35 +213,30 @@ public:
     }
 
     void access(uint64_t ip, uint64_t target, uint8_t branch_type, uint64_t cpu, bool hit, bool insert_on_miss) {
-//        cout << "Before access" << endl;
-        auto it = branch_record[cpu].find(ip);
-        if (it == branch_record[cpu].end()) {
-            branch_record[cpu].emplace_hint(it, ip, RecordEntry(ip, target, branch_type));
-            it = branch_record[cpu].find(ip);
-        }
+        load_format();
+        auto entry = branch_record[cpu].find_or_insert(ip, target, branch_type);
         if (hit) {
-            it->second.record.push_back(RecordType::HIT);
+            entry->add(RecordType::HIT, keep_sequence());
         } else if (insert_on_miss) {
-            it->second.record.push_back(RecordType::MISS_INSERT);
+            entry->add(RecordType::MISS_INSERT, keep_sequence());
         } else {
-            it->second.record.push_back(RecordType::MISS_ONLY);
+            entry->add(RecordType::MISS_ONLY, keep_sequence());
         }
-//        cout << "After access" << endl;
     }
 
     void evict(uint64_t ip, uint64_t cpu) {
-        auto it = branch_record[cpu].find(ip);
-        assert(it != branch_record[cpu].end());
-        it->second.record.push_back(RecordType::EVICT);
+        auto entry = branch_record[cpu].find(ip);
+        assert(entry != nullptr);
+        entry->add(RecordType::EVICT, keep_sequence());
     }
 
     void print_final_stats(string &trace_name, uint64_t cpu, bool with_twig = false) {
+        load_format();
         auto short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRAIN);
         if (with_twig) {
             short_name = "twig_" + short_name;
         }
         fs::path opt_access_record_path = ("/mnt/storage/shixins/champsim_pt/opt_access_record" + btb_type_to_suffix(btb_type));
-        fs::create_directory(opt_access_record_path);
         string sub_dir = "way" + std::to_string(total_btb_ways);
         if (total_btb_entries != 8 && total_btb_entries != 8192) {
             if (total_btb_entries % 1024 == 0) {
@@ -122,23 +248,67 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        fs::create_directory(opt_access_record_path / sub_dir);
-        auto filename = opt_access_record_path / sub_dir / (short_name + ".csv");
+        auto artifact = opt_access_record_artifact(opt_access_record_path, short_name, total_btb_ways, total_btb_entries);
+        if (!Artifact::enabled()) {
+            fs::create_directory(opt_access_record_path);
+            fs::create_directory(opt_access_record_path / sub_dir);
+        }
+        auto filename = artifact.write_path(opt_access_record_path / sub_dir / (short_name + ".csv"));
         cout << "Open opt access record " << filename << endl;
+        auto entries = branch_record[cpu].sorted();
         ofstream out(filename.c_str());
         assert(out.is_open());
-        out << "PC,Target,Type,Access Record" << endl;
-        for (auto &it : branch_record[cpu]) {
-            out << std::hex << it.first;
-            out << ",";
-            out << std::hex << it.second.target;
-            out << "," << (int) it.second.branch_type;
-            for (auto a : it.second.record) {
-                out << "," << (int) a;
+        if (format == AccessRecordFormat::FULL) {
+            out << "PC,Target,Type,Access Record" << endl;
+            for (auto entry : entries) {
+                out << std::hex << entry->ip;
+                out << ",";
+                out << std::hex << entry->target;
+                out << "," << (int) entry->branch_type;
+                for (auto run : entry->runs) {
+                    auto type = (int) RecordEntry::run_type(run);
+                    for (uint32_t i = 0; i < RecordEntry::run_length(run); i++) {
+                        out << "," << type;
+                    }
+                }
+                out << endl;
+            }
+        } else {
+            out << "PC,Hit,Taken" << endl;
+            for (auto entry : entries) {
+                out << std::hex << entry->ip << "," << entry->hit() << "," << entry->taken() << endl;
             }
-            out << endl;
         }
         out.close();
+        artifact.commit();
+        if (format == AccessRecordFormat::RLE) {
+            auto log_artifact = opt_access_record_artifact(opt_access_record_path, short_name, total_btb_ways,
+                                                           total_btb_entries, ".rle.csv.gz");
+            print_run_length_log(log_artifact.write_path(opt_access_record_path / sub_dir / (short_name + ".rle.csv.gz")).string(),
+                                 entries);
+            log_artifact.commit();
+        }
+    }
+
+    void print_run_length_log(const string &filename, const vector<const RecordEntry *> &entries) {
+        cout << "Open opt access run length log " << filename << endl;
+        gzFile out = gzopen(filename.c_str(), "wb");
+        assert(out != nullptr);
+        gzprintf(out, "PC,Target,Type,Access Record\n");
+        for (auto entry : entries) {
+            gzprintf(out, "%lx,%lx,%d", (unsigned long) entry->ip, (unsigned long) entry->target,
+                     (int) entry->branch_type);
+            for (auto run : entry->runs) {
+                auto length = RecordEntry::run_length(run);
+                if (length == 1) {
+                    gzprintf(out, ",%d", (int) RecordEntry::run_type(run));
+                } else {
+                    gzprintf(out, ",%d*%u", (int) RecordEntry::run_type(run), length);
+                }
+            }
+            gzprintf(out, "\n");
+        }
+        gzclose(out);
     }
 };
 
@@ -12,6 +12,10 @@
 #include <limits>
 #include <fstream>
 #include <boost/filesystem.hpp>
+#include <algorithm>
+#include "opt_access_stream.h"
+#include "next_use_index.h"
+#include "fenwick_tree.h"
 namespace fs = boost::filesystem;
 
 using std::vector;
@@ -21,14 +25,40 @@ using std::set;
 
 class CoverageAccuracy {
     // TODO: Only for single core CPU!
-    vector<unordered_map<uint64_t, uint64_t>> access_record; // key: timestamp, value: ip
-    unordered_map<uint64_t, set<uint64_t>> future_accesses;
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    /*
+     * Taken accesses of one set in time order. The reuse distance of a victim is the number of
+     * distinct branches of its set accessed strictly between now and its next use. Queries only
+     * move forward in time, so the tree marks, for every branch, its first access at or after
+     * the current sweep position; the distinct count of a range is then a range sum.
+     */
+    struct SetAccesses {
+        vector<uint64_t> times;
+        vector<uint32_t> next; // Index of the next access to the same ip in this set
+        FenwickTree<int32_t> first_uses;
+        uint64_t sweep = 0;    // Accesses before this index are in the past
+    };
+
+    vector<SetAccesses> access_record;
+    NextUseIndex future_accesses;
 //    vector<uint64_t> victim_reuse_distance;
     uint64_t total_sets;
     uint64_t total_ways;
 
     uint64_t friendly_count = 0;
     uint64_t unfriendly_count = 0;
+    uint64_t last_query_start = 0;
+
+    void advance(SetAccesses &accesses, uint64_t time) {
+        while (accesses.sweep < accesses.times.size() && accesses.times[accesses.sweep] < time) {
+            accesses.first_uses.add(accesses.sweep, -1);
+            if (accesses.next[accesses.sweep] != NONE) {
+                accesses.first_uses.add(accesses.next[accesses.sweep], 1);
+            }
+            accesses.sweep++;
+        }
+    }
 
 public:
     void init(FILE *demand_record, uint64_t num_sets, uint64_t num_ways) {
@@ -36,17 +66,29 @@ public:
         total_sets = num_sets;
         total_ways = num_ways;
         access_record.resize(num_sets);
-        uint64_t ip, counter;
-        while (true) {
-            if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-            auto it = future_accesses.find(ip);
-            if (it == future_accesses.end()) {
-                future_accesses.emplace_hint(it, ip, set<uint64_t>());
+        unordered_map<uint64_t, uint32_t> last_access; // ip -> index of its latest access in its set
+        vector<vector<uint32_t>> first_use(num_sets);
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t counter) {
+            future_accesses.add(ip, counter);
+            auto &accesses = access_record[find_set_index(ip)];
+            assert(accesses.times.size() < NONE);
+            auto index = (uint32_t) accesses.times.size();
+            accesses.times.push_back(counter);
+            accesses.next.push_back(NONE);
+            auto it = last_access.find(ip);
+            if (it == last_access.end()) {
+                last_access.emplace(ip, index);
+                first_use[find_set_index(ip)].push_back(index);
+            } else {
+                accesses.next[it->second] = index;
+                it->second = index;
             }
-            future_accesses[ip].insert(counter);
-            access_record[find_set_index(ip)].emplace(counter, ip);
+        });
+        for (uint64_t set = 0; set < num_sets; set++) {
+            vector<int32_t> marks(access_record[set].times.size(), 0);
+            for (auto index : first_use[set]) marks[index] = 1;
+            access_record[set].first_uses = FenwickTree<int32_t>(marks);
         }
-        rewind(demand_record);
     }
 
     uint64_t find_set_index(uint64_t ip) {
@@ -54,28 +96,29 @@ public:
     }
 
     uint64_t get_reuse_distance(uint64_t ip, uint64_t curr_time, bool by_pass) {
-        auto it = future_accesses[ip].upper_bound(curr_time);
-        if (it == future_accesses[ip].end()) {
+        auto start = curr_time + 1;
+        // advance() and the NextUseIndex cursors only move forward in time
+        assert(start >= last_query_start);
+        last_query_start = start;
+        auto next_use = future_accesses.next_use(ip, curr_time);
+        if (next_use == NextUseIndex::NEVER) {
 //            victim_reuse_distance.push_back(std::numeric_limits<uint64_t>::max());
             unfriendly_count++;
             return std::numeric_limits<uint64_t>::max();
         }
-        // *it is the next time when ip is accessed.
-        unordered_set<uint64_t> unique_cache_lines;
-        auto start = curr_time + 1;
-        for (uint64_t i = start; i < *it; i++) {
-            auto taken_access_it = access_record[find_set_index(ip)].find(i);
-            if (taken_access_it != access_record[find_set_index(ip)].end()) {
-                unique_cache_lines.insert(taken_access_it->second);
-            }
-        }
-//        victim_reuse_distance.push_back(unique_cache_lines.size());
-        if (unique_cache_lines.size() < total_ways) {
+        // next_use is the next time when ip is accessed.
+        auto &accesses = access_record[find_set_index(ip)];
+        advance(accesses, start);
+        auto end = std::lower_bound(accesses.times.begin() + accesses.sweep, accesses.times.end(), next_use)
+                   - accesses.times.begin();
+        uint64_t unique_cache_lines = accesses.first_uses.range_sum(accesses.sweep, end);
+//        victim_reuse_distance.push_back(unique_cache_lines);
+        if (unique_cache_lines < total_ways) {
             friendly_count++;
         } else {
             unfriendly_count++;
         }
-        return unique_cache_lines.size();
+        return unique_cache_lines;
     }
 
     void print_final_stats(string &trace_name, string &program_name, uint64_t total_btb_ways) {
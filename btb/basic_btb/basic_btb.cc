@@ -11,6 +11,7 @@
 #include "../prefetch_stream_buffer.h"
 #include "../branch_bias.h"
 #include "../reuse_distance.h"
+#include "../btb_geometry.h"
 
 using std::vector;
 
@@ -25,7 +26,7 @@ extern uint64_t total_btb_entries; // 1K, 2K...
 
 CoverageAccuracy coverage_accuracy;
 uint64_t timestamp = 0;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 BranchBias branch_bias(false);
 ReuseDistance reuse_distance(BASIC_BTB_SETS, false);
 
@@ -36,7 +37,8 @@ struct BASIC_BTB_ENTRY {
     uint64_t lru = 0;
 };
 
-vector<vector<vector<BASIC_BTB_ENTRY>>> basic_btb;
+// basic_btb[cpu] holds all sets back to back, BASIC_BTB_WAYS entries per set.
+vector<vector<BASIC_BTB_ENTRY>> basic_btb;
 uint64_t basic_btb_lru_counter[NUM_CPUS];
 
 uint64_t basic_btb_indirect[NUM_CPUS][BASIC_BTB_INDIRECT_SIZE];
@@ -62,30 +64,8 @@ uint64_t basic_btb_abs_addr_dist(uint64_t addr1, uint64_t addr2) {
     return addr2 - addr1;
 }
 
-uint64_t basic_btb_set_index(uint64_t ip) { return ((ip >> 2) % BASIC_BTB_SETS); }
-
-BASIC_BTB_ENTRY *basic_btb_find_entry(uint8_t cpu, uint64_t ip) {
-    uint64_t set = basic_btb_set_index(ip);
-    for (uint32_t i = 0; i < BASIC_BTB_WAYS; i++) {
-        if (basic_btb[cpu][set][i].ip_tag == ip) {
-            return &(basic_btb[cpu][set][i]);
-        }
-    }
-
-    return NULL;
-}
-
-BASIC_BTB_ENTRY *basic_btb_get_lru_entry(uint8_t cpu, uint64_t set) {
-    uint32_t lru_way = 0;
-    uint64_t lru_value = basic_btb[cpu][set][lru_way].lru;
-    for (uint32_t i = 0; i < BASIC_BTB_WAYS; i++) {
-        if (basic_btb[cpu][set][i].lru < lru_value) {
-            lru_way = i;
-            lru_value = basic_btb[cpu][set][lru_way].lru;
-        }
-    }
-
-    return &(basic_btb[cpu][set][lru_way]);
+BASIC_BTB_ENTRY *basic_btb_set_begin(uint8_t cpu, uint64_t set) {
+    return basic_btb[cpu].data() + set * BASIC_BTB_WAYS;
 }
 
 void basic_btb_update_lru(uint8_t cpu, BASIC_BTB_ENTRY *btb_entry) {
@@ -133,7 +113,105 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
     return size;
 }
 
+// Direct branch part of the BTB, instantiated per geometry (see btb_geometry.h).
+template <uint32_t WAYS, bool POW2_SETS>
+struct BasicBTB {
+    using Geometry = BTBGeometry<WAYS, POW2_SETS>;
+
+    static uint64_t set_index(uint64_t ip) {
+        return Geometry::set_index(ip, BASIC_BTB_SETS);
+    }
+
+    static BASIC_BTB_ENTRY *find_entry(uint8_t cpu, uint64_t ip) {
+        return Geometry::find(basic_btb_set_begin(cpu, set_index(ip)), ip, BASIC_BTB_WAYS);
+    }
+
+    static BASIC_BTB_ENTRY *get_lru_entry(uint8_t cpu, uint64_t set) {
+        return Geometry::lru(basic_btb_set_begin(cpu, set), BASIC_BTB_WAYS);
+    }
+
+    static std::pair<uint64_t, uint8_t> predict(uint8_t cpu, uint64_t ip) {
+        auto btb_entry = find_entry(cpu, ip);
+
+        if (btb_entry == NULL) {
+            // no prediction for this IP
+            return std::make_pair(stream_buffer.stream_buffer_predict(ip), true);
+        }
+
+        basic_btb_update_lru(cpu, btb_entry);
+
+        return std::make_pair(btb_entry->target, btb_entry->always_taken);
+    }
+
+    static void update(uint8_t cpu, uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type) {
+        branch_bias.access(ip, cpu, taken != 0);
+        auto btb_entry = find_entry(cpu, ip);
+
+        if (btb_entry == nullptr) {
+            stream_buffer.stream_buffer_update(ip);
+            if ((branch_target != 0) && taken) {
+                // no prediction for this entry so far, so allocate one
+                uint64_t set = set_index(ip);
+                auto repl_entry = get_lru_entry(cpu, set);
+
+                if (repl_entry->ip_tag != 0) // Truly evict something.
+                    coverage_accuracy.get_reuse_distance(repl_entry->ip_tag, timestamp - 1, false);
+
+                repl_entry->ip_tag = ip;
+                repl_entry->target = branch_target;
+                repl_entry->always_taken = 1;
+                basic_btb_update_lru(cpu, repl_entry);
+                reuse_distance.access(ip, branch_target, branch_type, cpu);
+            }
+        } else {
+            // update an existing entry
+            if (!taken) {
+                btb_entry->always_taken = 0;
+            } else {
+                // Only update target on taken!!!
+                btb_entry->target = branch_target;
+                reuse_distance.access(ip, branch_target, branch_type, cpu);
+            }
+        }
+    }
+
+    static void prefetch(uint8_t cpu, uint64_t ip, uint64_t branch_target, bool taken, bool to_stream_buffer) {
+        auto btb_entry = find_entry(cpu, ip);
+
+        if (btb_entry == NULL) {
+            if ((branch_target != 0) && taken) {
+                // no prediction for this entry so far, so allocate one
+                if (to_stream_buffer) {
+                    stream_buffer.prefetch(ip, branch_target);
+                } else {
+                    uint64_t set = set_index(ip);
+                    auto repl_entry = get_lru_entry(cpu, set);
+
+                    coverage_accuracy.get_reuse_distance(repl_entry->ip_tag, timestamp - 1, false);
+
+                    repl_entry->ip_tag = ip;
+                    repl_entry->target = branch_target;
+                    repl_entry->always_taken = 1;
+                    basic_btb_update_lru(cpu, repl_entry);
+                }
+            }
+        } else {
+            basic_btb_update_lru(cpu, btb_entry);
+            // update an existing entry
+            if (!taken) {
+                btb_entry->always_taken = 0;
+            } else {
+                // Only update target on taken!!!
+                btb_entry->target = branch_target;
+            }
+        }
+    }
+};
+
+BTBGeometryKind basic_btb_geometry;
+
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Basic BTB sets: " << BASIC_BTB_SETS
               << " ways: " << (int) BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -143,17 +221,16 @@ void O3_CPU::initialize_btb() {
 
     coverage_accuracy.init(btb_record, BASIC_BTB_SETS, BASIC_BTB_WAYS);
 
-    basic_btb.resize(NUM_CPUS, vector<vector<BASIC_BTB_ENTRY>>(BASIC_BTB_SETS, vector<BASIC_BTB_ENTRY>(BASIC_BTB_WAYS)));
+    basic_btb.resize(NUM_CPUS, vector<BASIC_BTB_ENTRY>(BASIC_BTB_SETS * BASIC_BTB_WAYS));
+    basic_btb_geometry = select_btb_geometry(BASIC_BTB_WAYS, BASIC_BTB_SETS);
 
-    branch_bias.init(total_btb_ways, total_btb_entries);
+    branch_bias.init(total_btb_ways, total_btb_entries, warmup_instructions, simulation_instructions);
 
-    for (uint32_t i = 0; i < BASIC_BTB_SETS; i++) {
-        for (uint32_t j = 0; j < BASIC_BTB_WAYS; j++) {
-            basic_btb[cpu][i][j].ip_tag = 0;
-            basic_btb[cpu][i][j].target = 0;
-            basic_btb[cpu][i][j].always_taken = 0;
-            basic_btb[cpu][i][j].lru = 0;
-        }
+    for (auto &entry : basic_btb[cpu]) {
+        entry.ip_tag = 0;
+        entry.target = 0;
+        entry.always_taken = 0;
+        entry.lru = 0;
     }
     basic_btb_lru_counter[cpu] = 0;
 
@@ -196,24 +273,14 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
     } else {
         timestamp++;
         // use BTB for all other branches + direct calls
-        auto btb_entry = basic_btb_find_entry(cpu, ip);
-
-        if (btb_entry == NULL) {
-            // no prediction for this IP
-            return std::make_pair(stream_buffer.stream_buffer_predict(ip), true);
-        }
-
-        always_taken = btb_entry->always_taken;
-        basic_btb_update_lru(cpu, btb_entry);
-
-        return std::make_pair(btb_entry->target, always_taken);
+        return with_btb_geometry<BasicBTB>(basic_btb_geometry, [&](auto btb) { return btb.predict(cpu, ip); });
     }
 
     return std::make_pair(0, always_taken);
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -238,35 +305,9 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
     } else if ((branch_type != BRANCH_INDIRECT) &&
                (branch_type != BRANCH_INDIRECT_CALL)) {
         // use BTB
-        branch_bias.access(ip, cpu, taken != 0);
-        auto btb_entry = basic_btb_find_entry(cpu, ip);
-
-        if (btb_entry == nullptr) {
-            stream_buffer.stream_buffer_update(ip);
-            if ((branch_target != 0) && taken) {
-                // no prediction for this entry so far, so allocate one
-                uint64_t set = basic_btb_set_index(ip);
-                auto repl_entry = basic_btb_get_lru_entry(cpu, set);
-
-                if (repl_entry->ip_tag != 0) // Truly evict something.
-                    coverage_accuracy.get_reuse_distance(repl_entry->ip_tag, timestamp - 1, false);
-
-                repl_entry->ip_tag = ip;
-                repl_entry->target = branch_target;
-                repl_entry->always_taken = 1;
-                basic_btb_update_lru(cpu, repl_entry);
-                reuse_distance.access(ip, branch_target, branch_type, cpu);
-            }
-        } else {
-            // update an existing entry
-            if (!taken) {
-                btb_entry->always_taken = 0;
-            } else {
-                // Only update target on taken!!!
-                btb_entry->target = branch_target;
-                reuse_distance.access(ip, branch_target, branch_type, cpu);
-            }
-        }
+        with_btb_geometry<BasicBTB>(basic_btb_geometry, [&](auto btb) {
+            btb.update(cpu, ip, branch_target, taken, branch_type);
+        });
     }
 }
 
@@ -275,35 +316,9 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
     if (branch_type != BRANCH_RETURN &&
         branch_type != BRANCH_INDIRECT &&
         branch_type != BRANCH_INDIRECT_CALL) {
-        auto btb_entry = basic_btb_find_entry(cpu, ip);
-
-        if (btb_entry == NULL) {
-            if ((branch_target != 0) && taken) {
-                // no prediction for this entry so far, so allocate one
-                if (to_stream_buffer) {
-                    stream_buffer.prefetch(ip, branch_target);
-                } else {
-                    uint64_t set = basic_btb_set_index(ip);
-                    auto repl_entry = basic_btb_get_lru_entry(cpu, set);
-
-                    coverage_accuracy.get_reuse_distance(repl_entry->ip_tag, timestamp - 1, false);
-
-                    repl_entry->ip_tag = ip;
-                    repl_entry->target = branch_target;
-                    repl_entry->always_taken = 1;
-                    basic_btb_update_lru(cpu, repl_entry);
-                }
-            }
-        } else {
-            basic_btb_update_lru(cpu, btb_entry);
-            // update an existing entry
-            if (!taken) {
-                btb_entry->always_taken = 0;
-            } else {
-                // Only update target on taken!!!
-                btb_entry->target = branch_target;
-            }
-        }
+        with_btb_geometry<BasicBTB>(basic_btb_geometry, [&](auto btb) {
+            btb.prefetch(cpu, ip, branch_target, taken, to_stream_buffer);
+        });
     }
 }
 
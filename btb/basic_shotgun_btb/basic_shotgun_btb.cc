@@ -9,21 +9,23 @@
 #include "ooo_cpu.h"
 #include <vector>
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
+#include "../shotgun_geometry.h"
 
 using std::unordered_map;
 using std::vector;
 
-#define CONDITIONAL_BTB_SETS 384
-#define CONDITIONAL_BTB_WAYS 4
-#define UNCONDITIONAL_BTB_SETS 1280
-#define UNCONDITIONAL_BTB_WAYS 4
 #define BASIC_BTB_INDIRECT_SIZE 4096
 #define BASIC_BTB_RAS_SIZE 1536
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
+ShotgunGeometry shotgun_geometry;
+
 uint64_t con_timestamp = 0;
 uint64_t uncon_timestamp = 0;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
+OptAccessWriter conditional_access_writer;
+OptAccessWriter unconditional_access_writer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag = 0;
@@ -45,8 +47,8 @@ struct FOOTPRINT_BTB_ENTRY {
     uint8_t always_taken = 0;
     uint8_t branch_type = BRANCH_DIRECT_CALL;
     uint64_t lru = 0;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> call_footprint;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> return_footprint;
+    ShotgunFootprint call_footprint;
+    ShotgunFootprint return_footprint;
 
     FOOTPRINT_BTB_ENTRY() = default;
 
@@ -57,43 +59,21 @@ struct FOOTPRINT_BTB_ENTRY {
             branch_type(branch_type) {}
 
     void cache_access(BASIC_BTB_ENTRY *access_entry, bool update_call = true) {
-        // access_taken refers to taken or not!
         auto access_block = access_entry->ip_tag >> LOG2_BLOCK_SIZE;
-        uint64_t original_block;
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
         if (update_call) {
-            original_block = target >> LOG2_BLOCK_SIZE;
-            footprint = &call_footprint;
+            call_footprint.record(target >> LOG2_BLOCK_SIZE, access_block);
         } else {
-            original_block = ip_tag >> LOG2_BLOCK_SIZE;
-            footprint = &return_footprint;
-        }
-        // Update footprint
-        if (access_block <= original_block + 6 && access_block >= original_block - 2) {
-            (*footprint)[access_block].push_back(*access_entry);
+            return_footprint.record(ip_tag >> LOG2_BLOCK_SIZE, access_block);
         }
     }
 
     void operate_prefetch(O3_CPU *o3_cpu, bool prefetch_call) {
-        // This function does not actually prefetch instrs. It just add it to prefetch list.
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
-        uint64_t key;
-        if (prefetch_call) {
-            key = ip_tag;
-            footprint = &call_footprint;
-        } else {
-            key = target;
-            footprint = &return_footprint;
+        // This function does not actually prefetch instrs. It just publishes the footprint to the prefetcher.
+        auto &footprint = prefetch_call ? call_footprint : return_footprint;
+        if (!footprint.empty()) {
+            o3_cpu->shotgun_prefetch_region[prefetch_call ? ip_tag : target] = footprint;
         }
-        for (auto &a : *footprint) {
-            auto &region = o3_cpu->shotgun_prefetch_region[key];
-            region.clear();
-            for (auto &entry : a.second) {
-                region.push_back(entry.ip_tag);
-                // o3_cpu->prefetch_btb(entry.ip_tag, entry.target, entry.branch_type, entry.always_taken != 0);
-            }
-        }
-        footprint->clear();
+        footprint.clear();
     }
 };
 
@@ -111,12 +91,12 @@ public:
 
     void init() {
         conditional_btb.resize(NUM_CPUS,
-                               vector<vector<BASIC_BTB_ENTRY>>(CONDITIONAL_BTB_SETS,
-                                                               vector<BASIC_BTB_ENTRY>(CONDITIONAL_BTB_WAYS)));
+                               vector<vector<BASIC_BTB_ENTRY>>(shotgun_geometry.conditional_sets,
+                                                               vector<BASIC_BTB_ENTRY>(shotgun_geometry.conditional_ways)));
         unconditional_btb.resize(NUM_CPUS,
-                                 vector<vector<FOOTPRINT_BTB_ENTRY>>(UNCONDITIONAL_BTB_SETS,
+                                 vector<vector<FOOTPRINT_BTB_ENTRY>>(shotgun_geometry.unconditional_sets,
                                                                      vector<FOOTPRINT_BTB_ENTRY>(
-                                                                             UNCONDITIONAL_BTB_WAYS)));
+                                                                             shotgun_geometry.unconditional_ways)));
     }
 
     void update_current(O3_CPU *o3_cpu, FOOTPRINT_BTB_ENTRY *entry, uint8_t type) {
@@ -237,14 +217,18 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
-    std::cout << "Basic Shotgun BTB sets: " << CONDITIONAL_BTB_SETS
-              << " ways: " << (int) CONDITIONAL_BTB_WAYS
-              << " unconditional BTB sets: " << UNCONDITIONAL_BTB_SETS
-              << " ways: " << UNCONDITIONAL_BTB_WAYS
+    shotgun_geometry = ShotgunGeometry::from_knobs({384, 4, 1280, 4});
+    stream_buffer.init(stream_buffer_capacity);
+    std::cout << "Basic Shotgun BTB sets: " << shotgun_geometry.conditional_sets
+              << " ways: " << shotgun_geometry.conditional_ways
+              << " unconditional BTB sets: " << shotgun_geometry.unconditional_sets
+              << " ways: " << shotgun_geometry.unconditional_ways
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
     open_btb_record("w", true);
+    conditional_access_writer.open(btb_conditional_record);
+    unconditional_access_writer.open(btb_unconditional_record);
 
     // TODO: If NUM_CPU > 1, the vector would be resize multiple times. Modify it if needed.
     shotgun.init();
@@ -312,7 +296,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -330,7 +314,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             stream_buffer.stream_buffer_update(ip);
             if (branch_target != 0 && taken) {
                 // no prediction for this entry so far, so allocate one
-                auto set = basic_btb_set_index(ip, CONDITIONAL_BTB_SETS);
+                auto set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
                 auto repl_entry = basic_btb_get_lru_entry(cpu, set, shotgun.conditional_btb);
                 repl_entry->ip_tag = ip;
                 repl_entry->target = branch_target;
@@ -339,7 +323,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
                 // Add footprint
                 shotgun.add_footprint(repl_entry);
                 assert(btb_conditional_record != nullptr);
-                fprintf(btb_conditional_record, "%llu %llu\n", ip, con_timestamp);
+                conditional_access_writer.append(ip, con_timestamp);
             }
         } else {
             // update an existing entry
@@ -348,7 +332,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             } else {
                 btb_entry->target = branch_target;
                 assert(btb_conditional_record != nullptr);
-                fprintf(btb_conditional_record, "%llu %llu\n", ip, con_timestamp);
+                conditional_access_writer.append(ip, con_timestamp);
             }
             shotgun.add_footprint(btb_entry);
         }
@@ -372,7 +356,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
         if (btb_entry == nullptr) {
             if ((branch_target != 0) && taken) {
                 // no prediction for this entry so far, so allocate one
-                uint64_t set = basic_btb_set_index(ip, UNCONDITIONAL_BTB_SETS);
+                uint64_t set = basic_btb_set_index(ip, shotgun_geometry.unconditional_sets);
                 auto repl_entry = basic_btb_get_lru_entry(cpu, set, shotgun.unconditional_btb);
 
                 repl_entry->ip_tag = ip;
@@ -383,7 +367,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
                 shotgun.update_current(this, repl_entry, branch_type);
 
                 assert(btb_unconditional_record != nullptr);
-                fprintf(btb_unconditional_record, "%llu %llu\n", ip, uncon_timestamp);
+                unconditional_access_writer.append(ip, uncon_timestamp);
             }
         } else {
             // update an existing entry
@@ -394,7 +378,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
                 btb_entry->target = branch_target;
 
                 assert(btb_unconditional_record != nullptr);
-                fprintf(btb_unconditional_record, "%llu %llu\n", ip, uncon_timestamp);
+                unconditional_access_writer.append(ip, uncon_timestamp);
             }
 
             shotgun.update_current(this, btb_entry, branch_type);
@@ -414,7 +398,7 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
                 if (to_stream_buffer) {
                     stream_buffer.prefetch(ip, branch_target);
                 } else {
-                    uint64_t set = basic_btb_set_index(ip, CONDITIONAL_BTB_SETS);
+                    uint64_t set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
                     auto repl_entry = basic_btb_get_lru_entry(cpu, set, shotgun.conditional_btb);
 
                     repl_entry->ip_tag = ip;
@@ -437,5 +421,10 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
 }
 
 
-void O3_CPU::btb_final_stats() {}
+void O3_CPU::btb_final_stats() {
+    conditional_access_writer.close();
+    unconditional_access_writer.close();
+    btb_record_artifact("btb_conditional_record").commit();
+    btb_record_artifact("btb_unconditional_record").commit();
+}
 
@@ -19,6 +19,8 @@ class BranchBias {
     // Value: first is taken count, second is not taken count.
     uint64_t total_btb_ways;
     uint64_t total_btb_entries;
+    uint64_t warmup_instructions = 0;
+    uint64_t simulation_instructions = 0;
 
     bool record_branch_bias = false;
 public:
@@ -26,9 +28,11 @@ public:
         branch_record.resize(NUM_CPUS);
     }
 
-    void init(uint64_t btb_ways, uint64_t btb_entries) {
+    void init(uint64_t btb_ways, uint64_t btb_entries, uint64_t warmup, uint64_t simulation) {
         total_btb_ways = btb_ways;
         total_btb_entries = btb_entries;
+        warmup_instructions = warmup;
+        simulation_instructions = simulation;
     }
 
     void access(uint64_t ip, uint64_t cpu, bool taken) {
@@ -53,7 +57,15 @@ public:
         }
         auto short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRACE);
         fs::path opt_access_record_path = "/mnt/storage/shixins/champsim_pt/branch_bias_record";
-        fs::create_directory(opt_access_record_path);
+        auto artifact = Artifact("branch_bias_record", short_name, ".csv")
+                .with("btb_ways", total_btb_ways)
+                .with("btb_entries", total_btb_entries)
+                .with("ifetch_buffer_size", IFETCH_BUFFER_SIZE)
+                .with("warmup_instructions", warmup_instructions)
+                .with("simulation_instructions", simulation_instructions);
+        if (!Artifact::enabled()) {
+            fs::create_directory(opt_access_record_path);
+        }
         string sub_dir = "way" + std::to_string(total_btb_ways);
         if (total_btb_entries != 8 && total_btb_entries != 8192) {
             if (total_btb_entries % 1024 == 0) {
@@ -65,8 +77,10 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        fs::create_directory(opt_access_record_path / sub_dir);
-        auto filename = opt_access_record_path / sub_dir / (short_name + ".csv");
+        if (!Artifact::enabled()) {
+            fs::create_directory(opt_access_record_path / sub_dir);
+        }
+        auto filename = artifact.write_path(opt_access_record_path / sub_dir / (short_name + ".csv"));
         cout << "Open branch bias record " << filename << endl;
         ofstream out(filename.c_str());
         assert(out.is_open());
@@ -74,6 +88,8 @@ public:
         for (auto it : branch_record[cpu]) {
             out << std::hex << it.first << "," << it.second.first << "," << it.second.second << endl;
         }
+        out.close();
+        artifact.commit();
     }
 };
 
@@ -0,0 +1,92 @@
+#ifndef CHAMPSIM_PT_BTB_GEOMETRY_H
+#define CHAMPSIM_PT_BTB_GEOMETRY_H
+
+#include <cstdint>
+
+/*
+ * Compile-time specialized BTB geometry.
+ * The BTB size is a runtime knob (-total_btb_ways / -total_btb_entries), so the
+ * plain implementation pays a modulo for every set index and a variable-trip way
+ * loop for every lookup. BTBGeometry is instantiated for the common way counts
+ * with either mask indexing (power-of-two set count) or modulo indexing, and the
+ * matching instantiation is chosen once at startup. WAYS == 0 is the generic
+ * fallback that reads the way count at runtime (e.g. 5-way or 7979-entry BTBs).
+ *
+ * Entries of one set must be stored contiguously; Entry needs ip_tag and lru.
+ */
+template <uint32_t WAYS, bool POW2_SETS>
+struct BTBGeometry {
+    static uint64_t set_index(uint64_t ip, uint64_t sets) {
+        if constexpr (POW2_SETS) {
+            return (ip >> 2) & (sets - 1);
+        } else {
+            return (ip >> 2) % sets;
+        }
+    }
+
+    template <typename Entry>
+    static Entry *find(Entry *set, uint64_t ip, uint32_t ways) {
+        const uint32_t n = WAYS ? WAYS : ways;
+        for (uint32_t i = 0; i < n; i++) {
+            if (set[i].ip_tag == ip) {
+                return &set[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns the first way holding the smallest lru value.
+    template <typename Entry>
+    static Entry *lru(Entry *set, uint32_t ways) {
+        const uint32_t n = WAYS ? WAYS : ways;
+        uint32_t lru_way = 0;
+        for (uint32_t i = 1; i < n; i++) {
+            if (set[i].lru < set[lru_way].lru) {
+                lru_way = i;
+            }
+        }
+        return &set[lru_way];
+    }
+};
+
+// The BTBGeometry instantiation picked for a BTB size: ways is 1, 2, 4, 8, 16 or 0 (generic).
+struct BTBGeometryKind {
+    uint32_t ways;
+    bool pow2_sets;
+};
+
+inline BTBGeometryKind select_btb_geometry(uint32_t ways, uint64_t sets) {
+    bool pow2_sets = sets != 0 && (sets & (sets - 1)) == 0;
+    switch (ways) {
+        case 1: case 2: case 4: case 8: case 16: return {ways, pow2_sets};
+        default: return {0, pow2_sets};
+    }
+}
+
+/*
+ * Ops<WAYS, POW2_SETS> is a BTB implementation templated on its geometry.
+ * with_btb_geometry<Ops>(kind, f) calls f with an Ops value of the selected
+ * instantiation, so each case of the switch is a direct call that inlines the
+ * set indexing, tag scan and LRU scan for the fixed way count. The kind never
+ * changes after startup, so the switch branch is always predicted.
+ */
+template <template <uint32_t, bool> class Ops, bool POW2_SETS, typename F>
+decltype(auto) with_btb_geometry_ways(uint32_t ways, F &&f) {
+    switch (ways) {
+        case 1: return f(Ops<1, POW2_SETS>{});
+        case 2: return f(Ops<2, POW2_SETS>{});
+        case 4: return f(Ops<4, POW2_SETS>{});
+        case 8: return f(Ops<8, POW2_SETS>{});
+        case 16: return f(Ops<16, POW2_SETS>{});
+        default: return f(Ops<0, POW2_SETS>{});
+    }
+}
+
+template <template <uint32_t, bool> class Ops, typename F>
+decltype(auto) with_btb_geometry(BTBGeometryKind kind, F &&f) {
+    if (kind.pow2_sets)
+        return with_btb_geometry_ways<Ops, true>(kind.ways, f);
+    return with_btb_geometry_ways<Ops, false>(kind.ways, f);
+}
+
+#endif //CHAMPSIM_PT_BTB_GEOMETRY_H
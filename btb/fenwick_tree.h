@@ -0,0 +1,57 @@
+#ifndef CHAMPSIM_PT_FENWICK_TREE_H
+#define CHAMPSIM_PT_FENWICK_TREE_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+/*
+ * Binary indexed tree over positions [0, size) with point update and prefix sum in
+ * O(log n). Used to count distinct branches between two accesses (reuse distance).
+ */
+template <typename T>
+class FenwickTree {
+    vector<T> tree; // 1-based
+
+public:
+    FenwickTree() : tree(1, 0) {}
+
+    explicit FenwickTree(uint64_t size) : tree(size + 1, 0) {}
+
+    // Builds the tree from initial values in O(n).
+    explicit FenwickTree(const vector<T> &values) : tree(values.size() + 1, 0) {
+        for (uint64_t i = 1; i < tree.size(); i++) {
+            tree[i] += values[i - 1];
+            auto parent = i + (i & (~i + 1));
+            if (parent < tree.size()) tree[parent] += tree[i];
+        }
+    }
+
+    uint64_t size() const { return tree.size() - 1; }
+
+    void add(uint64_t pos, T delta) {
+        assert(pos < size());
+        for (auto i = pos + 1; i < tree.size(); i += i & (~i + 1)) {
+            tree[i] += delta;
+        }
+    }
+
+    // Sum of [0, pos)
+    T prefix_sum(uint64_t pos) const {
+        assert(pos <= size());
+        T sum = 0;
+        for (auto i = pos; i > 0; i -= i & (~i + 1)) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    // Sum of [begin, end)
+    T range_sum(uint64_t begin, uint64_t end) const {
+        return end <= begin ? 0 : prefix_sum(end) - prefix_sum(begin);
+    }
+};
+
+#endif //CHAMPSIM_PT_FENWICK_TREE_H
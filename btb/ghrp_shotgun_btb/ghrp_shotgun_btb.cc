@@ -12,21 +12,18 @@
 #include <map>
 #include <unordered_map>
 #include "../prefetch_stream_buffer.h"
+#include "../shotgun_geometry.h"
 
 using std::map;
 using std::unordered_map;
 using std::vector;
 
-#define BASIC_BTB_SETS 256
-#define BASIC_BTB_WAYS 4
-#define UNCONDITIONAL_BTB_SETS 1024
-#define UNCONDITIONAL_BTB_WAYS 7
 #define BASIC_BTB_INDIRECT_SIZE 4096
 #define BASIC_BTB_RAS_SIZE 32
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
 uint64_t timestamp = 0;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag = 0;
@@ -58,8 +55,8 @@ struct FOOTPRINT_BTB_ENTRY {
     uint64_t lru_timestamp = 0;
     uint16_t signature = 0;
     bool dead_prediction = false;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> call_footprint;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> return_footprint;
+    ShotgunFootprint call_footprint;
+    ShotgunFootprint return_footprint;
 
     FOOTPRINT_BTB_ENTRY() = default;
 
@@ -70,43 +67,21 @@ struct FOOTPRINT_BTB_ENTRY {
             branch_type(branch_type) {}
 
     void cache_access(BASIC_BTB_ENTRY *access_entry, bool update_call = true) {
-        // access_taken refers to taken or not!
         auto access_block = access_entry->ip_tag >> LOG2_BLOCK_SIZE;
-        uint64_t original_block;
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
         if (update_call) {
-            original_block = target >> LOG2_BLOCK_SIZE;
-            footprint = &call_footprint;
+            call_footprint.record(target >> LOG2_BLOCK_SIZE, access_block);
         } else {
-            original_block = ip_tag >> LOG2_BLOCK_SIZE;
-            footprint = &return_footprint;
-        }
-        // Update footprint
-        if (access_block <= original_block + 6 && access_block >= original_block - 2) {
-            (*footprint)[access_block].push_back(*access_entry);
+            return_footprint.record(ip_tag >> LOG2_BLOCK_SIZE, access_block);
         }
     }
 
     void operate_prefetch(O3_CPU *o3_cpu, bool prefetch_call) {
-        // This function does not actually prefetch instrs. It just add it to prefetch list.
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
-        uint64_t key;
-        if (prefetch_call) {
-            key = ip_tag;
-            footprint = &call_footprint;
-        } else {
-            key = target;
-            footprint = &return_footprint;
-        }
-        for (auto &a : *footprint) {
-            auto &region = o3_cpu->shotgun_prefetch_region[key];
-            region.clear();
-            for (auto &entry : a.second) {
-                region.push_back(entry.ip_tag);
-                // o3_cpu->prefetch_btb(entry.ip_tag, entry.target, entry.branch_type, entry.always_taken != 0);
-            }
+        // This function does not actually prefetch instrs. It just publishes the footprint to the prefetcher.
+        auto &footprint = prefetch_call ? call_footprint : return_footprint;
+        if (!footprint.empty()) {
+            o3_cpu->shotgun_prefetch_region[prefetch_call ? ip_tag : target] = footprint;
         }
-        footprint->clear();
+        footprint.clear();
     }
 };
 
@@ -130,12 +105,9 @@ public:
 };
 
 Shotgun shotgun;
-vector<vector<std::map<uint64_t, BASIC_BTB_ENTRY>>> basic_btb(
-        NUM_CPUS,
-        vector<std::map<uint64_t, BASIC_BTB_ENTRY>>(BASIC_BTB_SETS));
-vector<vector<std::map<uint64_t, FOOTPRINT_BTB_ENTRY>>> unconditional_btb(
-        NUM_CPUS,
-        vector<std::map<uint64_t, FOOTPRINT_BTB_ENTRY>>(UNCONDITIONAL_BTB_SETS));
+ShotgunGeometry shotgun_geometry;
+vector<vector<std::map<uint64_t, BASIC_BTB_ENTRY>>> basic_btb(NUM_CPUS);
+vector<vector<std::map<uint64_t, FOOTPRINT_BTB_ENTRY>>> unconditional_btb(NUM_CPUS);
 
 
 //std::map<uint64_t, BASIC_BTB_ENTRY> basic_btb[NUM_CPUS][BASIC_BTB_SETS];
@@ -432,10 +404,9 @@ private:
     }
 };
 
-vector<GHRP<BASIC_BTB_ENTRY>> basic_ghrp(NUM_CPUS, GHRP<BASIC_BTB_ENTRY>(BASIC_BTB_SETS, BASIC_BTB_WAYS, &basic_btb));
-vector<GHRP<FOOTPRINT_BTB_ENTRY>> unconditional_ghrp(NUM_CPUS, GHRP<FOOTPRINT_BTB_ENTRY>(UNCONDITIONAL_BTB_SETS,
-                                                                                         UNCONDITIONAL_BTB_WAYS,
-                                                                                         &unconditional_btb));
+// Sized in initialize_btb
+vector<GHRP<BASIC_BTB_ENTRY>> basic_ghrp(NUM_CPUS, GHRP<BASIC_BTB_ENTRY>(0, 0, &basic_btb));
+vector<GHRP<FOOTPRINT_BTB_ENTRY>> unconditional_ghrp(NUM_CPUS, GHRP<FOOTPRINT_BTB_ENTRY>(0, 0, &unconditional_btb));
 
 //BASIC_BTB_ENTRY basic_btb[NUM_CPUS][BASIC_BTB_SETS][BASIC_BTB_WAYS];
 //uint64_t basic_btb_lru_counter[NUM_CPUS];
@@ -507,10 +478,19 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
-    std::cout << "GHRP Shotgun BTB sets: " << BASIC_BTB_SETS
-              << " ways: " << BASIC_BTB_WAYS
-              << " unconditional BTB sets: " << UNCONDITIONAL_BTB_SETS
-              << " ways: " << UNCONDITIONAL_BTB_WAYS
+    shotgun_geometry = ShotgunGeometry::from_knobs({256, 4, 1024, 7});
+    shotgun_geometry.require("GHRP", true);
+    basic_btb[cpu].assign(shotgun_geometry.conditional_sets, std::map<uint64_t, BASIC_BTB_ENTRY>());
+    unconditional_btb[cpu].assign(shotgun_geometry.unconditional_sets, std::map<uint64_t, FOOTPRINT_BTB_ENTRY>());
+    basic_ghrp[cpu] = GHRP<BASIC_BTB_ENTRY>(shotgun_geometry.conditional_sets, shotgun_geometry.conditional_ways,
+                                            &basic_btb);
+    unconditional_ghrp[cpu] = GHRP<FOOTPRINT_BTB_ENTRY>(shotgun_geometry.unconditional_sets,
+                                                        shotgun_geometry.unconditional_ways, &unconditional_btb);
+    stream_buffer.init(stream_buffer_capacity);
+    std::cout << "GHRP Shotgun BTB sets: " << shotgun_geometry.conditional_sets
+              << " ways: " << shotgun_geometry.conditional_ways
+              << " unconditional BTB sets: " << shotgun_geometry.unconditional_sets
+              << " ways: " << shotgun_geometry.unconditional_ways
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
@@ -562,7 +542,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
         return std::make_pair(basic_btb_indirect[cpu][basic_btb_indirect_hash(cpu, ip)], always_taken);
     } else if (branch_type == BRANCH_CONDITIONAL) {
         // Access C-BTB
-        uint64_t set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+        uint64_t set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
         auto it = basic_btb[cpu][set].find(ip);
         if (it == basic_btb[cpu][set].end()) {
             // no prediction for this IP
@@ -574,7 +554,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
         return std::make_pair(it->second.target, always_taken);
     } else {
         // Access U-BTB
-        uint64_t set = basic_btb_set_index(ip, UNCONDITIONAL_BTB_SETS);
+        uint64_t set = basic_btb_set_index(ip, shotgun_geometry.unconditional_sets);
         auto it = unconditional_btb[cpu][set].find(ip);
         if (it == unconditional_btb[cpu][set].end()) {
             // no prediction for this IP
@@ -589,7 +569,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -602,7 +582,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             basic_btb_conditional_history[cpu] |= 1;
         }
         // Update basic_btb and add footprint
-        auto set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+        auto set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
         auto it = basic_btb[cpu][set].find(ip);
         if (it == basic_btb[cpu][set].end()) {
             stream_buffer.stream_buffer_update(ip);
@@ -641,13 +621,13 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             basic_btb_call_instr_sizes[cpu][basic_btb_call_size_tracker_hash(call_ip)] = estimated_call_instr_size;
         }
         // Predecode and update current
-        auto set = basic_btb_set_index(call_ip, UNCONDITIONAL_BTB_SETS);
+        auto set = basic_btb_set_index(call_ip, shotgun_geometry.unconditional_sets);
         auto it = unconditional_btb[cpu][set].find(call_ip);
         auto btb_entry = it == unconditional_btb[cpu][set].end() ? nullptr : &(it->second);
         shotgun.update_current(this, btb_entry, branch_type);
     } else {
         // BRANCH_DIRECT_JUMP or BRANCH_DIRECT_CALL
-        uint64_t set = basic_btb_set_index(ip, UNCONDITIONAL_BTB_SETS);
+        uint64_t set = basic_btb_set_index(ip, shotgun_geometry.unconditional_sets);
         auto it = unconditional_btb[cpu][set].find(ip);
         if (it == unconditional_btb[cpu][set].end()) {
             if ((branch_target != 0) && taken) {
@@ -680,7 +660,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
 void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_type, bool taken) {
     // Only for conditional branch
     if (branch_type == BRANCH_CONDITIONAL) {
-        uint64_t set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+        uint64_t set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
         auto it = basic_btb[cpu][set].find(ip);
         if (it == basic_btb[cpu][set].end()) {
             if ((branch_target != 0) && taken) {
@@ -18,7 +18,7 @@
 #define BASIC_BTB_RAS_SIZE 32
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag;
@@ -413,6 +413,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Hawkeye BTB sets: " << BASIC_BTB_SETS
               << " ways: " << BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -489,7 +490,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -12,18 +12,15 @@
 #include <unordered_map>
 #include <vector>
 #include "../prefetch_stream_buffer.h"
+#include "../shotgun_geometry.h"
 
-#define BASIC_BTB_SETS 256
-#define BASIC_BTB_WAYS 4
-#define UNCONDITIONAL_BTB_SETS 1024
-#define UNCONDITIONAL_BTB_WAYS 7
 #define BASIC_BTB_INDIRECT_SIZE 4096
 #define BASIC_BTB_RAS_SIZE 32
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
 using std::unordered_map;
 using std::vector;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag;
@@ -46,8 +43,8 @@ struct FOOTPRINT_BTB_ENTRY {
     uint8_t always_taken;
     uint8_t branch_type;
     uint64_t lru = 0;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> call_footprint;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> return_footprint;
+    ShotgunFootprint call_footprint;
+    ShotgunFootprint return_footprint;
 
     explicit FOOTPRINT_BTB_ENTRY(uint64_t ip = 0, uint64_t target = 0, uint8_t always_taken = 1,
                                  uint8_t branch_type = BRANCH_DIRECT_CALL) :
@@ -57,43 +54,21 @@ struct FOOTPRINT_BTB_ENTRY {
             branch_type(branch_type) {}
 
     void cache_access(BASIC_BTB_ENTRY *access_entry, bool update_call = true) {
-        // access_taken refers to taken or not!
         auto access_block = access_entry->ip_tag >> LOG2_BLOCK_SIZE;
-        uint64_t original_block;
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
         if (update_call) {
-            original_block = target >> LOG2_BLOCK_SIZE;
-            footprint = &call_footprint;
+            call_footprint.record(target >> LOG2_BLOCK_SIZE, access_block);
         } else {
-            original_block = ip_tag >> LOG2_BLOCK_SIZE;
-            footprint = &return_footprint;
-        }
-        // Update footprint
-        if (access_block <= original_block + 6 && access_block >= original_block - 2) {
-            (*footprint)[access_block].push_back(*access_entry);
+            return_footprint.record(ip_tag >> LOG2_BLOCK_SIZE, access_block);
         }
     }
 
     void operate_prefetch(O3_CPU *o3_cpu, bool prefetch_call) {
-        // This function does not actually prefetch instrs. It just add it to prefetch list.
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
-        uint64_t key;
-        if (prefetch_call) {
-            key = ip_tag;
-            footprint = &call_footprint;
-        } else {
-            key = target;
-            footprint = &return_footprint;
-        }
-        for (auto &a : *footprint) {
-            auto &region = o3_cpu->shotgun_prefetch_region[key];
-            region.clear();
-            for (auto &entry : a.second) {
-                region.push_back(entry.ip_tag);
-                // o3_cpu->prefetch_btb(entry.ip_tag, entry.target, entry.branch_type, entry.always_taken != 0);
-            }
+        // This function does not actually prefetch instrs. It just publishes the footprint to the prefetcher.
+        auto &footprint = prefetch_call ? call_footprint : return_footprint;
+        if (!footprint.empty()) {
+            o3_cpu->shotgun_prefetch_region[prefetch_call ? ip_tag : target] = footprint;
         }
-        footprint->clear();
+        footprint.clear();
     }
 };
 
@@ -117,16 +92,9 @@ public:
 };
 
 Shotgun shotgun;
-vector<vector<vector<BASIC_BTB_ENTRY>>> conditional_btb(
-        NUM_CPUS,
-        vector<vector<BASIC_BTB_ENTRY>>(
-                BASIC_BTB_SETS,
-                vector<BASIC_BTB_ENTRY>(BASIC_BTB_WAYS)));
-vector<vector<vector<FOOTPRINT_BTB_ENTRY>>> unconditional_btb(
-        NUM_CPUS,
-        vector<vector<FOOTPRINT_BTB_ENTRY>>(
-                UNCONDITIONAL_BTB_SETS,
-                vector<FOOTPRINT_BTB_ENTRY>(UNCONDITIONAL_BTB_WAYS)));
+ShotgunGeometry shotgun_geometry;
+vector<vector<vector<BASIC_BTB_ENTRY>>> conditional_btb(NUM_CPUS);
+vector<vector<vector<FOOTPRINT_BTB_ENTRY>>> unconditional_btb(NUM_CPUS);
 
 
 //#define NUM_CORE 1
@@ -190,14 +158,9 @@ private:
     vector<map<uint64_t, ADDR_INFO> > addr_history;
 
 public:
-    Hawkeye(uint64_t sets, uint64_t ways) : total_sets(sets), total_ways(ways) {
-        rrpv.resize(sets, vector<uint64_t>(ways));
-        perset_mytimer.resize(sets);
-        signatures.resize(sets, vector<uint64_t>(ways));
-        prefetched.resize(sets, vector<bool>(ways));
+    Hawkeye() {
         demand_predictor = new HAWKEYE_PC_PREDICTOR();
         prefetch_predictor = new HAWKEYE_PC_PREDICTOR();
-        perset_optgen.resize(sets);
     }
 
     ~Hawkeye() {
@@ -206,7 +169,14 @@ public:
     }
 
     // initialize replacement state
-    void InitReplacementState() {
+    void InitReplacementState(uint64_t sets, uint64_t ways) {
+        total_sets = sets;
+        total_ways = ways;
+        rrpv.assign(sets, vector<uint64_t>(ways));
+        perset_mytimer.assign(sets, 0);
+        signatures.assign(sets, vector<uint64_t>(ways));
+        prefetched.assign(sets, vector<bool>(ways));
+        perset_optgen.assign(sets, OPTgen());
         for (int i = 0; i < total_sets; i++) {
             for (int j = 0; j < total_ways; j++) {
                 rrpv[i][j] = maxRRPV;
@@ -420,8 +390,8 @@ public:
     }
 };
 
-Hawkeye conditional_hawkeye(BASIC_BTB_SETS, BASIC_BTB_WAYS);
-Hawkeye unconditional_hawkeye(UNCONDITIONAL_BTB_SETS, UNCONDITIONAL_BTB_WAYS);
+Hawkeye conditional_hawkeye;
+Hawkeye unconditional_hawkeye;
 
 uint64_t basic_btb_indirect[NUM_CPUS][BASIC_BTB_INDIRECT_SIZE];
 uint64_t basic_btb_conditional_history[NUM_CPUS];
@@ -519,15 +489,24 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
-    std::cout << "Hawkeye Shotgun BTB sets: " << BASIC_BTB_SETS
-              << " ways: " << BASIC_BTB_WAYS
-              << " unconditional BTB sets: " << UNCONDITIONAL_BTB_SETS
-              << " ways: " << UNCONDITIONAL_BTB_WAYS
+    // SAMPLED_SET compares the low 6 set bits with the high 6 ones, and OPTgen keeps 2 ways free
+    shotgun_geometry = ShotgunGeometry::from_knobs({256, 4, 1024, 7});
+    shotgun_geometry.require("Hawkeye", true, 64, 3);
+    conditional_btb[cpu].assign(shotgun_geometry.conditional_sets,
+                                vector<BASIC_BTB_ENTRY>(shotgun_geometry.conditional_ways));
+    unconditional_btb[cpu].assign(shotgun_geometry.unconditional_sets,
+                                  vector<FOOTPRINT_BTB_ENTRY>(shotgun_geometry.unconditional_ways));
+    stream_buffer.init(stream_buffer_capacity);
+    std::cout << "Hawkeye Shotgun BTB sets: " << shotgun_geometry.conditional_sets
+              << " ways: " << shotgun_geometry.conditional_ways
+              << " unconditional BTB sets: " << shotgun_geometry.unconditional_sets
+              << " ways: " << shotgun_geometry.unconditional_ways
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
-    conditional_hawkeye.InitReplacementState();
-    unconditional_hawkeye.InitReplacementState();
+    conditional_hawkeye.InitReplacementState(shotgun_geometry.conditional_sets, shotgun_geometry.conditional_ways);
+    unconditional_hawkeye.InitReplacementState(shotgun_geometry.unconditional_sets,
+                                               shotgun_geometry.unconditional_ways);
 
 //    for (uint32_t i = 0; i < BASIC_BTB_SETS; i++) {
 //        for (uint32_t j = 0; j < BASIC_BTB_WAYS; j++) {
@@ -587,7 +566,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 
         always_taken = btb_entry->always_taken;
 //        basic_btb_update_lru(cpu, btb_entry);
-        auto set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+        auto set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
         assert(way != -1);
         conditional_hawkeye.UpdateReplacementState(cpu, set, way, ip, ip, 0, 0, 1);
 
@@ -605,7 +584,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 
         always_taken = btb_entry->always_taken;
 //        basic_btb_update_lru(cpu, btb_entry);
-        auto set = basic_btb_set_index(ip, UNCONDITIONAL_BTB_SETS);
+        auto set = basic_btb_set_index(ip, shotgun_geometry.unconditional_sets);
         assert(way != -1);
         unconditional_hawkeye.UpdateReplacementState(cpu, set, way, ip, ip, 0, 0, 1);
 
@@ -616,7 +595,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -636,7 +615,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             stream_buffer.stream_buffer_update(ip);
             if ((branch_target != 0) && taken) {
                 // no prediction for this entry so far, so allocate one
-                uint64_t set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+                uint64_t set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
 
                 way = conditional_hawkeye.GetVictimInSet(cpu, set, nullptr, ip, ip, 0);
                 assert(way != -1);
@@ -682,7 +661,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
         if (btb_entry == nullptr) {
             if ((branch_target != 0) && taken) {
                 // no prediction for this entry so far, so allocate one
-                uint64_t set = basic_btb_set_index(ip, UNCONDITIONAL_BTB_SETS);
+                uint64_t set = basic_btb_set_index(ip, shotgun_geometry.unconditional_sets);
 
                 way = unconditional_hawkeye.GetVictimInSet(cpu, set, nullptr, ip, ip, 0);
                 assert(way != -1);
@@ -724,7 +703,7 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
                 if (to_stream_buffer) {
                     stream_buffer.prefetch(ip, branch_target);
                 } else {
-                    uint64_t set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+                    uint64_t set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
 
                     way = conditional_hawkeye.GetVictimInSet(cpu, set, nullptr, ip, ip, PREFETCH);
                     assert(way != -1);
@@ -740,7 +719,7 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
                 }
             }
         } else {
-            auto set = basic_btb_set_index(ip, BASIC_BTB_SETS);
+            auto set = basic_btb_set_index(ip, shotgun_geometry.conditional_sets);
             assert(way != -1);
             conditional_hawkeye.UpdateReplacementState(cpu, set, way, ip, ip, 0, PREFETCH, 1);
             // update an existing entry
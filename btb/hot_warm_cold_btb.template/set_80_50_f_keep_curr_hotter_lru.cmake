@@ -9,3 +9,4 @@ set(BTB_CONSIDER_KEEP "true")
 set(BTB_CONSIDER_TAKEN_HISTORY "false")
 set(BTB_WARM_SPLIT "0")
 set(BTB_CURR_HOTTER "true")
+set(BTB_ONLINE_TEMPERATURE "false")
@@ -0,0 +1,12 @@
+set(BTB_HOT_LOWER_BOUND "0.8")
+set(BTB_COLD_UPPER_BOUND "0.5")
+set(BTB_IGNORE_ALL_HOT "false")
+set(BTB_SORT_HIT_ACCESS "false")
+set(BTB_USE_LRU "true")
+set(BTB_CONSIDER_WARM_TAKEN "false")
+set(BTB_CONSIDER_HOT_TAKEN "false")
+set(BTB_CONSIDER_KEEP "true")
+set(BTB_CONSIDER_TAKEN_HISTORY "false")
+set(BTB_WARM_SPLIT "0")
+set(BTB_CURR_HOTTER "true")
+set(BTB_ONLINE_TEMPERATURE "true")
@@ -20,6 +20,9 @@
 #include <set>
 #include <boost/filesystem.hpp>
 #include "../prefetch_stream_buffer.h"
+#include "../thermometer_profile.h"
+#include "../btb_geometry.h"
+#include "temperature_hint.h"
 
 namespace fs = boost::filesystem;
 
@@ -73,96 +76,70 @@ bool curr_hotter = BTB_CURR_HOTTER;
 
 //AccessCounter access_counter(BASIC_BTB_SETS, BASIC_BTB_WAYS);
 //CoverageAccuracy coverage_accuracy;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
-    uint64_t ip_tag;
-    uint64_t target;
+    uint64_t ip_tag = 0;
+    uint64_t target = 0;
+    double hit_access = 0; // Hit access ratio the category was judged from
     uint8_t always_taken = 1;
+    uint8_t category = 0; // Temperature category, judged once when the entry is inserted
+    uint8_t taken_history = 0; // Bit i is the outcome of the (i + 1)-th most recent access
+    uint8_t taken_history_length = 0;
     uint64_t rrpv = SRRIP_LONG_INTERVAL;
     uint64_t lru = 0;
-    deque<bool> taken_history;
+
+    BASIC_BTB_ENTRY() = default;
 
     BASIC_BTB_ENTRY(uint64_t ip, uint64_t target) : ip_tag(ip), target(target) {
-        taken_history.push_back(true);
+        add_to_taken_history(true);
     }
 
     void add_to_taken_history(bool taken) {
-        if (taken_history.size() >= 8) {
-            taken_history.pop_front();
+        taken_history = (uint8_t) ((taken_history << 1) | (taken ? 1 : 0));
+        if (taken_history_length < 8) {
+            taken_history_length++;
         }
-        assert(taken_history.size() < 8);
-        taken_history.push_back(taken);
     }
 
     int get_loop_judge() {
         // Return -1 if the last access is taken. Else, return num of takens before the last not taken
-        if (taken_history.back()) return -1;
+        if (taken_history & 1) return -1;
         int taken_count = 0;
-        for (uint64_t i = 1; i < taken_history.size(); i++) {
-            if (taken_history[taken_history.size() - 1 - i]) return taken_count;
+        for (uint64_t i = 1; i < taken_history_length; i++) {
+            if ((taken_history >> i) & 1) return taken_count;
             taken_count++;
         }
         return taken_count;
     }
 };
 
-enum class CacheType {
-    HOT,
-    WARM,
-    COLD
-};
-
 class HotWarmCold {
     uint64_t total_sets;
     uint64_t total_ways;
     double hot_lower;
     double cold_upper;
     vector<double> category_boundary;
-    vector<vector<unordered_map<uint64_t, BASIC_BTB_ENTRY>>> btb;
-    unordered_map<uint64_t, double> branch_record;
+    // btb[cpu] holds all sets back to back, total_ways entries per set; ip_tag == 0 is an empty way.
+    vector<vector<BASIC_BTB_ENTRY>> btb;
+    bool pow2_sets = true;
+    vector<uint64_t> lru_counter;
+    ThermometerProfile branch_record;
 
-    set<uint64_t> not_trained_branch_record;
+    uint64_t untrained_insert = 0;
+    uint64_t hinted_insert = 0;
+    uint64_t bypassed_insert = 0;
 
     vector<uint64_t> general_evict_counter;
     vector<uint64_t> general_total_counter;
 
-    uint64_t evict_counter[4] = {0};
-    uint64_t total_counter[4] = {0};
-    uint64_t hot_not_taken[2] = {0};
+    // Victim candidates are way indices, and total_ways stands for the current ip.
+    // The lists are reserved in init() so that choosing a victim does not allocate.
+    vector<uint32_t> candidates;
+    vector<uint32_t> not_taken_candidates;
 
-//    struct EvictCompareEntry {
-//        vector<uint8_t> candidate_type; // 0-3 is for old branches in btb, and 4 is for curr branch
-//        vector<bool> candidate_taken;
-//        uint32_t hwc_choice; // 0-4: index of victim chosen by hwc
-//        uint32_t opt_choice; // 0-4: index of victim chosen by opt
-//
-//        static uint32_t judge_index(vector<uint64_t> &candidate_ip, uint64_t target_ip) {
-//            for (uint32_t i = 0; i < candidate_ip.size(); i++) {
-//                if (target_ip == candidate_ip[i])
-//                    return i;
-//            }
-//            assert(0);
-//        }
-//
-//        EvictCompareEntry(unordered_map<uint64_t, BASIC_BTB_ENTRY> &btb_set,
-//                          uint64_t curr_ip, uint64_t hwc_ip, uint64_t opt_ip,
-//                          HotWarmCold *hwc, O3_CPU *ooo_cpu) {
-//            vector<uint64_t> candidate_ip;
-//            for (auto &it : btb_set) {
-//                candidate_ip.push_back(it.first);
-//            }
-//            candidate_ip.push_back(curr_ip);
-//            hwc_choice = judge_index(candidate_ip, hwc_ip);
-//            opt_choice = judge_index(candidate_ip, opt_ip);
-//            for (auto a : candidate_ip) {
-//                candidate_type.push_back(hwc->judge_general_type(a));
-//                candidate_taken.push_back(ooo_cpu->predict_branch(a, 0, 0, 0));
-//            }
-//        }
-//    };
-
-//    vector<EvictCompareEntry> evict_compare_record;
+    static constexpr uint8_t NOT_CANDIDATE = 0xfe; // Current ip that is always kept
+    static constexpr uint32_t NO_VICTIM = std::numeric_limits<uint32_t>::max();
 
 public:
     HotWarmCold(uint64_t sets, uint64_t ways, double hot_lower, double cold_upper, double warm_split) :
@@ -179,78 +156,57 @@ public:
         general_total_counter.resize(num_category(), 0);
     }
 
-//    friend ostream &operator<<(ostream &os, const EvictCompareEntry &entry);
-
     void init(uint64_t sets, uint64_t ways) {
         total_sets = sets;
         total_ways = ways;
-        btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, BASIC_BTB_ENTRY>>(sets));
-//        basic_opt.init(sets, ways);
-//        basic_opt.get_btb_pointer(&btb);
+        btb.assign(NUM_CPUS, vector<BASIC_BTB_ENTRY>(sets * ways));
+        pow2_sets = sets != 0 && (sets & (sets - 1)) == 0;
+        lru_counter.assign(NUM_CPUS, 0);
+        candidates.reserve(ways + 1);
+        not_taken_candidates.reserve(ways + 1);
     }
 
     uint64_t num_category() {
         return category_boundary.size() + 1;
     }
 
+    BASIC_BTB_ENTRY *set_begin(uint64_t cpu, uint64_t set) {
+        return btb[cpu].data() + set * total_ways;
+    }
+
+    void update_lru(BASIC_BTB_ENTRY *entry, uint64_t cpu) {
+        entry->lru = ++lru_counter[cpu];
+    }
+
     void update_lru(uint64_t ip, uint64_t cpu) {
-        auto set = get_set_index(ip);
-        uint64_t max = 0;
-        for (auto &it : btb[cpu][set]) {
-            if (max < it.second.lru) {
-                max = it.second.lru;
-            }
-        }
-        auto find_it = btb[cpu][set].find(ip);
-        assert(find_it != btb[cpu][set].end());
-        find_it->second.lru = max + 1;
+        auto entry = find_way(set_begin(cpu, get_set_index(ip)), ip);
+        assert(entry != nullptr);
+        update_lru(entry, cpu);
+    }
+
+    uint64_t candidate_ip(BASIC_BTB_ENTRY *entries, uint32_t candidate, uint64_t ip) {
+        return candidate == total_ways ? ip : entries[candidate].ip_tag;
     }
 
-    uint64_t find_lru_min(uint64_t set, uint64_t cpu, vector<uint64_t> &candidates) {
+    uint32_t find_lru_min(BASIC_BTB_ENTRY *entries, vector<uint32_t> &candidates) {
         // candidates may contain the current ip, which is not in btb.
         // Use random number to determine whether choosing the current ip, if not, then use lru.
         auto random_index = rand() % candidates.size();
-        auto random_it = btb[cpu][set].find(candidates[random_index]);
-        if (random_it == btb[cpu][set].end()) {
+        if (candidates[random_index] == total_ways) {
             // Randomly choose current ip as the victim.
             return candidates[random_index];
         }
         uint64_t min = std::numeric_limits<uint64_t>::max();
-        uint64_t ip_min = 0;
-        for (auto &candidate_ip : candidates) {
-            auto it = btb[cpu][set].find(candidate_ip);
-            if (it == btb[cpu][set].end())
+        uint32_t way_min = 0;
+        for (auto candidate: candidates) {
+            if (candidate == total_ways)
                 continue;
-            if (min > it->second.lru) {
-                min = it->second.lru;
-                ip_min = it->first;
+            if (min > entries[candidate].lru) {
+                min = entries[candidate].lru;
+                way_min = candidate;
             }
         }
-        return ip_min;
-    }
-
-    void add_to_record(string &line) {
-        istringstream line_stream(line);
-        uint64_t ip, tmp, hit = 0, miss = 0;
-        char trash;
-        line_stream >> hex >> ip >> trash;
-        assert(trash == ',');
-        // Read target
-        line_stream >> hex >> tmp >> trash;
-        assert(trash == ',');
-        // Read type
-        line_stream >> hex >> tmp;
-        while (line_stream >> trash) {
-            assert(trash == ',');
-            if (!(line_stream >> tmp))
-                assert(0);
-            if (tmp == (uint64_t) RecordType::HIT)
-                hit++;
-            else if (tmp == (uint64_t) RecordType::MISS_ONLY || tmp == (uint64_t) RecordType::MISS_INSERT)
-                miss++;
-        }
-        auto percentage = (double) hit / ((double) hit + (double) miss);
-        branch_record.emplace(ip, percentage);
+        return way_min;
     }
 
     void init_record(string &trace_name) {
@@ -268,153 +224,136 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        auto filename = opt_access_record_path / sub_dir / (short_name + ".csv");
+        // A binary profile (thermometer_profile) is used when present, otherwise the CSV record is parsed.
+        auto filename = opt_access_record_path / sub_dir / (short_name + ".bin");
+        if (!fs::exists(filename)) {
+            filename = opt_access_record_artifact(opt_access_record_path, short_name, train_total_btb_ways,
+                                                  train_total_btb_entries)
+                    .read_path(opt_access_record_path / sub_dir / (short_name + ".csv"));
+        }
         cout << "Init opt access record (hit access) " << filename << endl;
-        ifstream in(filename.c_str());
-        assert(in);
-        string line;
-        getline(in, line);
-        while (getline(in, line))
-            add_to_record(line);
-        in.close();
+        bool loaded = branch_record.load(filename.c_str());
+        assert(loaded);
         cout << "Finish init opt access record (hit access) " << filename << endl;
     }
 
-    double get_hit_access_ratio(uint64_t ip) {
-        auto it = branch_record.find(ip);
-        if (it == branch_record.end()) {
-            not_trained_branch_record.insert(ip);
-//            return 0.0;
-            return ((double) rand()) / (double) RAND_MAX;
+    // Hit access ratio that judge_candidate_type() maps back to category.
+    double category_ratio(uint8_t category) {
+        return category < category_boundary.size() ? category_boundary[category] : 1.0;
+    }
+
+    // Sets *untrained (if given) when ip has no known temperature.
+    double get_hit_access_ratio(uint64_t ip, bool *untrained = nullptr) {
+        double ratio;
+        if (!branch_record.lookup(ip, ratio)) {
+            if (untrained != nullptr) *untrained = true;
+            return untrained_hit_access_ratio();
         }
-//        assert(it != branch_record.end());
-        return it->second;
+        return ratio;
     }
 
-    CacheType judge_hot_warm_cold(uint64_t ip) {
-        assert(ip != 0);
-        auto it = branch_record.find(ip);
-        assert(it != branch_record.end());
-        if (it->second >= hot_lower) // TODO: Change here to > to make it the same as my modified code.
-            return CacheType::HOT;
-        else if (it->second <= cold_upper)
-            return CacheType::COLD;
-        else
-            return CacheType::WARM;
+    // Hit access ratio of the category in a trace hint, see temperature_hint.h.
+    double hinted_hit_access_ratio(uint8_t hint) {
+        if (hint & temperature_hint::UNTRAINED) {
+            return untrained_hit_access_ratio();
+        }
+        return category_ratio(temperature_hint::category(hint));
+    }
+
+    double untrained_hit_access_ratio() {
+        // Untrained branches get a random temperature, drawn once when they are inserted.
+        return ((double) rand()) / (double) RAND_MAX;
     }
 
     uint8_t judge_general_type(uint64_t ip) {
         assert(ip != 0);
-        auto hit_access = get_hit_access_ratio(ip);
+        return judge_candidate_type(get_hit_access_ratio(ip));
+    }
+
+    // Category of a hit access ratio for victim selection. The current ip (curr_ip) counts as hot
+    // when it is warm in the highest warm category, and is never a candidate when it is hot.
+    uint8_t judge_candidate_type(double hit_access, bool curr_ip = false) {
         for (uint64_t i = 0; i < category_boundary.size(); i++) {
             if (hit_access <= category_boundary[i]) {
+                if (curr_ip && i + 1 == category_boundary.size()) {
+                    // warm for current ip
+                    return i + 1;
+                }
                 return i;
             }
         }
+        if (curr_ip)
+            return NOT_CANDIDATE;
         return category_boundary.size();
     }
 
     uint64_t get_set_index(uint64_t ip) {
-        return ((ip >> 2) % total_sets);
+        return pow2_sets ? BTBGeometry<0, true>::set_index(ip, total_sets)
+                         : BTBGeometry<0, false>::set_index(ip, total_sets);
+    }
+
+    // The way count is a runtime knob here, so the scan is not specialized.
+    BASIC_BTB_ENTRY *find_way(BASIC_BTB_ENTRY *set, uint64_t ip) {
+        return BTBGeometry<0, true>::find(set, ip, total_ways);
     }
 
     BASIC_BTB_ENTRY *find_btb_entry(uint64_t ip, uint64_t cpu) {
-        auto set = get_set_index(ip);
-        auto it = btb[cpu][set].find(ip);
-        if (it == btb[cpu][set].end()) {
-            return nullptr;
-        } else {
-            it->second.rrpv = 0;
-            return &(it->second);
+        auto entry = find_way(set_begin(cpu, get_set_index(ip)), ip);
+        if (entry != nullptr) {
+            entry->rrpv = 0;
         }
+        return entry;
     }
 
-    uint64_t sort_choose_victim(uint64_t ip, uint64_t cpu, uint64_t set, O3_CPU *ooo_cpu) {
-        // First is hit access ratio, second is ip.
+    uint32_t sort_choose_victim(double curr_hit_access, uint64_t cpu, uint64_t set) {
+        // First is hit access ratio, second is way (total_ways for the current ip).
         double min_hit_access = 1.0;
-        uint64_t min_ip;
+        uint32_t min_way = NO_VICTIM;
         if (consider_keep) {
-            min_hit_access = get_hit_access_ratio(ip);
-            min_ip = ip;
-        }
-        for (auto &it : btb[cpu][set]) {
-            auto hit_access = get_hit_access_ratio(it.first);
-            if (hit_access <= min_hit_access) {
-                min_hit_access = hit_access;
-                min_ip = it.first;
-            }
+            min_hit_access = curr_hit_access;
+            min_way = total_ways;
         }
-        return min_ip;
-    }
-
-    void add_to_candidate(uint64_t ip, vector<vector<uint64_t>> &candidate, bool curr_ip = false) {
-        auto hit_access = get_hit_access_ratio(ip);
-        for (uint64_t i = 0; i < category_boundary.size(); i++) {
-            if (hit_access <= category_boundary[i]) {
-                if (curr_ip && i + 1 == category_boundary.size()) {
-                    // warm for current ip
-                    candidate[i + 1].push_back(ip);
-                    return;
-                }
-                candidate[i].push_back(ip);
-                return;
+        auto entries = set_begin(cpu, set);
+        for (uint32_t i = 0; i < total_ways; i++) {
+            if (entries[i].hit_access <= min_hit_access) {
+                min_hit_access = entries[i].hit_access;
+                min_way = i;
             }
         }
-        if (curr_ip)
-            return;
-        candidate[category_boundary.size()].push_back(ip);
-    }
-
-    void add_to_candidate(uint64_t ip, O3_CPU *ooo_cpu,
-                          vector<uint64_t> &cold_candidate,
-                          vector<uint64_t> &warm_not_taken_candidate,
-                          vector<uint64_t> &warm_taken_candidate,
-                          vector<uint64_t> &hot_candidate) {
-        auto cache_type = judge_hot_warm_cold(ip);
-        if (cache_type == CacheType::COLD) {
-            cold_candidate.push_back(ip);
-        } else if (cache_type == CacheType::WARM) {
-            // TODO: For tage-sc-l the last three parameters is useless, if using other predictor, modify here.
-            auto taken = ooo_cpu->predict_branch(ip, 0, 0, 0);
-            if (consider_warm_taken && taken == 0)
-                warm_not_taken_candidate.push_back(ip);
-            else
-                warm_taken_candidate.push_back(ip);
-        } else {
-            hot_candidate.push_back(ip);
-        }
+        return min_way;
     }
 
-    uint64_t choose_taken_history(vector<uint64_t> &candidate, uint64_t cpu, uint64_t set) {
-        // Return 0 if no victim chosen by this method.
-        if (!consider_taken_history) return 0;
+    uint32_t choose_taken_history(BASIC_BTB_ENTRY *entries, vector<uint32_t> &candidates) {
+        // Return NO_VICTIM if no victim chosen by this method.
+        if (!consider_taken_history) return NO_VICTIM;
         int min_length = 8;
-        uint64_t victim_ip = 0;
-        for (auto candidate_ip : candidate) {
-            auto it = btb[cpu][set].find(candidate_ip);
-            if (it == btb[cpu][set].end()) {
+        uint32_t victim = NO_VICTIM;
+        for (auto candidate: candidates) {
+            if (candidate == total_ways) {
                 // Current ip may be also in the candidate.
                 continue;
             }
-            auto loop_judge = it->second.get_loop_judge();
+            auto loop_judge = entries[candidate].get_loop_judge();
             if (loop_judge >= 0) {
                 if (loop_judge < min_length) {
                     min_length = loop_judge;
-                    victim_ip = candidate_ip;
+                    victim = candidate;
                 }
             }
         }
-        return victim_ip;
+        return victim;
     }
 
-    uint64_t choose_victim_one_category(uint64_t cpu, uint64_t set, vector<uint64_t> &one_category, O3_CPU *ooo_cpu) {
+    uint32_t choose_victim_one_category(uint64_t ip, uint64_t cpu, uint64_t set, vector<uint32_t> &one_category,
+                                        O3_CPU *ooo_cpu) {
         // TODO: Add a parameter judge_taken here to consider whether considering predicted taken or not.
         // If ooo_cpu != nullptr, predict whether taken or not and then determine the victim.
         // If ooo_cpu == nullptr, then we don't consider predict taken here.
-        vector<uint64_t> not_taken_candidates;
+        auto entries = set_begin(cpu, set);
+        not_taken_candidates.clear();
         if (ooo_cpu != nullptr) {
-            for (auto candidate : one_category) {
-                if (ooo_cpu->predict_branch(candidate, 0, 0, 0) == 0) {
+            for (auto candidate: one_category) {
+                if (ooo_cpu->peek_direction(candidate_ip(entries, candidate, ip)) == 0) {
                     not_taken_candidates.push_back(candidate);
                 }
             }
@@ -422,10 +361,10 @@ public:
         auto &final_candidates = not_taken_candidates.empty() ? one_category : not_taken_candidates;
 
         if (use_lru) {
-            return find_lru_min(set, cpu, final_candidates);
+            return find_lru_min(entries, final_candidates);
         }
-        auto taken_history_choice = choose_taken_history(final_candidates, cpu, set);
-        if (taken_history_choice != 0) return taken_history_choice;
+        auto taken_history_choice = choose_taken_history(entries, final_candidates);
+        if (taken_history_choice != NO_VICTIM) return taken_history_choice;
         return final_candidates[rand() % final_candidates.size()];
     }
 
@@ -437,124 +376,77 @@ public:
         return false;
     }
 
-    uint64_t choose_victim_general(uint64_t ip, uint64_t cpu, uint64_t set, O3_CPU *ooo_cpu) {
-        vector<vector<uint64_t>> candidate(num_category());
-        for (auto &it : btb[cpu][set]) {
-            add_to_candidate(it.first, candidate);
+    uint32_t choose_victim_general(uint64_t ip, uint8_t curr_type, uint64_t cpu, uint64_t set, O3_CPU *ooo_cpu) {
+        // Categories are cached in the entries, so this is two scans over the ways.
+        auto entries = set_begin(cpu, set);
+        if (!consider_keep)
+            curr_type = NOT_CANDIDATE;
+        uint8_t lowest = curr_type;
+        for (uint32_t i = 0; i < total_ways; i++) {
+            if (entries[i].category < lowest)
+                lowest = entries[i].category;
         }
-        if (consider_keep) {
-            add_to_candidate(ip, candidate, curr_hotter);
-        }
-        for (uint64_t i = 0; i < candidate.size(); i++) {
-            if (!candidate[i].empty()) {
-                general_evict_counter[i]++;
-                general_total_counter[i] += candidate[i].size();
-                // Judge whether to predict taken with the last parameter.
-                if (judge_consider_taken(i))
-                    return choose_victim_one_category(cpu, set, candidate[i], ooo_cpu);
-                else
-                    return choose_victim_one_category(cpu, set, candidate[i], nullptr);
-            }
+        candidates.clear();
+        for (uint32_t i = 0; i < total_ways; i++) {
+            if (entries[i].category == lowest)
+                candidates.push_back(i);
         }
+        if (curr_type == lowest)
+            candidates.push_back(total_ways);
+        general_evict_counter[lowest]++;
+        general_total_counter[lowest] += candidates.size();
+        // Judge whether to predict taken with the last parameter.
+        if (judge_consider_taken(lowest))
+            return choose_victim_one_category(ip, cpu, set, candidates, ooo_cpu);
+        else
+            return choose_victim_one_category(ip, cpu, set, candidates, nullptr);
     }
 
-    uint64_t choose_victim(uint64_t ip, uint64_t cpu, uint64_t set, O3_CPU *ooo_cpu) {
-        vector<uint64_t> cold_candidate;
-        vector<uint64_t> warm_not_taken_candidate;
-        vector<uint64_t> warm_taken_candidate;
-        vector<uint64_t> hot_candidate;
-        for (auto &it : btb[cpu][set]) {
-            add_to_candidate(it.first, ooo_cpu,
-                             cold_candidate, warm_not_taken_candidate, warm_taken_candidate, hot_candidate);
-        }
-        if (consider_keep) {
-            add_to_candidate(ip, ooo_cpu,
-                             cold_candidate, warm_not_taken_candidate, warm_taken_candidate, hot_candidate);
-        }
-        if (!cold_candidate.empty()) {
-            evict_counter[0]++;
-            total_counter[0] += cold_candidate.size();
-            if (use_lru) {
-                return find_lru_min(set, cpu, cold_candidate);
-            }
-            auto taken_history_choice = choose_taken_history(cold_candidate, cpu, set);
-            if (taken_history_choice != 0) return taken_history_choice;
-            return cold_candidate[rand() % cold_candidate.size()];
-        } else if (!warm_not_taken_candidate.empty()) {
-            evict_counter[1]++;
-            total_counter[1] += warm_not_taken_candidate.size();
-            if (use_lru) {
-                return find_lru_min(set, cpu, warm_not_taken_candidate);
-            }
-            auto taken_history_choice = choose_taken_history(warm_not_taken_candidate, cpu, set);
-            if (taken_history_choice != 0) return taken_history_choice;
-            return warm_not_taken_candidate[rand() % warm_not_taken_candidate.size()];
-        } else if (!warm_taken_candidate.empty()) {
-            evict_counter[2]++;
-            total_counter[2] += warm_taken_candidate.size();
-            if (use_lru) {
-                return find_lru_min(set, cpu, warm_taken_candidate);
+    void insert(uint64_t ip, uint64_t target, uint8_t branch_type, uint64_t cpu, O3_CPU *ooo_cpu,
+                uint8_t hint) {
+        auto set = get_set_index(ip);
+        assert(set < total_sets);
+        auto entries = set_begin(cpu, set);
+        assert(find_way(entries, ip) == nullptr);
+        // A trace hint replaces the profile lookup.
+        double hit_access;
+        bool untrained = false;
+        if (hint & temperature_hint::VALID) {
+            hinted_insert++;
+            if (hint & temperature_hint::BYPASS) {
+                bypassed_insert++;
+                return;
             }
-            auto taken_history_choice = choose_taken_history(warm_taken_candidate, cpu, set);
-            if (taken_history_choice != 0) return taken_history_choice;
-            return warm_taken_candidate[rand() % warm_taken_candidate.size()];
-        } else if (ignore_all_hot) {
-            evict_counter[3]++;
-            return ip;
+            hit_access = hinted_hit_access_ratio(hint);
+            untrained = hint & temperature_hint::UNTRAINED;
         } else {
-            evict_counter[3]++;
-            total_counter[3] += hot_candidate.size();
-            if (use_lru) {
-                return find_lru_min(set, cpu, hot_candidate);
-            }
-            // Hot not taken
-            vector<uint64_t> not_taken;
-            for (auto a : hot_candidate) {
-                if (ooo_cpu->predict_branch(a, 0, 0, 0) == 0)
-                    not_taken.push_back(a);
-            }
-            if (consider_hot_taken && !not_taken.empty()) {
-                hot_not_taken[0]++;
-                hot_not_taken[1] += not_taken.size();
-                auto taken_history_choice = choose_taken_history(not_taken, cpu, set);
-                if (taken_history_choice != 0) return taken_history_choice;
-                return not_taken[rand() % not_taken.size()];
-            }
-            auto taken_history_choice = choose_taken_history(hot_candidate, cpu, set);
-            if (taken_history_choice != 0) return taken_history_choice;
-            return hot_candidate[rand() % hot_candidate.size()];
+            hit_access = get_hit_access_ratio(ip, &untrained);
         }
-    }
-
-//    void add_to_opt_compare_record(uint64_t ip, uint64_t cpu, uint64_t set, uint64_t hwc_victim, O3_CPU *ooo_cpu) {
-//        auto opt_victim = basic_opt.find_victim(ip, cpu);
-//        evict_compare_record.emplace_back(btb[cpu][set], ip, hwc_victim, opt_victim, this, ooo_cpu);
-//    }
-
-    void insert(uint64_t ip, uint64_t target, uint8_t branch_type, uint64_t cpu, O3_CPU *ooo_cpu) {
-        auto set = get_set_index(ip);
-        assert(set < btb[cpu].size());
-        auto it = btb[cpu][set].find(ip);
-        assert(it == btb[cpu][set].end());
-        if (btb[cpu][set].size() >= total_ways) {
+        auto entry = find_way(entries, 0); // Empty way
+        if (entry == nullptr) {
             // Evict
-            uint64_t victim_ip;
+            uint32_t victim;
             if (sort_hit_access) {
-                victim_ip = sort_choose_victim(ip, cpu, set, ooo_cpu);
+                victim = sort_choose_victim(hit_access, cpu, set);
             } else {
-                victim_ip = choose_victim_general(ip, cpu, set, ooo_cpu);
+                victim = choose_victim_general(ip, judge_candidate_type(hit_access, curr_hotter), cpu, set, ooo_cpu);
             }
-//            add_to_opt_compare_record(ip, cpu, set, victim_ip, ooo_cpu);
-            assert(victim_ip != 0);
-//            coverage_accuracy.get_reuse_distance(victim_ip, basic_opt.timestamp - 1, victim_ip == ip);
-            if (victim_ip == ip) return;
-            btb[cpu][set].erase(victim_ip);
-//            access_counter.evict(victim_ip, cpu);
+            assert(victim != NO_VICTIM);
+            if (victim == total_ways) return;
+            entry = &entries[victim];
+        }
+        if (untrained) untrained_insert++;
+        *entry = BASIC_BTB_ENTRY(ip, target);
+        entry->category = judge_candidate_type(hit_access);
+        entry->hit_access = hit_access;
+        update_lru(entry, cpu);
+    }
+
+    void print_final_stats() {
+        cout << "Untrained branch inserts: " << untrained_insert << endl;
+        if (hinted_insert > 0) {
+            cout << "Temperature hinted inserts: " << hinted_insert << " bypassed: " << bypassed_insert << endl;
         }
-        assert(btb[cpu][set].size() < total_ways);
-        btb[cpu][set].emplace(ip, BASIC_BTB_ENTRY(ip, target));
-        update_lru(ip, cpu);
-//        access_counter.insert(ip, cpu, target, branch_type);
     }
 
 //    void print_final_stats(string &trace_name, string &program_name) {
@@ -679,6 +571,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Hot warm cold BTB sets: " << BASIC_BTB_SETS
               << " ways: " << (int) BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -747,7 +640,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -778,7 +671,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
             stream_buffer.stream_buffer_update(ip);
             if ((branch_target != 0) && taken) {
                 // no prediction for this entry so far, so allocate one
-                hot_warm_cold_btb.insert(ip, branch_target, branch_type, cpu, this);
+                hot_warm_cold_btb.insert(ip, branch_target, branch_type, cpu, this, temperature_hint);
             }
         } else {
             if (taken_only) {
@@ -814,7 +707,7 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
                     stream_buffer.prefetch(ip, branch_target);
                 } else {
                     // no prediction for this entry so far, so allocate one
-                    hot_warm_cold_btb.insert(ip, branch_target, branch_type, cpu, this);
+                    hot_warm_cold_btb.insert(ip, branch_target, branch_type, cpu, this, 0);
                 }
             }
         } else {
@@ -843,6 +736,7 @@ void O3_CPU::btb_final_stats() {
          << " BTB miss num: " << btb_miss_taken_branch_count
          << " BTB miss rate: " << ((double) btb_miss_taken_branch_count) / ((double) predicted_taken_branch_count)
          << endl;
+    hot_warm_cold_btb.print_final_stats();
 //    hot_warm_cold_btb.print_final_stats(trace_name, program_name);
 //    coverage_accuracy.print_final_stats(trace_name, program_name, BASIC_BTB_WAYS);
 //    access_counter.print_final_stats(cpu);
@@ -20,6 +20,9 @@
 #include <set>
 #include <boost/filesystem.hpp>
 #include "../prefetch_stream_buffer.h"
+#include "../thermometer_profile.h"
+#include "../opt_access_stream.h"
+#include "../next_use_index.h"
 
 namespace fs = boost::filesystem;
 
@@ -75,7 +78,7 @@ bool curr_hotter = BTB_CURR_HOTTER;
 
 //AccessCounter access_counter(BASIC_BTB_SETS, BASIC_BTB_WAYS);
 CoverageAccuracy coverage_accuracy;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag;
@@ -118,8 +121,8 @@ enum class CacheType {
 template<class T>
 class Opt {
 private:
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_accesses;
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_prefetches;
+    vector<NextUseIndex> future_accesses;
+    vector<NextUseIndex> future_prefetches;
     vector<vector<unordered_map<uint64_t, T>>> *current_btb = nullptr;
     uint64_t total_sets;
     uint64_t total_ways;
@@ -135,8 +138,8 @@ public:
     void init(uint64_t sets, uint64_t ways) {
         total_sets = sets;
         total_ways = ways;
-        future_accesses.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        future_prefetches.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
+        future_accesses.resize(NUM_CPUS);
+        future_prefetches.resize(NUM_CPUS);
     }
 
     void get_btb_pointer(vector<vector<unordered_map<uint64_t, T>>> *btb) {
@@ -145,27 +148,13 @@ public:
 
     void read_record(FILE *demand_record, uint64_t cpu) {
         assert(demand_record != nullptr);
-        uint64_t ip, counter;
-        int type = 0;
-        while (true) {
-            if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-            type = 0;
-            vector<vector<unordered_map<uint64_t, set<uint64_t>>>> *future;
-            if (type == 0) {
-                future = &future_accesses;
-            } else {
-                future = &future_prefetches;
-            }
-            auto set_index = find_set_index(ip);
-            auto it = (*future)[cpu][set_index].find(ip);
-            if (it == (*future)[cpu][set_index].end()) {
-                (*future)[cpu][set_index].emplace_hint(it, ip, set<uint64_t>());
-            }
-            (*future)[cpu][set_index][ip].insert(counter);
-        }
-        last_timestamp = counter;
+        uint64_t last_counter = 0;
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t counter) {
+            last_counter = counter;
+            future_accesses[cpu].add(ip, counter);
+        });
+        last_timestamp = last_counter;
         cout << "The last timestamp: " << last_timestamp << endl;
-        rewind(demand_record);
     }
 
     uint64_t find_set_index(uint64_t ip) {
@@ -188,8 +177,8 @@ public:
 //                assert(time > last_timestamp);
 //            }
             // Evict a btb entry if it is full
-            auto current_it = future_accesses[cpu][set][ip].upper_bound(time);
-            if (current_it == future_accesses[cpu][set][ip].end()) {
+            auto next_use = future_accesses[cpu].next_use(ip, time);
+            if (next_use == NextUseIndex::NEVER) {
                 // There is no point caching the key
                 // cout << "Error: cannot find the corresponding timestamp " << timestamp << endl;
                 return ip;
@@ -198,22 +187,22 @@ public:
             bool prefetch_found = false;
             pair<uint64_t, uint64_t> prefetch_candidate;
             for (auto &entry: (*current_btb)[cpu][set]) {
-                auto it = future_prefetches[cpu][set][entry.first].upper_bound(time);
-                if (it != future_prefetches[cpu][set][entry.first].end()) {
+                auto next_prefetch = future_prefetches[cpu].next_use(entry.first, time);
+                if (next_prefetch != NextUseIndex::NEVER) {
                     // Find the prefetch
                     // Check whether the prefetch is before the next load of this line
-                    auto demand_it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (demand_it != future_accesses[cpu][set][entry.first].end() && (*it) > (*demand_it)) {
+                    auto next_demand = future_accesses[cpu].next_use(entry.first, time);
+                    if (next_demand != NextUseIndex::NEVER && next_prefetch > next_demand) {
                         // Demand load is presend and prefetch comes after the first load, so ignore
                         continue;
                     }
                     if (prefetch_found) {
-                        if (prefetch_candidate.first < *it) {
-                            prefetch_candidate = make_pair(*it, entry.first);
+                        if (prefetch_candidate.first < next_prefetch) {
+                            prefetch_candidate = make_pair(next_prefetch, entry.first);
                         }
                     } else {
                         prefetch_found = true;
-                        prefetch_candidate = make_pair(*it, entry.first);
+                        prefetch_candidate = make_pair(next_prefetch, entry.first);
                     }
                 }
             }
@@ -222,15 +211,15 @@ public:
             } else {
                 // Find victim in future demand access
                 pair<uint64_t, uint64_t> candidate;
-                candidate.first = *current_it;
+                candidate.first = next_use;
                 candidate.second = ip;
                 for (const auto &entry: (*current_btb)[cpu][set]) {
-                    auto it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (it == future_accesses[cpu][set][entry.first].end()) {
+                    auto entry_next_use = future_accesses[cpu].next_use(entry.first, time);
+                    if (entry_next_use == NextUseIndex::NEVER) {
                         candidate.first = last_timestamp + 1;
                         candidate.second = entry.first;
-                    } else if (candidate.first < *it) {
-                        candidate.first = *it;
+                    } else if (candidate.first < entry_next_use) {
+                        candidate.first = entry_next_use;
                         candidate.second = entry.first;
                     }
                 }
@@ -247,7 +236,7 @@ class HotWarmCold {
     uint64_t total_ways;
     vector<double> category_boundary;
     vector<vector<unordered_map<uint64_t, BASIC_BTB_ENTRY>>> btb;
-    unordered_map<uint64_t, double> branch_record;
+    ThermometerProfile branch_record;
 
     set<uint64_t> not_trained_branch_record;
 
@@ -280,7 +269,7 @@ class HotWarmCold {
             opt_choice = judge_index(candidate_ip, opt_ip);
             for (auto a: candidate_ip) {
                 candidate_type.push_back(hwc->judge_general_type(a));
-                candidate_taken.push_back(ooo_cpu->predict_branch(a, 0, 0, 0));
+                candidate_taken.push_back(ooo_cpu->peek_direction(a));
             }
         }
     };
@@ -349,30 +338,6 @@ public:
         return ip_min;
     }
 
-    void add_to_record(string &line) {
-        istringstream line_stream(line);
-        uint64_t ip, tmp, hit = 0, miss = 0;
-        char trash;
-        line_stream >> hex >> ip >> trash;
-        assert(trash == ',');
-        // Read target
-        line_stream >> hex >> tmp >> trash;
-        assert(trash == ',');
-        // Read type
-        line_stream >> hex >> tmp;
-        while (line_stream >> trash) {
-            assert(trash == ',');
-            if (!(line_stream >> tmp))
-                assert(0);
-            if (tmp == (uint64_t) RecordType::HIT)
-                hit++;
-            else if (tmp == (uint64_t) RecordType::MISS_ONLY || tmp == (uint64_t) RecordType::MISS_INSERT)
-                miss++;
-        }
-        auto percentage = (double) hit / ((double) hit + (double) miss);
-        branch_record.emplace(ip, percentage);
-    }
-
     void init_record(string &trace_name, bool with_twig = false) {
         // TODO: Move original opt_access_record to the sub dir.
         auto short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRAIN);
@@ -391,26 +356,26 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        auto filename = opt_access_record_path / sub_dir / (short_name + ".csv");
+        // A binary profile (thermometer_profile) is used when present, otherwise the CSV record is parsed.
+        auto filename = opt_access_record_path / sub_dir / (short_name + ".bin");
+        if (!fs::exists(filename)) {
+            filename = opt_access_record_artifact(opt_access_record_path, short_name, train_total_btb_ways,
+                                                  train_total_btb_entries)
+                    .read_path(opt_access_record_path / sub_dir / (short_name + ".csv"));
+        }
         cout << "Init opt access record (hit access) " << filename << endl;
-        ifstream in(filename.c_str());
-        assert(in);
-        string line;
-        getline(in, line);
-        while (getline(in, line))
-            add_to_record(line);
-        in.close();
+        bool loaded = branch_record.load(filename.c_str());
+        assert(loaded);
     }
 
     double get_hit_access_ratio(uint64_t ip) {
-        auto it = branch_record.find(ip);
-        if (it == branch_record.end()) {
+        double ratio;
+        if (!branch_record.lookup(ip, ratio)) {
             not_trained_branch_record.insert(ip);
             return 0.0;
 //            return ((double) rand()) / (double) RAND_MAX;
         }
-//        assert(it != branch_record.end());
-        return it->second;
+        return ratio;
     }
 
     uint8_t judge_general_type(uint64_t ip) {
@@ -504,7 +469,7 @@ public:
         vector<uint64_t> not_taken_candidates;
         if (ooo_cpu != nullptr) {
             for (auto candidate: one_category) {
-                if (ooo_cpu->predict_branch(candidate, 0, 0, 0) == 0) {
+                if (ooo_cpu->peek_direction(candidate) == 0) {
                     not_taken_candidates.push_back(candidate);
                 }
             }
@@ -711,6 +676,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Hot warm cold new BTB sets: " << BASIC_BTB_SETS
               << " ways: " << (int) BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -779,7 +745,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
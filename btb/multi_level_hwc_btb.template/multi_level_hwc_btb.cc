@@ -9,6 +9,7 @@
 #include "ooo_cpu.h"
 #include "../accuracy.h"
 #include "../prefetch_stream_buffer.h"
+#include "../thermometer_profile.h"
 #include "../branch_bias.h"
 #include "../multi_level_btb.h"
 #include "../access_record.h"
@@ -61,7 +62,7 @@ bool consider_taken_history = BTB_CONSIDER_TAKEN_HISTORY;
 bool curr_hotter = BTB_CURR_HOTTER;
 
 //CoverageAccuracy coverage_accuracy;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 //BranchBias branch_bias;
 
 vector<vector<uint64_t>> btb_level_info = {
@@ -87,7 +88,7 @@ enum class CacheType {
 
 class HWCBTB: public BTB<HWCBTBEntry> {
     vector<double> category_boundary;
-    unordered_map<uint64_t, double> branch_record;
+    ThermometerProfile branch_record;
     BTBType btb_type;
 
 public:
@@ -136,30 +137,6 @@ public:
         return ip_min;
     }
 
-    void add_to_record(string &line) {
-        istringstream line_stream(line);
-        uint64_t ip, tmp, hit = 0, miss = 0;
-        char trash;
-        line_stream >> hex >> ip >> trash;
-        assert(trash == ',');
-        // Read target
-        line_stream >> hex >> tmp >> trash;
-        assert(trash == ',');
-        // Read type
-        line_stream >> hex >> tmp;
-        while (line_stream >> trash) {
-            assert(trash == ',');
-            if (!(line_stream >> tmp))
-                assert(0);
-            if (tmp == (uint64_t) RecordType::HIT)
-                hit++;
-            else if (tmp == (uint64_t) RecordType::MISS_ONLY || tmp == (uint64_t) RecordType::MISS_INSERT)
-                miss++;
-        }
-        auto percentage = (double) hit / ((double) hit + (double) miss);
-        branch_record.emplace(ip, percentage);
-    }
-
     void init_record(string &trace_name) {
         auto short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRAIN);
         fs::path opt_access_record_path = "/mnt/storage/shixins/champsim_pt/opt_access_record" + btb_type_to_suffix(btb_type);
@@ -174,26 +151,26 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        auto filename = opt_access_record_path / sub_dir / (short_name + ".csv");
+        // A binary profile (thermometer_profile) is used when present, otherwise the CSV record is parsed.
+        auto filename = opt_access_record_path / sub_dir / (short_name + ".bin");
+        if (!fs::exists(filename)) {
+            filename = opt_access_record_artifact(opt_access_record_path, short_name, train_total_btb_ways,
+                                                  train_total_btb_entries)
+                    .read_path(opt_access_record_path / sub_dir / (short_name + ".csv"));
+        }
         cout << "Init opt access record (hit access) " << filename << endl;
-        ifstream in(filename.c_str());
-        assert(in);
-        string line;
-        getline(in, line);
-        while (getline(in, line))
-            add_to_record(line);
-        in.close();
+        bool loaded = branch_record.load(filename.c_str());
+        assert(loaded);
     }
 
     double get_hit_access_ratio(uint64_t ip) {
-        auto it = branch_record.find(ip);
-        if (it == branch_record.end()) {
+        double ratio;
+        if (!branch_record.lookup(ip, ratio)) {
 //            not_trained_branch_record.insert(ip);
             return 0.0;
 //            return ((double) rand()) / (double) RAND_MAX;
         }
-//        assert(it != branch_record.end());
-        return it->second;
+        return ratio;
     }
 
     uint8_t judge_general_type(uint64_t ip) {
@@ -232,7 +209,7 @@ public:
         vector<uint64_t> not_taken_candidates;
         if (ooo_cpu != nullptr) {
             for (auto candidate : one_category) {
-                if (ooo_cpu->predict_branch(candidate, 0, 0, 0) == 0) {
+                if (ooo_cpu->peek_direction(candidate) == 0) {
                     not_taken_candidates.push_back(candidate);
                 }
             }
@@ -378,6 +355,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Muli-level Basic BTB" << std::endl
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
@@ -446,7 +424,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
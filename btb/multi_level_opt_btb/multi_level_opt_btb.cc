@@ -9,6 +9,8 @@
 #include "ooo_cpu.h"
 #include "../accuracy.h"
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
+#include "../next_use_index.h"
 #include "../branch_bias.h"
 #include "../multi_level_btb.h"
 #include "../access_record.h"
@@ -27,7 +29,7 @@ extern uint64_t total_btb_entries; // 1K, 2K...
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
 //CoverageAccuracy coverage_accuracy;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 //BranchBias branch_bias;
 
 vector<vector<uint64_t>> btb_level_info = {
@@ -39,8 +41,8 @@ vector<vector<uint64_t>> btb_level_info = {
 };
 
 class OPTBTB: public BTB<BTBEntry> {
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_accesses;
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_prefetches;
+    vector<NextUseIndex> future_accesses;
+    vector<NextUseIndex> future_prefetches;
 public:
     uint64_t last_timestamp = 0;
     uint64_t timestamp = 0;
@@ -48,17 +50,12 @@ public:
 
     OPTBTB(uint64_t latency, uint64_t sets, uint64_t ways, BTBType btb_type) : BTB<BTBEntry>(latency, sets, ways),
                                                                                access_record(btb_type) {
-        future_accesses.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        future_prefetches.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
+        future_accesses.resize(NUM_CPUS);
+        future_prefetches.resize(NUM_CPUS);
     }
 
     void read_record(uint64_t ip, uint64_t counter, uint8_t cpu) {
-        auto set_index = find_set_index(ip);
-        auto it = future_accesses[cpu][set_index].find(ip);
-        if (it == future_accesses[cpu][set_index].end()) {
-            future_accesses[cpu][set_index].emplace_hint(it, ip, set<uint64_t>());
-        }
-        future_accesses[cpu][set_index][ip].insert(counter);
+        future_accesses[cpu].add(ip, counter);
     }
 
     BTBEntry insert(uint64_t ip, uint64_t branch_target, uint8_t branch_type, uint64_t cpu, O3_CPU *ooo_cpu) override {
@@ -69,8 +66,8 @@ public:
         auto time = timestamp - 1;
         if (btb[cpu][set_index].size() >= total_ways) {
             // Evict a btb entry if it is full
-            auto current_it = future_accesses[cpu][set_index][ip].upper_bound(time);
-            if (current_it == future_accesses[cpu][set_index][ip].end()) {
+            auto next_use = future_accesses[cpu].next_use(ip, time);
+            if (next_use == NextUseIndex::NEVER) {
                 // There is no point caching the key
                 return victim;
             }
@@ -78,22 +75,22 @@ public:
             bool prefetch_found = false;
             pair<uint64_t, uint64_t> prefetch_candidate;
             for (auto &entry : btb[cpu][set_index]) {
-                auto it = future_prefetches[cpu][set_index][entry.first].upper_bound(time);
-                if (it != future_prefetches[cpu][set_index][entry.first].end()) {
+                auto next_prefetch = future_prefetches[cpu].next_use(entry.first, time);
+                if (next_prefetch != NextUseIndex::NEVER) {
                     // Find the prefetch
                     // Check whether the prefetch is before the next load of this line
-                    auto demand_it = future_accesses[cpu][set_index][entry.first].upper_bound(time);
-                    if (demand_it != future_accesses[cpu][set_index][entry.first].end() && (*it) > (*demand_it)) {
+                    auto next_demand = future_accesses[cpu].next_use(entry.first, time);
+                    if (next_demand != NextUseIndex::NEVER && next_prefetch > next_demand) {
                         // Demand load is present and prefetch comes after the first load, so ignore
                         continue;
                     }
                     if (prefetch_found) {
-                        if (prefetch_candidate.first < *it) {
-                            prefetch_candidate = make_pair(*it, entry.first);
+                        if (prefetch_candidate.first < next_prefetch) {
+                            prefetch_candidate = make_pair(next_prefetch, entry.first);
                         }
                     } else {
                         prefetch_found = true;
-                        prefetch_candidate = make_pair(*it, entry.first);
+                        prefetch_candidate = make_pair(next_prefetch, entry.first);
                     }
                 }
             }
@@ -104,15 +101,15 @@ public:
             } else {
                 // Find victim in future demand access
                 pair<uint64_t, uint64_t> candidate;
-                candidate.first = *current_it;
+                candidate.first = next_use;
                 candidate.second = ip;
                 for (const auto &entry : btb[cpu][set_index]) {
-                    auto it = future_accesses[cpu][set_index][entry.first].upper_bound(time);
-                    if (it == future_accesses[cpu][set_index][entry.first].end()) {
+                    auto entry_next_use = future_accesses[cpu].next_use(entry.first, time);
+                    if (entry_next_use == NextUseIndex::NEVER) {
                         candidate.first = last_timestamp + 1;
                         candidate.second = entry.first;
-                    } else if (candidate.first < *it) {
-                        candidate.first = *it;
+                    } else if (candidate.first < entry_next_use) {
+                        candidate.first = entry_next_use;
                         candidate.second = entry.first;
                     }
                 }
@@ -140,14 +137,13 @@ public:
     }
 
     void read_record(FILE *demand_record, uint64_t cpu) {
-        uint64_t ip, counter;
-//        std::fseek(demand_record, 0, SEEK_END);
-        while (true) {
-            if (fscanf(demand_record, "%lu %lu", &ip, &counter) == EOF) break;
+        uint64_t counter = 0;
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t timestamp) {
+            counter = timestamp;
             for (auto &level_btb : btbs) {
                 level_btb.read_record(ip, counter, cpu);
             }
-        }
+        });
         for (auto &level_btb : btbs) {
             level_btb.last_timestamp = counter;
         }
@@ -252,6 +248,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Muli-level Basic BTB" << std::endl
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
@@ -320,7 +317,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -0,0 +1,108 @@
+#ifndef CHAMPSIM_PT_NEXT_USE_INDEX_H
+#define CHAMPSIM_PT_NEXT_USE_INDEX_H
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using std::vector;
+using std::unordered_map;
+using std::pair;
+
+/*
+ * Next-use index over an access stream sorted by timestamp (e.g. the OPT btb_record).
+ * Each access stores its timestamp and the distance to the next access to the same IP, so
+ * Belady only needs "when is ip used next after now", which is answered by walking a
+ * per-IP cursor forward. Simulation time never goes backwards, so the walk is amortized
+ * O(1) per access and memory is 12 bytes per access plus one map entry per branch.
+ *
+ * With expire() the index also works as a sliding window: accesses that are in the past
+ * are dropped (this needs the IP of every access, 8 more bytes each), so a bounded
+ * lookahead can be kept by adding new accesses as old ones expire. Expired accesses are
+ * erased from the front in batches, so both modes index plain vectors.
+ */
+class NextUseIndex {
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    static constexpr uint64_t COMPACT_THRESHOLD = 4096;
+
+    vector<uint64_t> times;
+    vector<uint32_t> next; // Distance to the next access to the same ip, NONE if not added yet
+    vector<uint64_t> ips;  // Only kept for expire()
+    uint64_t base = 0;     // Absolute index of times[0]
+    uint64_t head = 0;     // Position of the first access that has not expired
+    bool expiring = false;
+
+    void compact() {
+        times.erase(times.begin(), times.begin() + head);
+        next.erase(next.begin(), next.begin() + head);
+        ips.erase(ips.begin(), ips.begin() + head);
+        base += head;
+        head = 0;
+    }
+    unordered_map<uint64_t, pair<uint64_t, uint64_t>> chains; // ip -> (cursor, last appended)
+
+public:
+    static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+    explicit NextUseIndex(bool expiring = false) : expiring(expiring) {}
+
+    // Accesses must be added in non-decreasing timestamp order.
+    void add(uint64_t ip, uint64_t time) {
+        assert(times.empty() || times.back() <= time);
+        auto index = base + times.size();
+        times.push_back(time);
+        next.push_back(NONE);
+        if (expiring) ips.push_back(ip);
+        auto it = chains.find(ip);
+        if (it == chains.end()) {
+            chains.emplace(ip, std::make_pair(index, index));
+        } else {
+            auto distance = index - it->second.second;
+            assert(distance < NONE);
+            next[it->second.second - base] = (uint32_t) distance;
+            it->second.second = index;
+        }
+    }
+
+    // First access to ip strictly after time, or NEVER. Queries must not go back in time.
+    uint64_t next_use(uint64_t ip, uint64_t time) {
+        auto it = chains.find(ip);
+        if (it == chains.end()) return NEVER;
+        auto &cursor = it->second.first;
+        while (times[cursor - base] <= time) {
+            auto distance = next[cursor - base];
+            if (distance == NONE) return NEVER; // Stay on the last access so later adds are found
+            cursor += distance;
+        }
+        return times[cursor - base];
+    }
+
+    // Drops all accesses at or before time.
+    void expire(uint64_t time) {
+        assert(expiring);
+        while (head < times.size() && times[head] <= time) {
+            auto it = chains.find(ips[head]);
+            assert(it != chains.end());
+            auto index = base + head;
+            if (next[head] == NONE) {
+                chains.erase(it);
+            } else if (it->second.first <= index) {
+                it->second.first = index + next[head];
+            }
+            head++;
+        }
+        if (head >= COMPACT_THRESHOLD && 2 * head >= times.size()) {
+            compact();
+        }
+    }
+
+    uint64_t size() const { return times.size() - head; }
+
+    uint64_t last_time() const { return size() == 0 ? 0 : times.back(); }
+};
+
+#endif //CHAMPSIM_PT_NEXT_USE_INDEX_H
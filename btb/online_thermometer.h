@@ -0,0 +1,171 @@
+#ifndef CHAMPSIM_PT_ONLINE_THERMOMETER_H
+#define CHAMPSIM_PT_ONLINE_THERMOMETER_H
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using std::vector;
+
+#include "hawkeye_btb/optgen.h"
+
+/*
+ * Online Thermometer: learns the temperature (hit-to-taken ratio under OPT) of branches at
+ * runtime instead of reading it from the opt_access_record profile.
+ *
+ * OPT is reconstructed with the OPTgen occupancy vector of hawkeye_btb. Every sampled BTB set
+ * has an OPTgen over its last OPTGEN_VECTOR_SIZE accesses and a sampler with a partial tag and
+ * the last access time of recent branches. When a sampled branch is accessed again within the
+ * vector, OPTgen decides whether OPT would have hit. Each access bumps the access counter of
+ * the branch in a small untagged table of saturating counters, and each OPT hit also bumps its
+ * hit counter.
+ *
+ * A branch maps to exactly one BTB set, so only branches of sampled sets are learned and
+ * the others look untrained. Sampling every set (sampled_sets == 0) is the closest to the
+ * profile-guided Thermometer.
+ */
+class OnlineThermometer {
+    struct SamplerEntry {
+        bool valid = false;
+        uint16_t tag = 0;
+        uint32_t last_time = 0;
+    };
+
+    struct SampledSet {
+        OPTgen optgen;
+        vector<SamplerEntry> sampler;
+        uint32_t time = 0;
+    };
+
+    struct TemperatureCounter {
+        uint8_t hit = 0;
+        uint8_t access = 0;
+    };
+
+    static const uint64_t SAMPLER_ENTRIES_PER_WAY = 8;
+    static const uint64_t SAMPLER_TAG_BITS = 16;
+    static const uint64_t SAMPLER_TIME_BITS = 32;
+    static const uint64_t COUNTER_BITS = 6;
+    static const uint8_t COUNTER_MAX = (1 << COUNTER_BITS) - 1; // Halved on saturation
+
+    uint64_t ways = 0;
+    vector<int64_t> sampled_index; // BTB set -> index in sampled, -1 if not sampled
+    vector<SampledSet> sampled;
+    vector<TemperatureCounter> table;
+
+    uint64_t table_index(uint64_t ip) const {
+        return ((ip >> 2) ^ (ip >> 17)) % table.size();
+    }
+
+    static uint16_t sampler_tag(uint64_t ip) {
+        return (uint16_t) (((ip >> 2) ^ (ip >> 18)) & ((1 << SAMPLER_TAG_BITS) - 1));
+    }
+
+    void train(uint64_t ip, bool hit) {
+        auto &counter = table[table_index(ip)];
+        counter.access++;
+        if (hit) counter.hit++;
+        if (counter.access == COUNTER_MAX) {
+            counter.access >>= 1;
+            counter.hit >>= 1;
+        }
+    }
+
+public:
+    void init(uint64_t sets, uint64_t btb_ways, uint64_t sampled_sets, uint64_t table_entries) {
+        ways = btb_ways;
+        if (sampled_sets == 0 || sampled_sets > sets) {
+            sampled_sets = sets;
+        }
+        auto stride = sets / sampled_sets;
+        sampled_index.assign(sets, -1);
+        sampled.clear();
+        for (uint64_t set = 0; set < sets && sampled.size() < sampled_sets; set += stride) {
+            sampled_index[set] = (int64_t) sampled.size();
+            sampled.emplace_back();
+            sampled.back().optgen.init(ways);
+            sampled.back().sampler.resize(SAMPLER_ENTRIES_PER_WAY * ways);
+        }
+        table.assign(table_entries, TemperatureCounter());
+        std::cout << "Online Thermometer sampled sets: " << sampled.size()
+                  << " history: " << OPTGEN_VECTOR_SIZE
+                  << " table entries: " << table.size() << std::endl;
+    }
+
+    bool is_sampled(uint64_t set) const {
+        return sampled_index[set] >= 0;
+    }
+
+    // Called on every taken access to the BTB set of ip; returns whether OPT would have hit.
+    bool access(uint64_t ip, uint64_t set) {
+        auto index = sampled_index[set];
+        if (index < 0) return false;
+        auto &sampled_set = sampled[index];
+        auto now = sampled_set.time;
+        auto curr_quanta = now % OPTGEN_VECTOR_SIZE;
+        auto tag = sampler_tag(ip);
+
+        SamplerEntry *entry = nullptr;
+        SamplerEntry *victim = &sampled_set.sampler[0];
+        for (auto &candidate : sampled_set.sampler) {
+            if (candidate.valid && candidate.tag == tag) {
+                entry = &candidate;
+                break;
+            }
+            if (!victim->valid) continue;
+            if (!candidate.valid || now - candidate.last_time > now - victim->last_time) {
+                victim = &candidate;
+            }
+        }
+
+        bool hit = false;
+        if (entry != nullptr && now - entry->last_time < OPTGEN_VECTOR_SIZE) {
+            hit = sampled_set.optgen.should_cache(curr_quanta, entry->last_time % OPTGEN_VECTOR_SIZE);
+        }
+        sampled_set.optgen.add_access(curr_quanta);
+        if (entry == nullptr) {
+            entry = victim;
+            entry->valid = true;
+            entry->tag = tag;
+        }
+        entry->last_time = now;
+        sampled_set.time++;
+
+        train(ip, hit);
+        return hit;
+    }
+
+    // Bits of the sampled sets (occupancy vectors, samplers and timers) and the counter table.
+    uint64_t storage_bits() const {
+        uint64_t occupancy_bits = 0;
+        while ((1ULL << occupancy_bits) <= ways) occupancy_bits++;
+        uint64_t sampler_entry_bits = 1 + SAMPLER_TAG_BITS + SAMPLER_TIME_BITS;
+        uint64_t sampled_set_bits = OPTGEN_VECTOR_SIZE * occupancy_bits
+                                    + SAMPLER_ENTRIES_PER_WAY * ways * sampler_entry_bits
+                                    + SAMPLER_TIME_BITS;
+        return sampled.size() * sampled_set_bits + table.size() * 2 * COUNTER_BITS;
+    }
+
+    // Returns false if ip has not been trained (or shares an untrained counter).
+    bool temperature(uint64_t ip, double &ratio) const {
+        auto &counter = table[table_index(ip)];
+        if (counter.access == 0) return false;
+        ratio = (double) counter.hit / (double) counter.access;
+        return true;
+    }
+
+    void print_final_stats() const {
+        uint64_t opt_access = 0, opt_hit = 0;
+        for (auto &sampled_set : sampled) {
+            opt_access += sampled_set.optgen.access;
+            opt_hit += sampled_set.optgen.num_cache;
+        }
+        std::cout << "Online Thermometer sampled accesses: " << opt_access
+                  << " OPT hits: " << opt_hit
+                  << " OPT hit rate: " << (opt_access ? (double) opt_hit / (double) opt_access : 0.0)
+                  << " storage (bytes): " << (storage_bits() + 7) / 8 << std::endl;
+    }
+};
+
+#endif //CHAMPSIM_PT_ONLINE_THERMOMETER_H
@@ -0,0 +1,221 @@
+#ifndef CHAMPSIM_PT_OPT_ACCESS_STREAM_H
+#define CHAMPSIM_PT_OPT_ACCESS_STREAM_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::vector;
+using std::unordered_map;
+
+/*
+ * Binary OPT access record (the btb_record written by opt_btb_generate).
+ *
+ * Layout (little-endian):
+ *   OptAccessHeader
+ *   record stream: for each access, varint(ip id) followed by varint(timestamp delta)
+ *   dictionary:    num_ips raw uint64_t IPs at dict_offset (8-byte aligned), indexed by ip id
+ *
+ * IP ids are assigned in order of first appearance and timestamps are non-decreasing, so
+ * a record usually takes 2-4 bytes instead of ~30 bytes of text. The reader maps the file
+ * and decodes it sequentially, either in one pass (for_each) or incrementally (next); old
+ * text records ("ip timestamp\n") are still accepted.
+ */
+const uint64_t OPT_ACCESS_MAGIC = 0x3130544F42544230ULL; // "0BTBOT01"
+
+struct OptAccessHeader {
+    uint64_t magic;
+    uint64_t num_records;
+    uint64_t num_ips;
+    uint64_t dict_offset;
+    uint64_t last_timestamp;
+};
+
+class OptAccessWriter {
+    FILE *file = nullptr;
+    vector<uint64_t> dict;
+    unordered_map<uint64_t, uint64_t> ip_to_id;
+    vector<uint8_t> buffer;
+    uint64_t num_records = 0;
+    uint64_t last_timestamp = 0;
+    uint64_t bytes_written = sizeof(OptAccessHeader);
+
+    static const size_t FLUSH_SIZE = 1 << 20;
+
+    void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer.push_back((uint8_t) (value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back((uint8_t) value);
+    }
+
+    void flush() {
+        if (buffer.empty()) return;
+        auto written = fwrite(buffer.data(), 1, buffer.size(), file);
+        assert(written == buffer.size());
+        bytes_written += buffer.size();
+        buffer.clear();
+    }
+
+public:
+    void open(FILE *out) {
+        assert(out != nullptr);
+        file = out;
+        OptAccessHeader header = {};
+        auto written = fwrite(&header, sizeof(header), 1, file); // Patched in close()
+        assert(written == 1);
+        buffer.reserve(FLUSH_SIZE + 32);
+    }
+
+    void append(uint64_t ip, uint64_t timestamp) {
+        assert(file != nullptr);
+        assert(timestamp >= last_timestamp);
+        auto it = ip_to_id.find(ip);
+        uint64_t id;
+        if (it == ip_to_id.end()) {
+            id = dict.size();
+            ip_to_id.emplace(ip, id);
+            dict.push_back(ip);
+        } else {
+            id = it->second;
+        }
+        put_varint(id);
+        put_varint(timestamp - last_timestamp);
+        last_timestamp = timestamp;
+        num_records++;
+        if (buffer.size() >= FLUSH_SIZE) flush();
+    }
+
+    void close() {
+        if (file == nullptr) return;
+        flush();
+        // Pad so that the dictionary can be used in place from the mapping
+        uint64_t padding = (8 - bytes_written % 8) % 8;
+        for (uint64_t i = 0; i < padding; i++) fputc(0, file);
+        OptAccessHeader header = {OPT_ACCESS_MAGIC, num_records, dict.size(), bytes_written + padding, last_timestamp};
+        fwrite(dict.data(), sizeof(uint64_t), dict.size(), file);
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        fflush(file);
+        std::cout << "OPT access record: " << num_records << " accesses, " << dict.size() << " branches, "
+                  << header.dict_offset + dict.size() * sizeof(uint64_t) << " bytes" << std::endl;
+        file = nullptr;
+    }
+};
+
+class OptAccessReader {
+    FILE *file = nullptr;
+    void *map = nullptr;
+    uint64_t map_size = 0;
+    const uint64_t *dict = nullptr;
+    const uint8_t *p = nullptr;
+    const uint8_t *end = nullptr;
+    uint64_t remaining = 0;
+    uint64_t num_ips = 0;
+    uint64_t timestamp = 0;
+
+    static uint64_t get_varint(const uint8_t *&p, const uint8_t *end) {
+        uint64_t value = 0;
+        for (int shift = 0; p < end; shift += 7) {
+            uint8_t byte = *p++;
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    }
+
+public:
+    OptAccessReader() = default;
+    OptAccessReader(const OptAccessReader &other) = delete;
+    OptAccessReader &operator=(const OptAccessReader &other) = delete;
+
+    ~OptAccessReader() { close(); }
+
+    // Maps a binary record, or falls back to parsing the old text format from the current file.
+    void open(FILE *in) {
+        assert(in != nullptr);
+        close();
+        file = in;
+        rewind(file);
+        timestamp = 0;
+        struct stat st = {};
+        fstat(fileno(file), &st);
+        auto size = (uint64_t) st.st_size;
+        if (size < sizeof(OptAccessHeader)) return;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        assert(mapped != MAP_FAILED);
+        auto header = (const OptAccessHeader *) mapped;
+        if (header->magic == 0) {
+            // A text record starts with a digit, so this is the placeholder of a writer that never closed.
+            std::cerr << "Incomplete OPT access record: the generator did not finish writing it" << std::endl;
+            abort();
+        }
+        if (header->magic != OPT_ACCESS_MAGIC) {
+            munmap(mapped, size);
+            return;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        assert(header->dict_offset + header->num_ips * sizeof(uint64_t) <= size);
+        map = mapped;
+        map_size = size;
+        auto base = (const uint8_t *) map;
+        dict = (const uint64_t *) (base + header->dict_offset);
+        p = base + sizeof(OptAccessHeader);
+        end = base + header->dict_offset;
+        remaining = header->num_records;
+        num_ips = header->num_ips;
+    }
+
+    // Decodes the next access; returns false at the end of the record.
+    bool next(uint64_t &ip, uint64_t &time) {
+        if (file == nullptr) return false;
+        if (map == nullptr) {
+            unsigned long long text_ip, text_counter;
+            if (fscanf(file, "%llu %llu", &text_ip, &text_counter) != 2) return false;
+            ip = text_ip;
+            time = text_counter;
+            return true;
+        }
+        if (remaining == 0) return false;
+        uint64_t id = get_varint(p, end);
+        timestamp += get_varint(p, end);
+        assert(id < num_ips);
+        remaining--;
+        ip = dict[id];
+        time = timestamp;
+        return true;
+    }
+
+    // Unmaps the record and rewinds the file.
+    void close() {
+        if (map != nullptr) {
+            munmap(map, map_size);
+            map = nullptr;
+        }
+        if (file != nullptr) {
+            rewind(file);
+            file = nullptr;
+        }
+    }
+
+    // Calls f(ip, timestamp) for every access in order and rewinds the file afterwards.
+    template <typename F>
+    static void for_each(FILE *in, F &&f) {
+        OptAccessReader reader;
+        reader.open(in);
+        uint64_t ip, time;
+        while (reader.next(ip, time)) {
+            f(ip, time);
+        }
+        reader.close();
+    }
+};
+
+#endif //CHAMPSIM_PT_OPT_ACCESS_STREAM_H
@@ -14,9 +14,12 @@
 #include "../access_record.h"
 #include "../accuracy.h"
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
+#include "../next_use_index.h"
 
 extern uint8_t total_btb_ways;
 extern uint64_t total_btb_entries; // 1K, 2K...
+extern uint64_t opt_window;
 
 #define BASIC_BTB_SETS (total_btb_entries / total_btb_ways)
 #define BASIC_BTB_WAYS total_btb_ways
@@ -25,7 +28,7 @@ extern uint64_t total_btb_entries; // 1K, 2K...
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
 CoverageAccuracy coverage_accuracy;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag;
@@ -46,68 +49,96 @@ AccessRecord access_record;
 template<class T>
 class Opt {
 private:
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_accesses;
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_prefetches;
-    vector<vector<unordered_map<uint64_t, T>>> current_btb;
+    struct Resident {
+        T entry;
+        uint64_t next_use; // Cached next access time, refreshed once it is in the past
+    };
+
+    vector<NextUseIndex> future_accesses;
+    vector<NextUseIndex> future_prefetches;
+    vector<vector<unordered_map<uint64_t, Resident>>> current_btb;
     uint64_t total_sets;
     uint64_t total_ways;
 
     uint64_t last_timestamp = 0;
-public:
-    uint64_t timestamp = 0;
 
-    Opt(uint64_t total_sets, uint64_t total_ways) : total_sets(total_sets), total_ways(total_ways) {}
+    // Streaming mode (opt_window > 0): only the next opt_window accesses are kept, and
+    // accesses beyond that horizon are treated as never reused.
+    OptAccessReader record_stream[NUM_CPUS];
+    bool record_exhausted[NUM_CPUS] = {};
+    TwigFootprint *twig_match = nullptr;
+    uint64_t opt_decisions = 0;
+    uint64_t horizon_decisions = 0; // The victim (or bypassed branch) was picked for being beyond the horizon
+    uint64_t horizon_ties = 0;      // More than one candidate was beyond the horizon, so the order is unknown
+
+    uint64_t resident_next_use(uint64_t cpu, uint64_t ip, Resident &resident, uint64_t time) {
+        if (resident.next_use <= time || resident.next_use == NextUseIndex::NEVER) {
+            resident.next_use = future_accesses[cpu].next_use(ip, time);
+        }
+        return resident.next_use;
+    }
 
-    void init(uint64_t sets, uint64_t ways) {
-        total_sets = sets;
-        total_ways = ways;
-        future_accesses.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        future_prefetches.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        current_btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, T>>(total_sets));
+    bool beyond_horizon(uint64_t cpu, uint64_t next_use) {
+        return next_use == NextUseIndex::NEVER && opt_window != 0 && !record_exhausted[cpu];
     }
 
-    void add_to_future(uint64_t cpu, uint64_t ip, uint64_t counter, vector<vector<unordered_map<uint64_t, set<uint64_t>>>> *future) {
-        auto set_index = find_set_index(ip);
-        auto it = (*future)[cpu][set_index].find(ip);
-        if (it == (*future)[cpu][set_index].end()) {
-            (*future)[cpu][set_index].emplace_hint(it, ip, set<uint64_t>());
+    void add_access(uint64_t cpu, uint64_t ip, uint64_t counter) {
+        // NOTE: We only consider prefetch record for Twig!
+        future_accesses[cpu].add(ip, counter);
+        // Add twig prefetch record if needed
+        if (twig_match != nullptr) {
+            for (auto &a : twig_match->find(ip)) {
+                future_prefetches[cpu].add(a.pc, counter);
+            }
         }
-        (*future)[cpu][set_index][ip].insert(counter);
     }
 
-    void read_record(FILE *demand_record, uint64_t cpu, unordered_map<uint64_t, vector<pair<uint64_t, uint64_t>>> *twig_prefetch_match) {
+    // Slides the lookahead window to start after time.
+    void advance(uint64_t cpu, uint64_t time) {
+        if (opt_window == 0) return;
+        future_accesses[cpu].expire(time);
+        future_prefetches[cpu].expire(time);
         uint64_t ip, counter;
-        int type = 0;
-        while (true) {
-            if (generate_record) {
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            } else {
-//                if (fscanf(demand_record, "%llu %llu %d", &ip, &counter, &type) == EOF) break;
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            }
-            vector<vector<unordered_map<uint64_t, set<uint64_t>>>> *future;
-            if (type == 0) {
-                future = &future_accesses;
+        while (!record_exhausted[cpu] && future_accesses[cpu].size() < opt_window) {
+            if (record_stream[cpu].next(ip, counter)) {
+                add_access(cpu, ip, counter);
             } else {
-                future = &future_prefetches;
-            }
-            // NOTE: We only consider prefetch record for Twig!
-            add_to_future(cpu, ip, counter,&future_accesses);
-            // Add twig prefetch record if needed
-            if (twig_prefetch_match != nullptr) {
-                auto it = twig_prefetch_match->find(ip);
-                if (it != twig_prefetch_match->end()) {
-                    for (auto &a : it->second) {
-                        add_to_future(cpu, a.first, counter, &future_prefetches);
-                    }
-                }
+                record_exhausted[cpu] = true;
             }
         }
+    }
+public:
+    uint64_t timestamp = 0;
+
+    Opt(uint64_t total_sets, uint64_t total_ways) : total_sets(total_sets), total_ways(total_ways) {}
+
+    void init(uint64_t sets, uint64_t ways) {
+        total_sets = sets;
+        total_ways = ways;
+        future_accesses.resize(NUM_CPUS, NextUseIndex(opt_window != 0));
+        future_prefetches.resize(NUM_CPUS, NextUseIndex(opt_window != 0));
+        current_btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, Resident>>(total_sets));
+    }
+
+    void read_record(FILE *demand_record, uint64_t cpu, TwigFootprint *twig_prefetch_match) {
+        twig_match = twig_prefetch_match;
+        if (opt_window != 0) {
+            record_stream[cpu].open(demand_record);
+            advance(cpu, 0);
+            // The end of the record is unknown, so dead entries rank behind every real next use
+            last_timestamp = NextUseIndex::NEVER - 1;
+            cout << "OPT lookahead window: " << opt_window << " accesses" << endl;
+            return;
+        }
+        uint64_t counter = 0;
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t timestamp) {
+            counter = timestamp;
+            add_access(cpu, ip, counter);
+        });
         last_timestamp = counter;
         cout << "The last timestamp: " << last_timestamp << endl;
-        rewind(demand_record);
+        cout << "OPT next-use index: " << future_accesses[cpu].size() << " accesses, "
+             << future_prefetches[cpu].size() << " prefetches" << endl;
     }
 
     uint64_t find_set_index(uint64_t ip) {
@@ -117,82 +148,99 @@ public:
     T *find_btb_entry(uint64_t ip, uint64_t cpu) {
         auto set = find_set_index(ip);
         auto it = current_btb[cpu][set].find(ip);
-        return it == current_btb[cpu][set].end() ? nullptr : &(it->second);
+        return it == current_btb[cpu][set].end() ? nullptr : &(it->second.entry);
+    }
+
+    // Coverage accuracy needs the whole record, so it is not tracked in streaming mode.
+    void check_accuracy(uint64_t ip, uint64_t time, bool bypass) {
+        if (opt_window == 0) {
+            coverage_accuracy.get_reuse_distance(ip, time, bypass);
+        }
     }
 
     bool insert_to_btb(uint64_t ip, uint64_t cpu, uint64_t branch_target, uint8_t branch_type) {
         auto set = find_set_index(ip);
         auto time = timestamp - 1; // Get the current timestamp (we've +1 before the prediction)
+        advance(cpu, time);
+        auto next_use = future_accesses[cpu].next_use(ip, time);
         if (current_btb[cpu][set].size() == total_ways) {
-//            if (future_accesses[cpu][set][ip].find(time) == future_accesses[cpu][set][ip].end()) {
-//                assert(time > last_timestamp);
-//            }
-//            assert(future_accesses[cpu][set][ip].find(time) != future_accesses[cpu][set][ip].end());
             // Evict a btb entry if it is full
-            auto current_it = future_accesses[cpu][set][ip].upper_bound(time);
-            if (current_it == future_accesses[cpu][set][ip].end()) {
+            opt_decisions++;
+            if (next_use == NextUseIndex::NEVER) {
                 // There is no point caching the key
-                // cout << "Error: cannot find the corresponding timestamp!" << endl;
-                coverage_accuracy.get_reuse_distance(ip, time, true);
+                if (beyond_horizon(cpu, next_use)) horizon_decisions++;
+                check_accuracy(ip, time, true);
                 return false;
             }
             // First, find the one among the current set will be prefetched furthest
             bool prefetch_found = false;
             pair<uint64_t, uint64_t> prefetch_candidate;
             for (auto &entry : current_btb[cpu][set]) {
-                auto it = future_prefetches[cpu][set][entry.first].upper_bound(time);
-                if (it != future_prefetches[cpu][set][entry.first].end()) {
+                auto next_prefetch = future_prefetches[cpu].next_use(entry.first, time);
+                if (next_prefetch != NextUseIndex::NEVER) {
                     // Find the prefetch
                     // Check whether the prefetch is before the next load of this line
-                    auto demand_it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (demand_it != future_accesses[cpu][set][entry.first].end() && (*it) > (*demand_it)) {
+                    auto next_demand = resident_next_use(cpu, entry.first, entry.second, time);
+                    if (next_demand != NextUseIndex::NEVER && next_prefetch > next_demand) {
                         // Demand load is presend and prefetch comes after the first load, so ignore
                         continue;
                     }
                     if (prefetch_found) {
-                        if (prefetch_candidate.first < *it) {
-                            prefetch_candidate = make_pair(*it, entry.first);
+                        if (prefetch_candidate.first < next_prefetch) {
+                            prefetch_candidate = make_pair(next_prefetch, entry.first);
                         }
                     } else {
                         prefetch_found = true;
-                        prefetch_candidate = make_pair(*it, entry.first);
+                        prefetch_candidate = make_pair(next_prefetch, entry.first);
                     }
                 }
             }
             if (prefetch_found) {
                 current_btb[cpu][set].erase(prefetch_candidate.second);
                 access_record.evict(prefetch_candidate.second, cpu);
-                coverage_accuracy.get_reuse_distance(prefetch_candidate.second, time, false);
+                check_accuracy(prefetch_candidate.second, time, false);
             } else {
                 // Find victim in future demand access
                 pair<uint64_t, uint64_t> candidate;
-                candidate.first = *current_it;
+                candidate.first = next_use;
                 candidate.second = ip;
-                for (const auto &entry : current_btb[cpu][set]) {
-                    auto it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (it == future_accesses[cpu][set][entry.first].end()) {
+                uint64_t beyond = 0;
+                for (auto &entry : current_btb[cpu][set]) {
+                    auto entry_next_use = resident_next_use(cpu, entry.first, entry.second, time);
+                    if (beyond_horizon(cpu, entry_next_use)) beyond++;
+                    if (entry_next_use == NextUseIndex::NEVER) {
                         candidate.first = last_timestamp + 1; // It should be total num of branch accesses!!!
                         candidate.second = entry.first;
-                    } else if (candidate.first < *it) {
-                        candidate.first = *it;
+                    } else if (candidate.first < entry_next_use) {
+                        candidate.first = entry_next_use;
                         candidate.second = entry.first;
                     }
                 }
+                if (beyond > 0) horizon_decisions++;
+                if (beyond > 1) horizon_ties++;
                 if (candidate.second == ip) {
-                    coverage_accuracy.get_reuse_distance(ip, time, true);
+                    check_accuracy(ip, time, true);
                     return false;
                 } else {
                     current_btb[cpu][set].erase(candidate.second);
                     access_record.evict(candidate.second, cpu);
-                    coverage_accuracy.get_reuse_distance(candidate.second, time, false);
+                    check_accuracy(candidate.second, time, false);
                 }
             }
         }
-        current_btb[cpu][set].emplace(ip, BASIC_BTB_ENTRY());
+        current_btb[cpu][set].emplace(ip, Resident{T(), next_use});
 //        access_counter.insert(ip, cpu, branch_target, branch_type);
         return true;
     }
 
+    void print_window_stats() {
+        if (opt_window == 0) return;
+        cout << "OPT window decisions: " << opt_decisions
+             << " horizon decisions: " << horizon_decisions
+             << " horizon ties: " << horizon_ties
+             << " horizon decision rate: "
+             << (opt_decisions == 0 ? 0 : (double) horizon_decisions / (double) opt_decisions) << endl;
+    }
 };
 
 Opt<BASIC_BTB_ENTRY> basic_opt(BASIC_BTB_SETS, BASIC_BTB_WAYS);
@@ -272,6 +320,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "OPT BTB sets: " << BASIC_BTB_SETS
               << " ways: " << (int) BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -279,7 +328,9 @@ void O3_CPU::initialize_btb() {
 
     open_btb_record("r", false);
 
-    coverage_accuracy.init(btb_record, BASIC_BTB_SETS, BASIC_BTB_WAYS);
+    // The coverage accuracy needs the whole record, which the streaming mode avoids loading
+    if (opt_window == 0)
+        coverage_accuracy.init(btb_record, BASIC_BTB_SETS, BASIC_BTB_WAYS);
 
     basic_opt.init(BASIC_BTB_SETS, BASIC_BTB_WAYS);
 
@@ -350,7 +401,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -446,5 +497,7 @@ void O3_CPU::btb_final_stats() {
 //    access_counter.print_final_stats(cpu);
 //    assert(access_record.btb_type == BTBType::NORMAL);
     access_record.print_final_stats(trace_name, cpu, twig_prefetch_match != nullptr);
-    coverage_accuracy.print_final_stats(trace_name, program_name, BASIC_BTB_WAYS);
+    basic_opt.print_window_stats();
+    if (opt_window == 0)
+        coverage_accuracy.print_final_stats(trace_name, program_name, BASIC_BTB_WAYS);
 }
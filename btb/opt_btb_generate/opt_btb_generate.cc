@@ -8,6 +8,7 @@
 
 #include "ooo_cpu.h"
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
 
 using std::vector;
 
@@ -20,7 +21,8 @@ extern uint8_t total_btb_ways;
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
 
 uint64_t timestamp = 0;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
+OptAccessWriter opt_access_writer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag = 0;
@@ -127,12 +129,18 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "OPT Generate BTB sets: " << BASIC_BTB_SETS
               << " ways: " << BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
+    if (btb_record_artifact("btb_record_insert_taken").current()) {
+        cout << "OPT record of " << trace_name << " is up to date in the artifact store" << endl;
+        exit(0);
+    }
     open_btb_record("w", false);
+    opt_access_writer.open(btb_record);
 
     basic_btb.resize(NUM_CPUS, vector<vector<BASIC_BTB_ENTRY>>(BASIC_BTB_SETS, vector<BASIC_BTB_ENTRY>(BASIC_BTB_WAYS)));
 
@@ -199,7 +207,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -238,7 +246,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
                 repl_entry->target = branch_target;
                 repl_entry->always_taken = 1;
                 basic_btb_update_lru(cpu, repl_entry);
-                fprintf(btb_record, "%llu %llu\n", ip, timestamp);
+                opt_access_writer.append(ip, timestamp);
 //                reuse_distance.access(ip, branch_target, branch_type, cpu);
             }
 //            reuse_distance.access(ip, branch_target, branch_type, cpu);
@@ -248,7 +256,7 @@ void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
                 btb_entry->always_taken = 0;
             } else {
                 btb_entry->target = branch_target;
-                fprintf(btb_record, "%llu %llu\n", ip, timestamp);
+                opt_access_writer.append(ip, timestamp);
 //                reuse_distance.access(ip, branch_target, branch_type, cpu);
             }
 //            fprintf(btb_record, "%llu %llu\n", ip, timestamp++);
@@ -295,6 +303,8 @@ void O3_CPU::prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_ty
 }
 
 void O3_CPU::btb_final_stats() {
+    opt_access_writer.close();
+    btb_record_artifact("btb_record_insert_taken").commit();
     // TODO: Not all reuse distance and access counter functions in comments are useful and correct. Review Git history if needed.
 //    reuse_distance.print_final_stats(trace_name, cpu);
 //    access_counter.print_final_stats(cpu);
@@ -11,12 +11,11 @@
 #include <set>
 #include <vector>
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
+#include "../next_use_index.h"
 #include "../access_record.h"
+#include "../shotgun_geometry.h"
 
-#define BASIC_BTB_SETS 384
-#define BASIC_BTB_WAYS 4
-#define UNCONDITIONAL_BTB_SETS 1280
-#define UNCONDITIONAL_BTB_WAYS 4
 #define BASIC_BTB_INDIRECT_SIZE 4096
 #define BASIC_BTB_RAS_SIZE 1536
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
@@ -26,7 +25,7 @@ using std::set;
 using std::vector;
 
 bool generate_record = false;
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 struct BASIC_BTB_ENTRY {
     uint64_t ip_tag;
@@ -47,8 +46,8 @@ struct FOOTPRINT_BTB_ENTRY {
     uint64_t target;
     uint8_t always_taken;
     uint8_t branch_type;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> call_footprint;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> return_footprint;
+    ShotgunFootprint call_footprint;
+    ShotgunFootprint return_footprint;
 
     explicit FOOTPRINT_BTB_ENTRY(uint64_t ip = 0, uint64_t target = 0, uint8_t always_taken = 1,
                                  uint8_t branch_type = BRANCH_DIRECT_CALL) :
@@ -58,43 +57,21 @@ struct FOOTPRINT_BTB_ENTRY {
             branch_type(branch_type) {}
 
     void cache_access(BASIC_BTB_ENTRY *access_entry, bool update_call = true) {
-        // access_taken refers to taken or not!
         auto access_block = access_entry->ip_tag >> LOG2_BLOCK_SIZE;
-        uint64_t original_block;
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
         if (update_call) {
-            original_block = target >> LOG2_BLOCK_SIZE;
-            footprint = &call_footprint;
+            call_footprint.record(target >> LOG2_BLOCK_SIZE, access_block);
         } else {
-            original_block = ip_tag >> LOG2_BLOCK_SIZE;
-            footprint = &return_footprint;
-        }
-        // Update footprint
-        if (access_block <= original_block + 6 && access_block >= original_block - 2) {
-            (*footprint)[access_block].push_back(*access_entry);
+            return_footprint.record(ip_tag >> LOG2_BLOCK_SIZE, access_block);
         }
     }
 
     void operate_prefetch(O3_CPU *o3_cpu, bool prefetch_call) {
-        // This function does not actually prefetch instrs. It just add it to prefetch list.
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
-        uint64_t key;
-        if (prefetch_call) {
-            key = ip_tag;
-            footprint = &call_footprint;
-        } else {
-            key = target;
-            footprint = &return_footprint;
-        }
-        for (auto &a : *footprint) {
-            auto &region = o3_cpu->shotgun_prefetch_region[key];
-            region.clear();
-            for (auto &entry : a.second) {
-                region.push_back(entry.ip_tag);
-                // o3_cpu->prefetch_btb(entry.ip_tag, entry.target, entry.branch_type, entry.always_taken != 0);
-            }
+        // This function does not actually prefetch instrs. It just publishes the footprint to the prefetcher.
+        auto &footprint = prefetch_call ? call_footprint : return_footprint;
+        if (!footprint.empty()) {
+            o3_cpu->shotgun_prefetch_region[prefetch_call ? ip_tag : target] = footprint;
         }
-        footprint->clear();
+        footprint.clear();
     }
 };
 
@@ -120,8 +97,8 @@ public:
 template<class T>
 class Opt {
 private:
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_accesses;
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_prefetches;
+    vector<NextUseIndex> future_accesses;
+    vector<NextUseIndex> future_prefetches;
     vector<vector<unordered_map<uint64_t, T>>> current_btb;
     uint64_t total_sets;
     uint64_t total_ways;
@@ -131,39 +108,24 @@ public:
     uint64_t timestamp = 0;
     AccessRecord access_record;
 
-    Opt(uint64_t total_sets, uint64_t total_ways, BTBType btb_type) : total_sets(total_sets), total_ways(total_ways), access_record(btb_type) {
-        future_accesses.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        future_prefetches.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        current_btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, T>>(total_sets));
+    explicit Opt(BTBType btb_type) : access_record(btb_type) {
+        future_accesses.resize(NUM_CPUS);
+        future_prefetches.resize(NUM_CPUS);
+    }
+
+    void init(uint64_t sets, uint64_t ways) {
+        total_sets = sets;
+        total_ways = ways;
+        current_btb.assign(NUM_CPUS, vector<unordered_map<uint64_t, T>>(total_sets));
     }
 
     void read_record(FILE *demand_record, uint64_t cpu) {
-        uint64_t ip, counter;
-        int type = 0;
-//        std::fseek(demand_record, 0, SEEK_END);
-        while (true) {
-            if (generate_record) {
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            } else {
-//                if (fscanf(demand_record, "%llu %llu %d", &ip, &counter, &type) == EOF) break;
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            }
-            vector<vector<unordered_map<uint64_t, set<uint64_t>>>> *future;
-            if (type == 0) {
-                future = &future_accesses;
-            } else {
-                future = &future_prefetches;
-            }
-            auto set_index = find_set_index(ip);
-            auto it = (*future)[cpu][set_index].find(ip);
-            if (it == (*future)[cpu][set_index].end()) {
-                (*future)[cpu][set_index].emplace_hint(it, ip, set<uint64_t>());
-            }
-            (*future)[cpu][set_index][ip].insert(counter);
-        }
-        last_timestamp = counter;
+        uint64_t last_counter = 0;
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t counter) {
+            last_counter = counter;
+            future_accesses[cpu].add(ip, counter);
+        });
+        last_timestamp = last_counter;
         cout << "The last timestamp: " << last_timestamp << endl;
     }
 
@@ -185,8 +147,8 @@ public:
 //                assert(time > last_timestamp);
 //            }
             // Evict a btb entry if it is full
-            auto current_it = future_accesses[cpu][set][ip].upper_bound(time);
-            if (current_it == future_accesses[cpu][set][ip].end()) {
+            auto next_use = future_accesses[cpu].next_use(ip, time);
+            if (next_use == NextUseIndex::NEVER) {
                 // There is no point caching the key
 //                cout << "Error: cannot find the corresponding timestamp!" << endl;
                 return false;
@@ -195,22 +157,22 @@ public:
             bool prefetch_found = false;
             pair<uint64_t, uint64_t> prefetch_candidate;
             for (auto &entry : current_btb[cpu][set]) {
-                auto it = future_prefetches[cpu][set][entry.first].upper_bound(time);
-                if (it != future_prefetches[cpu][set][entry.first].end()) {
+                auto next_prefetch = future_prefetches[cpu].next_use(entry.first, time);
+                if (next_prefetch != NextUseIndex::NEVER) {
                     // Find the prefetch
                     // Check whether the prefetch is before the next load of this line
-                    auto demand_it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (demand_it != future_accesses[cpu][set][entry.first].end() && (*it) > (*demand_it)) {
+                    auto next_demand = future_accesses[cpu].next_use(entry.first, time);
+                    if (next_demand != NextUseIndex::NEVER && next_prefetch > next_demand) {
                         // Demand load is presend and prefetch comes after the first load, so ignore
                         continue;
                     }
                     if (prefetch_found) {
-                        if (prefetch_candidate.first < *it) {
-                            prefetch_candidate = make_pair(*it, entry.first);
+                        if (prefetch_candidate.first < next_prefetch) {
+                            prefetch_candidate = make_pair(next_prefetch, entry.first);
                         }
                     } else {
                         prefetch_found = true;
-                        prefetch_candidate = make_pair(*it, entry.first);
+                        prefetch_candidate = make_pair(next_prefetch, entry.first);
                     }
                 }
             }
@@ -220,15 +182,15 @@ public:
             } else {
                 // Find victim in future demand access
                 pair<uint64_t, uint64_t> candidate;
-                candidate.first = *current_it;
+                candidate.first = next_use;
                 candidate.second = ip;
                 for (const auto &entry : current_btb[cpu][set]) {
-                    auto it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (it == future_accesses[cpu][set][entry.first].end()) {
+                    auto entry_next_use = future_accesses[cpu].next_use(entry.first, time);
+                    if (entry_next_use == NextUseIndex::NEVER) {
                         candidate.first = last_timestamp + 1;
                         candidate.second = entry.first;
-                    } else if (candidate.first < *it) {
-                        candidate.first = *it;
+                    } else if (candidate.first < entry_next_use) {
+                        candidate.first = entry_next_use;
                         candidate.second = entry.first;
                     }
                 }
@@ -247,8 +209,9 @@ public:
 };
 
 Shotgun shotgun;
-Opt<BASIC_BTB_ENTRY> conditional_opt(BASIC_BTB_SETS, BASIC_BTB_WAYS, BTBType::CONDITIONAL);
-Opt<FOOTPRINT_BTB_ENTRY> unconditional_opt(UNCONDITIONAL_BTB_SETS, UNCONDITIONAL_BTB_WAYS, BTBType::UNCONDITIONAL);
+ShotgunGeometry shotgun_geometry;
+Opt<BASIC_BTB_ENTRY> conditional_opt(BTBType::CONDITIONAL);
+Opt<FOOTPRINT_BTB_ENTRY> unconditional_opt(BTBType::UNCONDITIONAL);
 
 //unordered_map<uint64_t, set<uint64_t>> future_accesses[NUM_CPUS][BASIC_BTB_SETS];
 //unordered_map<uint64_t, BASIC_BTB_ENTRY> current_btb[NUM_CPUS][BASIC_BTB_SETS];
@@ -281,7 +244,7 @@ uint64_t basic_btb_abs_addr_dist(uint64_t addr1, uint64_t addr2) {
 }
 
 uint64_t basic_btb_set_index(uint64_t ip) {
-    return ((ip >> 2) % BASIC_BTB_SETS);
+    return ((ip >> 2) % shotgun_geometry.conditional_sets);
 }
 
 uint64_t basic_btb_indirect_hash(uint8_t cpu, uint64_t ip) {
@@ -325,10 +288,15 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
-    std::cout << "OPT Shotgun BTB sets: " << BASIC_BTB_SETS
-              << " ways: " << BASIC_BTB_WAYS
-              << " unconditional BTB sets: " << UNCONDITIONAL_BTB_SETS
-              << " ways: " << UNCONDITIONAL_BTB_WAYS
+    // TODO: If NUM_CPU > 1, the tables would be rebuilt for every CPU. Modify it if needed.
+    shotgun_geometry = ShotgunGeometry::from_knobs({384, 4, 1280, 4});
+    conditional_opt.init(shotgun_geometry.conditional_sets, shotgun_geometry.conditional_ways);
+    unconditional_opt.init(shotgun_geometry.unconditional_sets, shotgun_geometry.unconditional_ways);
+    stream_buffer.init(stream_buffer_capacity);
+    std::cout << "OPT Shotgun BTB sets: " << shotgun_geometry.conditional_sets
+              << " ways: " << shotgun_geometry.conditional_ways
+              << " unconditional BTB sets: " << shotgun_geometry.unconditional_sets
+              << " ways: " << shotgun_geometry.unconditional_ways
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
@@ -413,7 +381,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -5,46 +5,139 @@
 #ifndef CHAMPSIM_PT_PREFETCH_STREAM_BUFFER_H
 #define CHAMPSIM_PT_PREFETCH_STREAM_BUFFER_H
 
-#include <deque>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
 #include <utility>
+#include <vector>
 
 using std::vector;
 using std::pair;
 
+extern uint64_t stream_buffer_capacity;
+
+/*
+ * FIFO of prefetched (ip, target) pairs next to the BTB, -stream_buffer_capacity entries.
+ *
+ * The entries live in a fixed pool of slots linked in FIFO order, and an open-addressing
+ * index (linear probing, at most half full) maps an ip to its slots. The same ip can be
+ * prefetched more than once; its slots form a chain from oldest to youngest. A lookup and
+ * an update see the oldest one, and the FIFO evicts the oldest entry, which is always
+ * the head of its chain. So prefetch, predict and update are O(1), with no scan of the buffer.
+ */
 class StreamBuffer {
-    deque<pair<uint64_t, uint64_t>> buffer; // first is ip and second is target
-    uint64_t capacity;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Slot {
+        uint64_t ip;
+        uint64_t target;
+        uint32_t older; // FIFO neighbours
+        uint32_t younger;
+        uint32_t next_same_ip; // younger slot with the same ip
+    };
+
+    struct IndexEntry {
+        uint64_t ip;
+        uint32_t oldest = NONE; // NONE marks an empty index entry
+        uint32_t youngest = NONE;
+    };
+
+    vector<Slot> slots;
+    vector<uint32_t> free_slots;
+    vector<IndexEntry> index;
+    uint64_t index_mask = 0;
+    uint32_t oldest = NONE;
+    uint32_t youngest = NONE;
+
+    uint64_t home(uint64_t ip) const {
+        return ((ip >> 2) * 0x9e3779b97f4a7c15ULL >> 32) & index_mask;
+    }
+
+    uint64_t find(uint64_t ip) const {
+        auto i = home(ip);
+        while (index[i].oldest != NONE && index[i].ip != ip) {
+            i = (i + 1) & index_mask;
+        }
+        return i;
+    }
+
+    // Empties index entry i and moves later entries of its probe run back into the hole.
+    void erase_index(uint64_t i) {
+        auto hole = i;
+        for (auto j = (i + 1) & index_mask; index[j].oldest != NONE; j = (j + 1) & index_mask) {
+            auto h = home(index[j].ip);
+            // j may fill the hole only if its home is not cyclically in (hole, j]
+            if (((j - h) & index_mask) >= ((j - hole) & index_mask)) {
+                index[hole] = index[j];
+                hole = j;
+            }
+        }
+        index[hole] = IndexEntry();
+    }
+
+    // Unlinks the oldest slot of the ip at index entry i and returns its target.
+    uint64_t remove_oldest(uint64_t i) {
+        auto s = index[i].oldest;
+        auto &slot = slots[s];
+        if (slot.next_same_ip == NONE) {
+            erase_index(i);
+        } else {
+            index[i].oldest = slot.next_same_ip;
+        }
+        (slot.older == NONE ? oldest : slots[slot.older].younger) = slot.younger;
+        (slot.younger == NONE ? youngest : slots[slot.younger].older) = slot.older;
+        free_slots.push_back(s);
+        return slot.target;
+    }
 
 public:
-    StreamBuffer(uint64_t capacity) : capacity(capacity) {}
+    void init(uint64_t capacity) {
+        assert(capacity > 0 && capacity < NONE);
+        uint64_t index_size = 1;
+        while (index_size < 2 * capacity) {
+            index_size <<= 1;
+        }
+        slots.assign(capacity, Slot());
+        free_slots.clear();
+        for (uint64_t s = capacity; s > 0; s--) {
+            free_slots.push_back((uint32_t) (s - 1));
+        }
+        index.assign(index_size, IndexEntry());
+        index_mask = index_size - 1;
+        oldest = youngest = NONE;
+        std::cout << "Stream buffer capacity: " << capacity << std::endl;
+    }
 
     void prefetch(uint64_t ip, uint64_t target) {
-        if (buffer.size() >= capacity) {
-            buffer.pop_front();
+        assert(!slots.empty());
+        if (free_slots.empty()) {
+            remove_oldest(find(slots[oldest].ip));
         }
-        assert(buffer.size() < capacity);
-        buffer.emplace_back(ip, target);
+        auto s = free_slots.back();
+        free_slots.pop_back();
+        slots[s] = {ip, target, youngest, NONE, NONE};
+        (youngest == NONE ? oldest : slots[youngest].younger) = s;
+        youngest = s;
+
+        auto i = find(ip);
+        if (index[i].oldest == NONE) {
+            index[i].ip = ip;
+            index[i].oldest = s;
+        } else {
+            slots[index[i].youngest].next_same_ip = s;
+        }
+        index[i].youngest = s;
         assert(target != 0);
     }
 
     uint64_t stream_buffer_predict(uint64_t ip) {
-        for (auto &a : buffer) {
-            if (a.first == ip) {
-                return a.second;
-            }
-        }
-        return 0;
+        auto i = find(ip);
+        return index[i].oldest == NONE ? 0 : slots[index[i].oldest].target;
     }
 
     uint64_t stream_buffer_update(uint64_t ip) {
-        for (auto it = buffer.begin(); it != buffer.end(); it++) {
-            if (it->first == ip) {
-                auto target = it->second;
-                buffer.erase(it);
-                return target;
-            }
-        }
-        return 0;
+        auto i = find(ip);
+        return index[i].oldest == NONE ? 0 : remove_oldest(i);
     }
 };
 
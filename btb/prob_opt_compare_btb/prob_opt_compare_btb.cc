@@ -15,6 +15,8 @@
 #include "../access_counter.h"
 #include "../reuse_distance.h"
 #include "../prefetch_stream_buffer.h"
+#include "../opt_access_stream.h"
+#include "../next_use_index.h"
 
 using std::vector;
 using std::unordered_map;
@@ -58,7 +60,7 @@ uint64_t counter_upper_bound = 7;
 bool update_when_evict = true;
 
 AccessCounter access_counter(BASIC_BTB_SETS, BASIC_BTB_WAYS);
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 // From opt
 bool generate_record = false;
@@ -82,8 +84,8 @@ struct BASIC_BTB_ENTRY {
 template<class T>
 class Opt {
 private:
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_accesses;
-    vector<vector<unordered_map<uint64_t, set<uint64_t>>>> future_prefetches;
+    vector<NextUseIndex> future_accesses;
+    vector<NextUseIndex> future_prefetches;
     vector<vector<unordered_map<uint64_t, T>>> current_btb;
     uint64_t total_sets;
     uint64_t total_ways;
@@ -91,36 +93,15 @@ public:
     uint64_t timestamp = 0;
 
     Opt(uint64_t total_sets, uint64_t total_ways) : total_sets(total_sets), total_ways(total_ways) {
-        future_accesses.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
-        future_prefetches.resize(NUM_CPUS, vector<unordered_map<uint64_t, set<uint64_t>>>(total_sets));
+        future_accesses.resize(NUM_CPUS);
+        future_prefetches.resize(NUM_CPUS);
         current_btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, T>>(total_sets));
     }
 
     void read_record(FILE *demand_record, uint64_t cpu) {
-        uint64_t ip, counter;
-        int type = 0;
-        while (true) {
-            if (generate_record) {
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            } else {
-//                if (fscanf(demand_record, "%llu %llu %d", &ip, &counter, &type) == EOF) break;
-                if (fscanf(demand_record, "%llu %llu", &ip, &counter) == EOF) break;
-                type = 0;
-            }
-            vector<vector<unordered_map<uint64_t, set<uint64_t>>>> *future;
-            if (type == 0) {
-                future = &future_accesses;
-            } else {
-                future = &future_prefetches;
-            }
-            auto set_index = find_set_index(ip);
-            auto it = (*future)[cpu][set_index].find(ip);
-            if (it == (*future)[cpu][set_index].end()) {
-                (*future)[cpu][set_index].emplace_hint(it, ip, set<uint64_t>());
-            }
-            (*future)[cpu][set_index][ip].insert(counter);
-        }
+        OptAccessReader::for_each(demand_record, [&](uint64_t ip, uint64_t counter) {
+            future_accesses[cpu].add(ip, counter);
+        });
     }
 
     uint64_t find_set_index(uint64_t ip) {
@@ -139,8 +120,8 @@ public:
         auto time = timestamp - 1; // Get the current timestamp (we've +1 before the prediction)
         if (current_btb[cpu][set].size() >= total_ways) {
             // Evict a btb entry if it is full
-            auto current_it = future_accesses[cpu][set][insert_ip].upper_bound(time);
-            if (current_it == future_accesses[cpu][set][insert_ip].end()) {
+            auto next_use = future_accesses[cpu].next_use(insert_ip, time);
+            if (next_use == NextUseIndex::NEVER) {
                 // There is no point caching the key
                 // cout << "Error: cannot find the corresponding timestamp!" << endl;
                 return 0;
@@ -149,22 +130,22 @@ public:
             bool prefetch_found = false;
             pair<uint64_t, uint64_t> prefetch_candidate;
             for (auto &entry : current_btb[cpu][set]) {
-                auto it = future_prefetches[cpu][set][entry.first].upper_bound(time);
-                if (it != future_prefetches[cpu][set][entry.first].end()) {
+                auto next_prefetch = future_prefetches[cpu].next_use(entry.first, time);
+                if (next_prefetch != NextUseIndex::NEVER) {
                     // Find the prefetch
                     // Check whether the prefetch is before the next load of this line
-                    auto demand_it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (demand_it != future_accesses[cpu][set][entry.first].end() && (*it) > (*demand_it)) {
+                    auto next_demand = future_accesses[cpu].next_use(entry.first, time);
+                    if (next_demand != NextUseIndex::NEVER && next_prefetch > next_demand) {
                         // Demand load is presend and prefetch comes after the first load, so ignore
                         continue;
                     }
                     if (prefetch_found) {
-                        if (prefetch_candidate.first < *it) {
-                            prefetch_candidate = make_pair(*it, entry.first);
+                        if (prefetch_candidate.first < next_prefetch) {
+                            prefetch_candidate = make_pair(next_prefetch, entry.first);
                         }
                     } else {
                         prefetch_found = true;
-                        prefetch_candidate = make_pair(*it, entry.first);
+                        prefetch_candidate = make_pair(next_prefetch, entry.first);
                     }
                 }
             }
@@ -173,15 +154,15 @@ public:
             } else {
                 // Find victim in future demand access
                 pair<uint64_t, uint64_t> candidate;
-                candidate.first = *current_it;
+                candidate.first = next_use;
                 candidate.second = insert_ip;
                 for (const auto &entry : current_btb[cpu][set]) {
-                    auto it = future_accesses[cpu][set][entry.first].upper_bound(time);
-                    if (it == future_accesses[cpu][set][entry.first].end()) {
+                    auto entry_next_use = future_accesses[cpu].next_use(entry.first, time);
+                    if (entry_next_use == NextUseIndex::NEVER) {
                         candidate.first = time + 1;
                         candidate.second = entry.first;
-                    } else if (candidate.first < *it) {
-                        candidate.first = *it;
+                    } else if (candidate.first < entry_next_use) {
+                        candidate.first = entry_next_use;
                         candidate.second = entry.first;
                     }
                 }
@@ -521,6 +502,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "Prob OPT Compare BTB sets: " << BASIC_BTB_SETS
               << " ways: " << BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -585,7 +567,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
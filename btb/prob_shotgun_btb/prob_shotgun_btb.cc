@@ -10,14 +10,11 @@
 #include <vector>
 #include <unordered_map>
 #include <limits>
+#include "../shotgun_geometry.h"
 
 using std::vector;
 using std::unordered_map;
 
-#define BASIC_BTB_SETS 256
-#define BASIC_BTB_WAYS 4
-#define UNCONDITIONAL_BTB_SETS 1024
-#define UNCONDITIONAL_BTB_WAYS 7
 #define BASIC_BTB_INDIRECT_SIZE 4096
 #define BASIC_BTB_RAS_SIZE 32
 #define BASIC_BTB_CALL_INSTR_SIZE_TRACKERS 1024
@@ -42,8 +39,8 @@ struct FOOTPRINT_BTB_ENTRY {
     uint64_t target;
     uint8_t always_taken;
     uint8_t branch_type;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> call_footprint;
-    unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> return_footprint;
+    ShotgunFootprint call_footprint;
+    ShotgunFootprint return_footprint;
 
     explicit FOOTPRINT_BTB_ENTRY(uint64_t ip = 0, uint64_t target = 0, uint8_t always_taken = 1,
                                  uint8_t branch_type = BRANCH_DIRECT_CALL) :
@@ -53,43 +50,21 @@ struct FOOTPRINT_BTB_ENTRY {
             branch_type(branch_type) {}
 
     void cache_access(BASIC_BTB_ENTRY *access_entry, bool update_call = true) {
-        // access_taken refers to taken or not!
         auto access_block = access_entry->ip_tag >> LOG2_BLOCK_SIZE;
-        uint64_t original_block;
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
         if (update_call) {
-            original_block = target >> LOG2_BLOCK_SIZE;
-            footprint = &call_footprint;
+            call_footprint.record(target >> LOG2_BLOCK_SIZE, access_block);
         } else {
-            original_block = ip_tag >> LOG2_BLOCK_SIZE;
-            footprint = &return_footprint;
-        }
-        // Update footprint
-        if (access_block <= original_block + 6 && access_block >= original_block - 2) {
-            (*footprint)[access_block].push_back(*access_entry);
+            return_footprint.record(ip_tag >> LOG2_BLOCK_SIZE, access_block);
         }
     }
 
     void operate_prefetch(O3_CPU *o3_cpu, bool prefetch_call) {
-        // This function does not actually prefetch instrs. It just add it to prefetch list.
-        unordered_map<uint64_t, vector<BASIC_BTB_ENTRY>> *footprint;
-        uint64_t key;
-        if (prefetch_call) {
-            key = ip_tag;
-            footprint = &call_footprint;
-        } else {
-            key = target;
-            footprint = &return_footprint;
-        }
-        for (auto &a : *footprint) {
-            auto &region = o3_cpu->shotgun_prefetch_region[key];
-            region.clear();
-            for (auto &entry : a.second) {
-                region.push_back(entry.ip_tag);
-                // o3_cpu->prefetch_btb(entry.ip_tag, entry.target, entry.branch_type, entry.always_taken != 0);
-            }
+        // This function does not actually prefetch instrs. It just publishes the footprint to the prefetcher.
+        auto &footprint = prefetch_call ? call_footprint : return_footprint;
+        if (!footprint.empty()) {
+            o3_cpu->shotgun_prefetch_region[prefetch_call ? ip_tag : target] = footprint;
         }
-        footprint->clear();
+        footprint.clear();
     }
 };
 
@@ -145,9 +120,11 @@ class Prob {
     vector<unordered_map<uint64_t, Taken>> branch_record;
 
 public:
-    Prob(uint64_t sets, uint64_t ways) : total_sets(sets), total_ways(ways) {
-        btb.resize(NUM_CPUS, vector<unordered_map<uint64_t, T>>(sets));
-        branch_record.resize(NUM_CPUS);
+    void init(uint64_t sets, uint64_t ways) {
+        total_sets = sets;
+        total_ways = ways;
+        btb.assign(NUM_CPUS, vector<unordered_map<uint64_t, T>>(sets));
+        branch_record.assign(NUM_CPUS, unordered_map<uint64_t, Taken>());
     }
 
     uint64_t get_set_index(uint64_t ip) {
@@ -203,8 +180,9 @@ public:
 };
 
 Shotgun shotgun;
-Prob<BASIC_BTB_ENTRY> conditional_btb(BASIC_BTB_SETS, BASIC_BTB_WAYS);
-Prob<FOOTPRINT_BTB_ENTRY> unconditional_btb(UNCONDITIONAL_BTB_SETS, UNCONDITIONAL_BTB_WAYS);
+ShotgunGeometry shotgun_geometry;
+Prob<BASIC_BTB_ENTRY> conditional_btb;
+Prob<FOOTPRINT_BTB_ENTRY> unconditional_btb;
 
 uint64_t basic_btb_indirect[NUM_CPUS][BASIC_BTB_INDIRECT_SIZE];
 uint64_t basic_btb_conditional_history[NUM_CPUS];
@@ -270,8 +248,15 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
-    std::cout << "Prob Shotgun BTB sets: " << BASIC_BTB_SETS
-              << " ways: " << BASIC_BTB_WAYS
+    // TODO: If NUM_CPU > 1, the tables would be rebuilt for every CPU. Modify it if needed.
+    shotgun_geometry = ShotgunGeometry::from_knobs({256, 4, 1024, 7});
+    shotgun_geometry.require("Prob", true);
+    conditional_btb.init(shotgun_geometry.conditional_sets, shotgun_geometry.conditional_ways);
+    unconditional_btb.init(shotgun_geometry.unconditional_sets, shotgun_geometry.unconditional_ways);
+    std::cout << "Prob Shotgun BTB sets: " << shotgun_geometry.conditional_sets
+              << " ways: " << shotgun_geometry.conditional_ways
+              << " unconditional BTB sets: " << shotgun_geometry.unconditional_sets
+              << " ways: " << shotgun_geometry.unconditional_ways
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
               << " RAS size: " << BASIC_BTB_RAS_SIZE << std::endl;
 
@@ -337,7 +322,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
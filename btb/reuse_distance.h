@@ -6,61 +6,114 @@
 #define CHAMPSIM_PT_REUSE_DISTANCE_H
 
 #include "ooo_cpu.h"
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include <map>
 #include <unordered_map>
-#include <unordered_set>
 #include <fstream>
 #include <boost/filesystem.hpp>
+#include "fenwick_tree.h"
 namespace fs = boost::filesystem;
 
 using std::vector;
 using std::map;
 using std::unordered_map;
-using std::unordered_set;
 using std::endl;
 
 struct ReuseEntry {
     uint64_t ip = 0;
     uint64_t target = 0;
     uint8_t branch_type = BRANCH_CONDITIONAL; // Remember to convert to int when print!
-    unordered_set<uint64_t> distance_set;
-    vector<uint64_t> reuse_distance_record;
+    uint64_t num_access = 0;
+    // Reuse distance of every access in order, as runs of (distance, count). The first access
+    // has distance 0, so the counts add up to num_access.
+    vector<std::pair<uint32_t, uint32_t>> runs;
 
     ReuseEntry() = default;
 
-    ReuseEntry(const ReuseEntry &other) {
-        ip = other.ip;
-        target = other.target;
-        branch_type = other.branch_type;
-    }
-
     ReuseEntry(uint64_t ip, uint64_t target, uint8_t branch_type) :
             ip(ip), target(target), branch_type(branch_type) {}
 
-    void access(uint64_t access_ip) {
-        if (access_ip == ip) {
-            // Clear distance_set and add size to reuse_distance_record
-            reuse_distance_record.push_back(distance_set.size());
-            distance_set.clear();
+    void add(uint64_t distance) {
+        num_access++;
+        if (!runs.empty() && runs.back().first == distance) {
+            runs.back().second++;
         } else {
-            distance_set.insert(access_ip);
+            runs.emplace_back((uint32_t) distance, 1);
         }
     }
 };
 
+/*
+ * Reuse distances of one BTB set (Olken): every branch marks the position of its last access
+ * in a Fenwick tree over the access positions of the set, so the number of distinct branches
+ * accessed since the last access of ip is a range count in O(log n). When the positions run
+ * out, the live marks are renumbered into a tree twice their size.
+ */
+class SetReuseDistance {
+    unordered_map<uint64_t, uint64_t> last_position;
+    FenwickTree<int32_t> marks;
+    uint64_t next_position = 0;
+
+    void compact() {
+        vector<std::pair<uint64_t, uint64_t>> live; // (position, ip)
+        live.reserve(last_position.size());
+        for (auto &it : last_position) {
+            live.emplace_back(it.second, it.first);
+        }
+        std::sort(live.begin(), live.end());
+        auto size = std::max<uint64_t>(64, 2 * live.size());
+        vector<int32_t> values(size, 0);
+        for (uint64_t i = 0; i < live.size(); i++) {
+            last_position[live[i].second] = i;
+            values[i] = 1;
+        }
+        marks = FenwickTree<int32_t>(values);
+        next_position = live.size();
+    }
+
+public:
+    static constexpr uint64_t COLD = std::numeric_limits<uint64_t>::max();
+
+    // Returns the number of distinct other branches accessed in this set since the last
+    // access of ip, or COLD on its first access.
+    uint64_t access(uint64_t ip) {
+        uint64_t distance = COLD;
+        auto it = last_position.find(ip);
+        if (it != last_position.end()) {
+            distance = marks.range_sum(it->second + 1, next_position);
+            marks.add(it->second, -1);
+        }
+        if (next_position == marks.size()) {
+            if (it != last_position.end()) last_position.erase(it);
+            compact();
+            it = last_position.end();
+        }
+        marks.add(next_position, 1);
+        if (it == last_position.end()) {
+            last_position[ip] = next_position;
+        } else {
+            it->second = next_position;
+        }
+        next_position++;
+        return distance;
+    }
+};
+
 class ReuseDistance {
     uint64_t total_sets;
-    vector<map<uint64_t, ReuseEntry>> sorted_branch_record;
-    vector<vector<unordered_set<uint64_t>>> btb_view_branch_record;
+    vector<unordered_map<uint64_t, ReuseEntry>> branch_record;
+    vector<vector<SetReuseDistance>> btb_view_branch_record;
 
     bool record_reuse_distance = false;
 
 public:
     ReuseDistance(uint64_t sets, bool record_reuse_distance) : total_sets(sets), record_reuse_distance(record_reuse_distance) {
-        // TODO: Init btb_view_branch_record and sorted_branch_record
-        sorted_branch_record.resize(NUM_CPUS);
-        btb_view_branch_record.resize(NUM_CPUS, vector<unordered_set<uint64_t>>(sets));
+        branch_record.resize(NUM_CPUS);
+        if (record_reuse_distance) {
+            btb_view_branch_record.resize(NUM_CPUS, vector<SetReuseDistance>(sets));
+        }
     }
 
     uint64_t get_set_index(uint64_t ip) {
@@ -71,17 +124,13 @@ public:
         if (!record_reuse_distance) {
             return;
         }
-        // TODO: Get set index of access_ip and update all branches mapped onto this set
         auto set = get_set_index(access_ip);
-        // Add to branch_record if needed
-        btb_view_branch_record[cpu][set].insert(access_ip);
-        auto it = sorted_branch_record[cpu].find(access_ip);
-        if (it == sorted_branch_record[cpu].end()) {
-            sorted_branch_record[cpu].emplace_hint(it, access_ip, ReuseEntry(access_ip, target, branch_type));
-        }
-        for (auto ip : btb_view_branch_record[cpu][set]) {
-            sorted_branch_record[cpu][ip].access(access_ip);
+        auto it = branch_record[cpu].find(access_ip);
+        if (it == branch_record[cpu].end()) {
+            it = branch_record[cpu].emplace(access_ip, ReuseEntry(access_ip, target, branch_type)).first;
         }
+        auto distance = btb_view_branch_record[cpu][set].access(access_ip);
+        it->second.add(distance == SetReuseDistance::COLD ? 0 : distance);
     }
 
     void print_final_stats(string &trace_name, uint64_t cpu) {
@@ -94,14 +143,26 @@ public:
         cout << "Open reuse distance file " << filename << endl;
         ofstream out(filename.c_str());
         assert(out.is_open());
+        // Reuse distances of every access in order (hex), the first one being 0. A run of count
+        // equal distances is written as "distance*count".
         out << "PC,Target,Type,Num of Access,Reuse Distance" << endl;
-        for (auto &it : sorted_branch_record[cpu]) {
-            out << std::hex << it.first;
+        vector<const ReuseEntry *> entries;
+        for (auto &it : branch_record[cpu]) {
+            entries.push_back(&it.second);
+        }
+        std::sort(entries.begin(), entries.end(), [](const ReuseEntry *a, const ReuseEntry *b) {
+            return a->ip < b->ip;
+        });
+        for (auto entry : entries) {
+            out << std::hex << entry->ip;
             out << ",";
-            out << std::hex << it.second.target;
-            out << "," << (int) it.second.branch_type << "," << it.second.reuse_distance_record.size();
-            for (auto a : it.second.reuse_distance_record) {
-                out << "," << a;
+            out << std::hex << entry->target;
+            out << "," << (int) entry->branch_type << "," << entry->num_access;
+            for (auto &run : entry->runs) {
+                out << "," << run.first;
+                if (run.second > 1) {
+                    out << "*" << run.second;
+                }
             }
             out << endl;
         }
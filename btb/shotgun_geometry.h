@@ -0,0 +1,63 @@
+#ifndef CHAMPSIM_PT_SHOTGUN_GEOMETRY_H
+#define CHAMPSIM_PT_SHOTGUN_GEOMETRY_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+// -shotgun_conditional_btb_sets/ways and -shotgun_unconditional_btb_sets/ways, 0 if not given
+extern uint64_t shotgun_conditional_btb_sets;
+extern uint32_t shotgun_conditional_btb_ways;
+extern uint64_t shotgun_unconditional_btb_sets;
+extern uint32_t shotgun_unconditional_btb_ways;
+
+/*
+ * C-BTB and U-BTB geometry of a Shotgun BTB.
+ *
+ * The Shotgun variants were tuned with different sizes (basic, OPT and hot/warm/cold use 384 x 4
+ * and 1280 x 4, GHRP, Hawkeye, Prob and SRRIP 256 x 4 and 1024 x 7), so each one passes its own
+ * defaults to from_knobs() and the knobs that were given override them. The knobs are parsed
+ * after static initialization, so the variants build their tables in initialize_btb.
+ */
+struct ShotgunGeometry {
+    uint64_t conditional_sets;
+    uint32_t conditional_ways;
+    uint64_t unconditional_sets;
+    uint32_t unconditional_ways;
+
+    static ShotgunGeometry from_knobs(const ShotgunGeometry &defaults) {
+        return {shotgun_conditional_btb_sets ? shotgun_conditional_btb_sets : defaults.conditional_sets,
+                shotgun_conditional_btb_ways ? shotgun_conditional_btb_ways : defaults.conditional_ways,
+                shotgun_unconditional_btb_sets ? shotgun_unconditional_btb_sets : defaults.unconditional_sets,
+                shotgun_unconditional_btb_ways ? shotgun_unconditional_btb_ways : defaults.unconditional_ways};
+    }
+
+    // Exits if a table does not fit a BTB that indexes sets with a mask (pow2_sets) or needs at
+    // least min_sets sets and min_ways ways.
+    void require(const char *btb, bool pow2_sets, uint64_t min_sets = 1, uint32_t min_ways = 1) const {
+        check(btb, "conditional", conditional_sets, conditional_ways, pow2_sets, min_sets, min_ways);
+        check(btb, "unconditional", unconditional_sets, unconditional_ways, pow2_sets, min_sets, min_ways);
+    }
+
+private:
+    static void check(const char *btb, const char *table, uint64_t sets, uint32_t ways, bool pow2_sets,
+                      uint64_t min_sets, uint32_t min_ways) {
+        if (pow2_sets && (sets & (sets - 1)) != 0) {
+            std::cerr << "-shotgun_" << table << "_btb_sets " << sets << ": the " << btb
+                      << " Shotgun BTB needs a power of two" << std::endl;
+            exit(1);
+        }
+        if (sets < min_sets) {
+            std::cerr << "-shotgun_" << table << "_btb_sets " << sets << ": the " << btb
+                      << " Shotgun BTB needs at least " << min_sets << std::endl;
+            exit(1);
+        }
+        if (ways < min_ways) {
+            std::cerr << "-shotgun_" << table << "_btb_ways " << ways << ": the " << btb
+                      << " Shotgun BTB needs at least " << min_ways << std::endl;
+            exit(1);
+        }
+    }
+};
+
+#endif //CHAMPSIM_PT_SHOTGUN_GEOMETRY_H
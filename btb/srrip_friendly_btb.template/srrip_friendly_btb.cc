@@ -37,7 +37,7 @@ bool second_update = SECOND_UPDATE;
 bool range_count = RANGE_COUNT;
 
 AccessCounter access_counter(BASIC_BTB_SETS, BASIC_BTB_WAYS);
-StreamBuffer stream_buffer(32);
+StreamBuffer stream_buffer;
 
 #define JUDGE_FRIENDLY 0.9;
 
@@ -62,32 +62,39 @@ public:
         assert(trash == ',');
         // Read size
         line_stream >> hex >> size;
+        // Reuse distances in order; "distance*count" is a run of count equal distances.
         auto last_is_zero = false;
         while (line_stream >> trash) {
             assert(trash == ',');
+            uint64_t count = 1;
             if (!(line_stream >> tmp))
                 assert(0);
+            if (line_stream.peek() == '*') {
+                line_stream >> trash >> count;
+            }
             if (range_count) {
+                // A run of zero distances counts once.
                 if (tmp == 0) {
                     if (!last_is_zero) {
                         friendly_count++;
                         last_is_zero = true;
                     }
                 } else if (tmp < BASIC_BTB_WAYS) {
-                    friendly_count++;
+                    friendly_count += count;
                     last_is_zero = false;
                 }
                 else {
-                    unfriendly_count++;
+                    unfriendly_count += count;
                     last_is_zero = false;
                 }
             } else {
                 if (tmp < BASIC_BTB_WAYS)
-                    friendly_count++;
+                    friendly_count += count;
                 else
-                    unfriendly_count++;
+                    unfriendly_count += count;
             }
-            size--;
+            assert(size >= count);
+            size -= count;
         }
         assert(size == 0);
         auto percentage = (double) friendly_count / ((double) friendly_count + (double) unfriendly_count);
@@ -252,6 +259,7 @@ uint64_t basic_btb_get_call_size(uint8_t cpu, uint64_t ip) {
 }
 
 void O3_CPU::initialize_btb() {
+    stream_buffer.init(stream_buffer_capacity);
     std::cout << "SRRIP Friendly BTB sets: " << BASIC_BTB_SETS
               << " ways: " << BASIC_BTB_WAYS
               << " indirect buffer size: " << BASIC_BTB_INDIRECT_SIZE
@@ -323,7 +331,7 @@ std::pair<uint64_t, uint8_t> O3_CPU::btb_prediction(uint64_t ip, uint8_t branch_
 }
 
 void O3_CPU::update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken,
-                        uint8_t branch_type) {
+                        uint8_t branch_type, uint8_t temperature_hint) {
     // updates for indirect branches
     if ((branch_type == BRANCH_INDIRECT) ||
         (branch_type == BRANCH_INDIRECT_CALL)) {
@@ -0,0 +1,170 @@
+#ifndef CHAMPSIM_PT_TEMPERATURE_TABLE_H
+#define CHAMPSIM_PT_TEMPERATURE_TABLE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using std::vector;
+
+/*
+ * Storage model of the temperature metadata that a Thermometer BTB would carry in hardware.
+ *
+ * The simulator knows the exact hit-to-taken ratio of every profiled branch, while hardware
+ * only has a few bits of category per branch. A category is kept in `bits` bits (categories
+ * that do not fit are saturated to the hottest encodable one) in one of two places:
+ *   - entries == 0: hint bits in the branch instruction, so every profiled branch has its
+ *     category and the cost is bits per static profiled branch.
+ *   - entries > 0: a set-associative table indexed by ip with `tag_bits` partial tags
+ *     (0 means full tags) and LRU replacement. A lookup miss fills the category of a
+ *     profiled branch for later lookups, and partial tags may return the category of
+ *     another branch, which is counted as an aliased hit.
+ * Branches without metadata get the default category of the caller.
+ */
+class TemperatureTable {
+    struct Entry {
+        uint64_t ip = 0; // Full ip, only used to count aliasing
+        uint64_t tag = 0;
+        uint64_t lru = 0;
+        uint8_t category = 0;
+        bool valid = false;
+    };
+
+    uint32_t bits = 0;
+    uint64_t sets = 0;
+    uint32_t ways = 0;
+    uint32_t tag_bits = 0;
+    vector<Entry> table;
+    uint64_t lru_counter = 0;
+
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t aliased_hits = 0;
+    uint64_t fills = 0;
+
+    uint64_t set_index(uint64_t ip) const {
+        return (ip >> 2) % sets;
+    }
+
+    uint64_t tag(uint64_t ip) const {
+        auto full_tag = (ip >> 2) / sets;
+        if (tag_bits == 0 || tag_bits >= 64) return full_tag;
+        // Fold the upper bits into the partial tag so aliasing is not limited to nearby code.
+        uint64_t folded = 0;
+        for (; full_tag != 0; full_tag >>= tag_bits) {
+            folded ^= full_tag;
+        }
+        return folded & ((1ull << tag_bits) - 1);
+    }
+
+    uint8_t encode(uint8_t category) const {
+        return (uint8_t) std::min<uint32_t>(category, (1u << bits) - 1);
+    }
+
+    Entry *find(uint64_t ip) {
+        auto begin = table.data() + set_index(ip) * ways;
+        auto t = tag(ip);
+        for (uint32_t way = 0; way < ways; way++) {
+            if (begin[way].valid && begin[way].tag == t) return begin + way;
+        }
+        return nullptr;
+    }
+
+    static uint32_t log2_ceil(uint64_t n) {
+        uint32_t log = 0;
+        while ((1ull << log) < n) log++;
+        return log;
+    }
+
+public:
+    void init(uint32_t temperature_bits, uint64_t entries, uint32_t table_ways, uint32_t table_tag_bits) {
+        assert(temperature_bits > 0 && temperature_bits <= 8);
+        bits = temperature_bits;
+        tag_bits = table_tag_bits;
+        if (entries == 0) {
+            sets = ways = 0;
+            table.clear();
+        } else {
+            ways = (uint32_t) std::min<uint64_t>(std::max<uint32_t>(table_ways, 1), entries);
+            sets = entries / ways;
+            table.assign(sets * ways, Entry());
+        }
+        std::cout << "Temperature table bits: " << bits;
+        if (hint_bits()) {
+            std::cout << " in branch hint bits" << std::endl;
+        } else {
+            std::cout << " entries: " << table.size() << " ways: " << ways
+                      << " tag bits: " << entry_tag_bits() << std::endl;
+        }
+    }
+
+    bool hint_bits() const {
+        return table.empty();
+    }
+
+    // Looks up the category of ip. profiled tells whether the profile knows ip, with its
+    // category in profiled_category. Returns false if the metadata has no category for ip.
+    bool lookup(uint64_t ip, bool profiled, uint8_t profiled_category, uint8_t &category) {
+        lookups++;
+        if (hint_bits()) {
+            if (!profiled) return false;
+            hits++;
+            category = encode(profiled_category);
+            return true;
+        }
+        auto entry = find(ip);
+        if (entry != nullptr) {
+            hits++;
+            if (entry->ip != ip) aliased_hits++;
+            entry->lru = ++lru_counter;
+            category = entry->category;
+            return true;
+        }
+        if (profiled) {
+            auto begin = table.data() + set_index(ip) * ways;
+            auto victim = std::min_element(begin, begin + ways, [](const Entry &a, const Entry &b) {
+                return a.valid == b.valid ? a.lru < b.lru : !a.valid;
+            });
+            victim->ip = ip;
+            victim->tag = tag(ip);
+            victim->lru = ++lru_counter;
+            victim->category = encode(profiled_category);
+            victim->valid = true;
+            fills++;
+        }
+        return false;
+    }
+
+    // Writes a retrained category back if ip has an entry.
+    void update(uint64_t ip, uint8_t category) {
+        if (hint_bits()) return;
+        auto entry = find(ip);
+        if (entry != nullptr) entry->category = encode(category);
+    }
+
+    uint32_t entry_tag_bits() const {
+        if (tag_bits != 0) return tag_bits;
+        return 62 - log2_ceil(sets); // Full tag of a 4-byte aligned 64-bit ip
+    }
+
+    // Storage in bits; hint bits cost bits per static profiled branch.
+    uint64_t storage_bits(uint64_t profiled_branches) const {
+        if (hint_bits()) return bits * profiled_branches;
+        // Category, tag, valid and LRU bits of every entry
+        return table.size() * (bits + entry_tag_bits() + 1 + log2_ceil(ways));
+    }
+
+    void print_final_stats(uint64_t profiled_branches) const {
+        std::cout << "Temperature table lookups: " << lookups
+                  << " hits: " << hits
+                  << " misses: " << lookups - hits
+                  << " aliased hits: " << aliased_hits
+                  << " fills: " << fills
+                  << " hit rate: " << (lookups ? (double) hits / (double) lookups : 0.0)
+                  << " storage (bytes): " << (storage_bits(profiled_branches) + 7) / 8 << std::endl;
+    }
+};
+
+#endif //CHAMPSIM_PT_TEMPERATURE_TABLE_H
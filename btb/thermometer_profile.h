@@ -0,0 +1,425 @@
+#ifndef CHAMPSIM_PT_THERMOMETER_PROFILE_H
+#define CHAMPSIM_PT_THERMOMETER_PROFILE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::vector;
+
+/*
+ * Thermometer profile: the hit-to-taken ratio (temperature) of every branch under OPT.
+ *
+ * The OPT access record (opt_access_record/.../<trace>.csv) lists every access of every
+ * branch, so building the hit ratios from it means parsing the whole text file before the
+ * simulation starts. The binary profile written by thermometer_profile keeps only what
+ * Thermometer needs, sorted by IP:
+ *
+ *   ThermometerProfileHeader
+ *   ips:       num_branches uint64_t, ascending
+ *   hits:      num_branches uint32_t
+ *   accesses:  num_branches uint32_t (taken accesses, i.e. hits + misses)
+ *   inputs:    num_branches uint16_t (number of merged inputs that saw the branch)
+ *   min_ratio: num_branches uint16_t (lowest per-input ratio, scaled by RATIO_SCALE)
+ *   max_ratio: num_branches uint16_t (highest per-input ratio, scaled by RATIO_SCALE)
+ *
+ * Counts are kept instead of a quantized ratio, so hit / accesses is bit-identical to the
+ * ratio computed from the CSV and the category boundaries of every config apply unchanged.
+ * Profiles of several inputs are merged by adding (optionally weighted) counts, i.e. each
+ * input contributes in proportion to the dynamic count of the branch. A merged profile keeps
+ * enough to be merged again, so a new input can be added without redoing the old ones.
+ * Confidence is low for branches seen by few of the inputs or whose ratio varies a lot
+ * between inputs.
+ *
+ * The loader maps the file and looks branches up with a binary search. Profiles written
+ * before the merge fields existed ("THRPROF1") and CSV records (both the long "PC,Target,
+ * Type,Access Record" and short "PC,Hit,Taken" formats) are still accepted.
+ */
+const uint64_t THERMOMETER_PROFILE_MAGIC = 0x32464F5250524854ULL;    // "THRPROF2"
+const uint64_t THERMOMETER_PROFILE_MAGIC_V1 = 0x31464F5250524854ULL; // "THRPROF1", no merge fields
+
+struct ThermometerProfileHeader {
+    uint64_t magic;
+    uint64_t num_branches;
+    uint64_t num_inputs; // Not present in THRPROF1
+};
+
+struct ThermometerProfileEntry {
+    static const uint32_t RATIO_SCALE = 65535;
+
+    uint64_t ip = 0;
+    uint32_t hit = 0;
+    uint32_t access = 0;
+    uint16_t inputs = 1;
+    uint16_t min_ratio = 0;
+    uint16_t max_ratio = 0;
+
+    ThermometerProfileEntry() = default;
+
+    // Halves both counts until they fit, which keeps the ratio.
+    ThermometerProfileEntry(uint64_t ip, uint64_t hit, uint64_t access) : ip(ip) {
+        while (access > UINT32_MAX) {
+            hit >>= 1;
+            access >>= 1;
+        }
+        this->hit = (uint32_t) hit;
+        this->access = (uint32_t) access;
+        min_ratio = max_ratio = scaled_ratio();
+    }
+
+    double ratio() const {
+        return (double) hit / (double) access;
+    }
+
+    uint16_t scaled_ratio() const {
+        return access == 0 ? 0 : (uint16_t) std::lround(ratio() * RATIO_SCALE);
+    }
+
+    // Fraction of the inputs that saw the branch, scaled down by the spread of its ratio.
+    double confidence(uint64_t num_inputs) const {
+        auto coverage = num_inputs == 0 ? 1.0 : std::min(1.0, (double) inputs / (double) num_inputs);
+        return coverage * (1.0 - (double) (max_ratio - min_ratio) / RATIO_SCALE);
+    }
+};
+
+class ThermometerProfile {
+    // Access record codes, same as RecordType in access_record.h
+    static const uint64_t RECORD_HIT = 0;
+    static const uint64_t RECORD_MISS_ONLY = 1;
+    static const uint64_t RECORD_MISS_INSERT = 2;
+
+    void *map = nullptr;
+    uint64_t map_size = 0;
+    vector<uint64_t> owned_ips;
+    vector<uint32_t> owned_hits;
+    vector<uint32_t> owned_accesses;
+    vector<uint16_t> owned_inputs;
+    vector<uint16_t> owned_min_ratios;
+    vector<uint16_t> owned_max_ratios;
+    const uint64_t *ips = nullptr;
+    const uint32_t *hits = nullptr;
+    const uint32_t *accesses = nullptr;
+    const uint16_t *inputs = nullptr; // nullptr for THRPROF1 profiles
+    const uint16_t *min_ratios = nullptr;
+    const uint16_t *max_ratios = nullptr;
+    uint64_t num_branches = 0;
+    uint64_t num_inputs = 0;
+
+    static const char *skip_commas(const char *p) {
+        while (*p == ',' || *p == ' ') p++;
+        return p;
+    }
+
+    static uint64_t array_bytes(uint64_t n, bool merge_fields) {
+        return n * (sizeof(uint64_t) + 2 * sizeof(uint32_t) + (merge_fields ? 3 * sizeof(uint16_t) : 0));
+    }
+
+    void unmap() {
+        if (map != nullptr) {
+            munmap(map, map_size);
+            map = nullptr;
+        }
+    }
+
+    // Maps a binary profile; returns false if path is not one.
+    bool map_binary(const char *path) {
+        FILE *in = fopen(path, "rb");
+        if (in == nullptr) return false;
+        struct stat st = {};
+        fstat(fileno(in), &st);
+        auto size = (uint64_t) st.st_size;
+        ThermometerProfileHeader header = {};
+        if (size < 2 * sizeof(uint64_t) || fread(&header, 2 * sizeof(uint64_t), 1, in) != 1 ||
+            (header.magic != THERMOMETER_PROFILE_MAGIC && header.magic != THERMOMETER_PROFILE_MAGIC_V1)) {
+            fclose(in);
+            return false;
+        }
+        bool merge_fields = header.magic == THERMOMETER_PROFILE_MAGIC;
+        uint64_t header_size = merge_fields ? sizeof(header) : 2 * sizeof(uint64_t);
+        assert(header_size + array_bytes(header.num_branches, merge_fields) <= size);
+        unmap();
+        map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+        fclose(in);
+        assert(map != MAP_FAILED);
+        map_size = size;
+        num_branches = header.num_branches;
+        num_inputs = merge_fields ? ((const ThermometerProfileHeader *) map)->num_inputs : 1;
+        ips = (const uint64_t *) ((const uint8_t *) map + header_size);
+        hits = (const uint32_t *) (ips + num_branches);
+        accesses = hits + num_branches;
+        if (merge_fields) {
+            inputs = (const uint16_t *) (accesses + num_branches);
+            min_ratios = inputs + num_branches;
+            max_ratios = min_ratios + num_branches;
+        } else {
+            inputs = min_ratios = max_ratios = nullptr;
+        }
+        return true;
+    }
+
+public:
+    ThermometerProfile() = default;
+    ThermometerProfile(const ThermometerProfile &other) = delete;
+    ThermometerProfile &operator=(const ThermometerProfile &other) = delete;
+
+    ThermometerProfile(ThermometerProfile &&other) noexcept { *this = std::move(other); }
+
+    // Moved vectors keep their buffers, so the lookup pointers stay valid.
+    ThermometerProfile &operator=(ThermometerProfile &&other) noexcept {
+        if (this == &other) return *this;
+        unmap();
+        map = other.map;
+        map_size = other.map_size;
+        owned_ips = std::move(other.owned_ips);
+        owned_hits = std::move(other.owned_hits);
+        owned_accesses = std::move(other.owned_accesses);
+        owned_inputs = std::move(other.owned_inputs);
+        owned_min_ratios = std::move(other.owned_min_ratios);
+        owned_max_ratios = std::move(other.owned_max_ratios);
+        ips = other.ips;
+        hits = other.hits;
+        accesses = other.accesses;
+        inputs = other.inputs;
+        min_ratios = other.min_ratios;
+        max_ratios = other.max_ratios;
+        num_branches = other.num_branches;
+        num_inputs = other.num_inputs;
+        other.map = nullptr;
+        other.ips = nullptr;
+        other.hits = nullptr;
+        other.accesses = nullptr;
+        other.inputs = other.min_ratios = other.max_ratios = nullptr;
+        other.num_branches = 0;
+        other.num_inputs = 0;
+        return *this;
+    }
+
+    ~ThermometerProfile() { unmap(); }
+
+    // Parses one line of an OPT access record CSV.
+    static bool parse_csv_line(const char *line, bool short_format, ThermometerProfileEntry &entry) {
+        char *end;
+        const char *p = skip_commas(line);
+        uint64_t ip = strtoull(p, &end, 16);
+        if (end == p) return false;
+        if (short_format) {
+            // PC,Hit,Taken
+            p = skip_commas(end);
+            uint64_t hit = strtoull(p, &end, 16);
+            p = skip_commas(end);
+            uint64_t taken = strtoull(p, &end, 16);
+            entry = ThermometerProfileEntry(ip, hit, taken);
+            return true;
+        }
+        // PC,Target,Type,Access Record...
+        p = end + 1;
+        strtoull(p, &end, 16);
+        p = end + 1;
+        strtoull(p, &end, 16);
+        uint64_t hit = 0, miss = 0;
+        while (*end == ',') {
+            p = end + 1;
+            auto record = strtoull(p, &end, 16);
+            assert(end != p);
+            if (record == RECORD_HIT)
+                hit++;
+            else if (record == RECORD_MISS_ONLY || record == RECORD_MISS_INSERT)
+                miss++;
+        }
+        entry = ThermometerProfileEntry(ip, hit, hit + miss);
+        return true;
+    }
+
+    // Reads every branch of an OPT access record CSV; returns false if the file cannot be opened.
+    static bool read_csv(const char *path, vector<ThermometerProfileEntry> &entries) {
+        FILE *in = fopen(path, "r");
+        if (in == nullptr) return false;
+        char *line = nullptr;
+        size_t capacity = 0;
+        bool short_format = false;
+        if (getline(&line, &capacity, in) > 0) {
+            short_format = strncmp(line, "PC,Hit,Taken", strlen("PC,Hit,Taken")) == 0;
+        }
+        ThermometerProfileEntry entry;
+        while (getline(&line, &capacity, in) > 0) {
+            if (parse_csv_line(line, short_format, entry))
+                entries.push_back(entry);
+        }
+        free(line);
+        fclose(in);
+        return true;
+    }
+
+    // Reads a binary profile or a CSV record into entries.
+    static bool read(const char *path, vector<ThermometerProfileEntry> &entries, uint64_t &entries_inputs) {
+        ThermometerProfile profile;
+        if (!profile.load(path)) return false;
+        entries.clear();
+        for (uint64_t i = 0; i < profile.size(); i++) {
+            entries.push_back(profile.at(i));
+        }
+        entries_inputs = profile.input_count();
+        return true;
+    }
+
+    // Sorts entries by IP, keeping the first entry of a duplicated IP like the CSV loader did.
+    static void sort_entries(vector<ThermometerProfileEntry> &entries) {
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const ThermometerProfileEntry &a, const ThermometerProfileEntry &b) {
+                             return a.ip < b.ip;
+                         });
+        auto last = std::unique(entries.begin(), entries.end(),
+                                [](const ThermometerProfileEntry &a, const ThermometerProfileEntry &b) {
+                                    return a.ip == b.ip;
+                                });
+        entries.erase(last, entries.end());
+    }
+
+    static bool write(const char *path, vector<ThermometerProfileEntry> &entries, uint64_t entries_inputs = 1) {
+        sort_entries(entries);
+        FILE *out = fopen(path, "wb");
+        if (out == nullptr) return false;
+        ThermometerProfileHeader header = {THERMOMETER_PROFILE_MAGIC, entries.size(), entries_inputs};
+        fwrite(&header, sizeof(header), 1, out);
+        for (auto &entry : entries) fwrite(&entry.ip, sizeof(uint64_t), 1, out);
+        for (auto &entry : entries) fwrite(&entry.hit, sizeof(uint32_t), 1, out);
+        for (auto &entry : entries) fwrite(&entry.access, sizeof(uint32_t), 1, out);
+        for (auto &entry : entries) fwrite(&entry.inputs, sizeof(uint16_t), 1, out);
+        for (auto &entry : entries) fwrite(&entry.min_ratio, sizeof(uint16_t), 1, out);
+        for (auto &entry : entries) fwrite(&entry.max_ratio, sizeof(uint16_t), 1, out);
+        fclose(out);
+        return true;
+    }
+
+    static uint64_t file_size(uint64_t n) {
+        return sizeof(ThermometerProfileHeader) + array_bytes(n, true);
+    }
+
+    void assign(vector<ThermometerProfileEntry> &entries, uint64_t entries_inputs = 1) {
+        unmap();
+        sort_entries(entries);
+        owned_ips.clear();
+        owned_hits.clear();
+        owned_accesses.clear();
+        owned_inputs.clear();
+        owned_min_ratios.clear();
+        owned_max_ratios.clear();
+        for (auto &entry : entries) {
+            owned_ips.push_back(entry.ip);
+            owned_hits.push_back(entry.hit);
+            owned_accesses.push_back(entry.access);
+            owned_inputs.push_back(entry.inputs);
+            owned_min_ratios.push_back(entry.min_ratio);
+            owned_max_ratios.push_back(entry.max_ratio);
+        }
+        ips = owned_ips.data();
+        hits = owned_hits.data();
+        accesses = owned_accesses.data();
+        inputs = owned_inputs.data();
+        min_ratios = owned_min_ratios.data();
+        max_ratios = owned_max_ratios.data();
+        num_branches = entries.size();
+        num_inputs = entries_inputs;
+    }
+
+    // Maps a binary profile, or parses path as a CSV access record if it is not one.
+    bool load(const char *path) {
+        if (map_binary(path)) return true;
+        vector<ThermometerProfileEntry> entries;
+        if (!read_csv(path, entries)) return false;
+        assign(entries);
+        return true;
+    }
+
+    // Returns false if ip is not in the profile.
+    bool lookup(uint64_t ip, double &ratio) const {
+        auto it = std::lower_bound(ips, ips + num_branches, ip);
+        if (it == ips + num_branches || *it != ip) return false;
+        auto index = it - ips;
+        ratio = (double) hits[index] / (double) accesses[index];
+        return true;
+    }
+
+    // Also returns the confidence of the ratio (see ThermometerProfileEntry::confidence).
+    bool lookup(uint64_t ip, double &ratio, double &confidence) const {
+        auto it = std::lower_bound(ips, ips + num_branches, ip);
+        if (it == ips + num_branches || *it != ip) return false;
+        auto entry = at(it - ips);
+        ratio = entry.ratio();
+        confidence = entry.confidence(num_inputs);
+        return true;
+    }
+
+    uint64_t size() const { return num_branches; }
+
+    uint64_t input_count() const { return num_inputs; }
+
+    ThermometerProfileEntry at(uint64_t index) const {
+        ThermometerProfileEntry entry(ips[index], hits[index], accesses[index]);
+        if (inputs != nullptr) {
+            entry.inputs = inputs[index];
+            entry.min_ratio = min_ratios[index];
+            entry.max_ratio = max_ratios[index];
+        }
+        return entry;
+    }
+};
+
+/*
+ * Accumulates the profiles of several inputs. Each input is added with a weight that scales
+ * its counts (1 keeps the dynamic branch counts as they are); adding a merged profile again
+ * keeps its input count, so merges can be done incrementally.
+ */
+class ThermometerProfileMerger {
+    struct Accumulator {
+        double hit = 0;
+        double access = 0;
+        uint64_t inputs = 0;
+        uint16_t min_ratio = ThermometerProfileEntry::RATIO_SCALE;
+        uint16_t max_ratio = 0;
+    };
+
+    std::unordered_map<uint64_t, Accumulator> branches;
+    uint64_t num_inputs = 0;
+
+public:
+    void add(const vector<ThermometerProfileEntry> &entries, uint64_t entries_inputs, double weight = 1.0) {
+        for (auto &entry : entries) {
+            auto &accumulator = branches[entry.ip];
+            accumulator.hit += weight * entry.hit;
+            accumulator.access += weight * entry.access;
+            accumulator.inputs += entry.inputs;
+            accumulator.min_ratio = std::min(accumulator.min_ratio, entry.min_ratio);
+            accumulator.max_ratio = std::max(accumulator.max_ratio, entry.max_ratio);
+        }
+        num_inputs += entries_inputs;
+    }
+
+    uint64_t input_count() const { return num_inputs; }
+
+    void finish(vector<ThermometerProfileEntry> &entries) const {
+        entries.clear();
+        for (auto &it : branches) {
+            auto &accumulator = it.second;
+            ThermometerProfileEntry entry(it.first, (uint64_t) std::llround(accumulator.hit),
+                                          (uint64_t) std::llround(accumulator.access));
+            entry.inputs = (uint16_t) std::min<uint64_t>(accumulator.inputs, UINT16_MAX);
+            entry.min_ratio = accumulator.min_ratio;
+            entry.max_ratio = accumulator.max_ratio;
+            entries.push_back(entry);
+        }
+        ThermometerProfile::sort_entries(entries);
+    }
+};
+
+#endif //CHAMPSIM_PT_THERMOMETER_PROFILE_H
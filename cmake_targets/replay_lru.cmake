@@ -0,0 +1,10 @@
+set(
+        MODULES
+        prefetcher_fdip_l1i
+        prefetcher_no_l1d
+        prefetcher_no_l2c
+        prefetcher_no_llc
+        replacement_lru_llc
+        branch_replay
+        btb_basic_btb
+)
\ No newline at end of file
@@ -0,0 +1,177 @@
+#ifndef CHAMPSIM_PT_ARTIFACT_STORE_H
+#define CHAMPSIM_PT_ARTIFACT_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+
+extern std::string artifact_store;
+
+/*
+ * Content-addressed store for generated artifacts (OPT records, OPT access records, twig
+ * records, branch bias records).
+ *
+ * An artifact is named by its kind, the trace short name it was generated for and the knobs
+ * its content depends on, and is kept at
+ *   <artifact_store>/<kind>/<name>.<key>.<ext>
+ * where key is a hash of all three. A manifest next to it lists the same fields and the
+ * producer binary (path, size and modification time), so a producer can tell that an
+ * artifact from the same binary and inputs exists and skip regenerating it.
+ *
+ * Writers write to <path>.partial, and commit() renames it into place before writing the
+ * manifest. Readers only use a stored artifact whose manifest matches, so a crashed or
+ * running writer never leaves a truncated artifact that would be preferred over the legacy one.
+ *
+ * Without -artifact_store, the legacy /mnt/storage paths are used. Readers look in the store
+ * first and fall back to the legacy path, so old artifacts keep working.
+ */
+class Artifact {
+    std::string kind;
+    std::string name;
+    std::string extension;
+    std::vector<std::pair<std::string, std::string>> knobs;
+
+    static uint64_t fnv1a(const std::string &data, uint64_t hash = 0xcbf29ce484222325ULL) {
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    boost::filesystem::path manifest_path() const {
+        auto manifest = path();
+        manifest.replace_extension(".manifest");
+        return manifest;
+    }
+
+    boost::filesystem::path partial_path() const {
+        auto partial = path();
+        partial += ".partial";
+        return partial;
+    }
+
+    // Manifest lines that name the content, without the producer.
+    std::string fields() const {
+        std::stringstream out;
+        out << "kind " << kind << std::endl << "name " << name << std::endl;
+        for (auto &knob : knobs) {
+            out << "knob " << knob.first << " " << knob.second << std::endl;
+        }
+        return out.str();
+    }
+
+    std::string manifest() const {
+        return fields() + "producer " + producer() + "\n";
+    }
+
+    // Content of the stored manifest, empty if the artifact or its manifest is missing.
+    std::string stored_manifest() const {
+        if (!enabled() || !boost::filesystem::exists(path())) {
+            return "";
+        }
+        std::ifstream in(manifest_path().c_str());
+        if (!in.is_open()) {
+            return "";
+        }
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    }
+
+public:
+    Artifact(std::string kind, std::string name, std::string extension) :
+            kind(std::move(kind)), name(std::move(name)), extension(std::move(extension)) {}
+
+    Artifact &with(const std::string &knob, const std::string &value) {
+        knobs.emplace_back(knob, value);
+        return *this;
+    }
+
+    Artifact &with(const std::string &knob, uint64_t value) {
+        return with(knob, std::to_string(value));
+    }
+
+    static bool enabled() {
+        return !artifact_store.empty();
+    }
+
+    uint64_t key() const {
+        auto hash = fnv1a(kind + '\0' + name + '\0');
+        for (auto &knob : knobs) {
+            hash = fnv1a(knob.first + '=' + knob.second + '\0', hash);
+        }
+        return hash;
+    }
+
+    boost::filesystem::path path() const {
+        char key_string[17];
+        snprintf(key_string, sizeof(key_string), "%016lx", (unsigned long) key());
+        return boost::filesystem::path(artifact_store) / kind / (name + "." + key_string + extension);
+    }
+
+    // The committed artifact if there is one, otherwise the legacy path.
+    boost::filesystem::path read_path(const boost::filesystem::path &legacy) const {
+        auto stored = stored_manifest();
+        if (stored.compare(0, fields().size(), fields()) == 0 && stored.size() > fields().size()) {
+            return path();
+        }
+        return legacy;
+    }
+
+    // The partial store path (its directory is created) with a store, otherwise the legacy path.
+    boost::filesystem::path write_path(const boost::filesystem::path &legacy) const {
+        if (!enabled()) {
+            return legacy;
+        }
+        boost::filesystem::create_directories(path().parent_path());
+        return partial_path();
+    }
+
+    // Whether this binary already produced the artifact from the same inputs.
+    bool current() const {
+        return stored_manifest() == manifest();
+    }
+
+    // Moves the completely written artifact into place and records its producer.
+    void commit() const {
+        if (!enabled()) {
+            return;
+        }
+        if (boost::filesystem::exists(partial_path())) {
+            boost::filesystem::rename(partial_path(), path());
+        }
+        auto partial_manifest = manifest_path();
+        partial_manifest += ".partial";
+        {
+            std::ofstream out(partial_manifest.c_str());
+            out << manifest();
+        }
+        boost::filesystem::rename(partial_manifest, manifest_path());
+        std::cout << "Stored artifact " << path() << std::endl;
+    }
+
+    // Path, size and modification time of the running binary.
+    static std::string producer() {
+        char exe[4096];
+        auto length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (length <= 0) {
+            return "unknown";
+        }
+        exe[length] = '\0';
+        struct stat st = {};
+        stat(exe, &st);
+        return std::string(exe) + " " + std::to_string((uint64_t) st.st_size) + " " +
+               std::to_string((uint64_t) st.st_mtime);
+    }
+};
+
+#endif //CHAMPSIM_PT_ARTIFACT_STORE_H
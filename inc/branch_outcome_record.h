@@ -0,0 +1,198 @@
+#ifndef CHAMPSIM_PT_BRANCH_OUTCOME_RECORD_H
+#define CHAMPSIM_PT_BRANCH_OUTCOME_RECORD_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "artifact_store.h"
+
+/*
+ * Bit-packed record of the direction predictor's output for every dynamic branch.
+ *
+ * predict_branch() runs once per branch in trace order when the branch enters the front end
+ * (init_instruction), and the predictors here ignore the BTB target and always-taken
+ * arguments, so the prediction stream of a (trace, predictor) pair is the same for every BTB
+ * policy. -record_branch_outcomes writes that stream once, and the replay predictor
+ * (branch/replay) streams it back instead of running the predictor.
+ *
+ * File layout: the magic, the number of predictions, the -bp_update_delay the predictions were
+ * made with, then one bit per prediction packed LSB first into 64-bit words. The header is
+ * written as zeros and filled in by close() from the final stats, magic last, so the record of
+ * a run that did not finish is rejected.
+ *
+ * A run may read a few branches past the record (the front end fetches ahead of the last
+ * retired instruction, and how far depends on timing); those are predicted not taken and
+ * counted as overruns, and lie outside the measured instructions.
+ */
+class BranchOutcomeRecord {
+    static constexpr uint64_t MAGIC = 0x32524f4250ULL; // "PBOR2"
+    static constexpr uint64_t BUFFER_WORDS = 4096;
+
+    enum class Mode {
+        NONE,
+        RECORD,
+        REPLAY
+    };
+
+    Mode mode = Mode::NONE;
+    FILE *file = nullptr;
+    Artifact artifact = Artifact("branch_outcome_record", "", ".bin");
+    std::vector<uint64_t> buffer = std::vector<uint64_t>(BUFFER_WORDS);
+    uint64_t buffered_bits = 0; // bits written to, or read from, buffer
+    uint64_t buffered_limit = 0; // bits readable in buffer
+    uint64_t total = 0; // predictions recorded, or in the replayed record
+    uint64_t update_delay = 0; // -bp_update_delay of the predictions being recorded
+    uint64_t consumed = 0;
+    uint64_t overrun = 0;
+
+    static Artifact make_artifact(const std::string &short_name, const std::string &predictor, uint32_t cpu,
+                                  uint64_t warmup_instructions, uint64_t simulation_instructions,
+                                  uint64_t bp_update_delay) {
+        return Artifact("branch_outcome_record", short_name, ".bin")
+                .with("predictor", predictor)
+                .with("cpu", cpu)
+                .with("warmup_instructions", warmup_instructions)
+                .with("simulation_instructions", simulation_instructions)
+                .with("bp_update_delay", bp_update_delay);
+    }
+
+    static boost::filesystem::path legacy_path(const std::string &short_name, const std::string &predictor) {
+        return boost::filesystem::path("/mnt/storage/shixins/champsim_pt/branch_outcome_record") / predictor /
+               (short_name + ".bin");
+    }
+
+    void flush() {
+        auto words = (buffered_bits + 63) / 64;
+        auto written = fwrite(buffer.data(), sizeof(uint64_t), words, file);
+        assert(written == words);
+        std::fill(buffer.begin(), buffer.begin() + words, 0);
+        buffered_bits = 0;
+    }
+
+    void refill() {
+        auto remaining = total - consumed;
+        auto words = std::min(BUFFER_WORDS, (remaining + 63) / 64);
+        auto read = fread(buffer.data(), sizeof(uint64_t), words, file);
+        if (read != words) {
+            std::cerr << "Truncated branch outcome record " << artifact.path() << std::endl;
+            exit(1);
+        }
+        buffered_bits = 0;
+        buffered_limit = std::min(remaining, words * 64);
+    }
+
+public:
+    // Completes a record, or reports a replay. Called from the final stats of the CPU.
+    void close() {
+        if (mode == Mode::RECORD) {
+            flush();
+            uint64_t header[3] = {MAGIC, total, update_delay};
+            fseek(file, sizeof(uint64_t), SEEK_SET);
+            auto written = fwrite(header + 1, sizeof(uint64_t), 2, file);
+            assert(written == 2);
+            fflush(file);
+            // the magic goes last, once the rest of the record is in place
+            fseek(file, 0, SEEK_SET);
+            written = fwrite(header, sizeof(uint64_t), 1, file);
+            assert(written == 1);
+            fclose(file);
+            artifact.commit();
+            std::cout << "Recorded branch outcomes: " << total << std::endl;
+        } else if (mode == Mode::REPLAY) {
+            fclose(file);
+            std::cout << "Replayed branch outcomes: " << consumed << " of " << total
+                      << " past the record: " << overrun << std::endl;
+        }
+        mode = Mode::NONE;
+        file = nullptr;
+    }
+
+    bool is_replaying() const {
+        return mode == Mode::REPLAY;
+    }
+
+    void open_record(const std::string &short_name, const std::string &predictor, uint32_t cpu,
+                     uint64_t warmup_instructions, uint64_t simulation_instructions, uint64_t bp_update_delay) {
+        artifact = make_artifact(short_name, predictor, cpu, warmup_instructions, simulation_instructions,
+                                 bp_update_delay);
+        auto legacy = legacy_path(short_name, predictor);
+        if (!Artifact::enabled()) {
+            boost::filesystem::create_directories(legacy.parent_path());
+        }
+        auto filename = artifact.write_path(legacy);
+        std::cout << "Open branch outcome record " << filename << std::endl;
+        file = fopen(filename.c_str(), "wb");
+        assert(file != nullptr);
+        uint64_t header[3] = {}; // filled in by close()
+        auto written = fwrite(header, sizeof(uint64_t), 3, file);
+        assert(written == 3);
+        update_delay = bp_update_delay;
+        mode = Mode::RECORD;
+    }
+
+    void open_replay(const std::string &short_name, const std::string &predictor, uint32_t cpu,
+                     uint64_t warmup_instructions, uint64_t simulation_instructions, uint64_t bp_update_delay) {
+        artifact = make_artifact(short_name, predictor, cpu, warmup_instructions, simulation_instructions,
+                                 bp_update_delay);
+        auto filename = artifact.read_path(legacy_path(short_name, predictor));
+        file = fopen(filename.c_str(), "rb");
+        uint64_t header[3] = {};
+        if (file == nullptr || fread(header, sizeof(uint64_t), 3, file) != 3 || header[0] != MAGIC) {
+            if (file != nullptr && header[0] == 0) {
+                std::cerr << "Incomplete branch outcome record " << filename
+                          << ": the recording run did not finish" << std::endl;
+            } else {
+                std::cerr << "No " << predictor << " branch outcome record at " << filename
+                          << ", run the " << predictor << " binary with -record_branch_outcomes first" << std::endl;
+            }
+            exit(1);
+        }
+        if (header[1] == 0) {
+            std::cerr << "Empty branch outcome record " << filename << std::endl;
+            exit(1);
+        }
+        if (header[2] != bp_update_delay) {
+            std::cerr << "Branch outcome record " << filename << " was made with -bp_update_delay " << header[2]
+                      << ", not " << bp_update_delay << std::endl;
+            exit(1);
+        }
+        std::cout << "Replay branch outcome record " << filename << std::endl;
+        total = header[1];
+        mode = Mode::REPLAY;
+    }
+
+    void record(uint8_t taken) {
+        if (mode != Mode::RECORD) {
+            return;
+        }
+        if (taken) {
+            buffer[buffered_bits / 64] |= 1ULL << (buffered_bits % 64);
+        }
+        buffered_bits++;
+        total++;
+        if (buffered_bits == BUFFER_WORDS * 64) {
+            flush();
+        }
+    }
+
+    uint8_t replay() {
+        if (consumed == total) {
+            overrun++;
+            return 0;
+        }
+        if (buffered_bits == buffered_limit) {
+            refill();
+        }
+        uint8_t taken = (buffer[buffered_bits / 64] >> (buffered_bits % 64)) & 1;
+        buffered_bits++;
+        consumed++;
+        return taken;
+    }
+};
+
+#endif //CHAMPSIM_PT_BRANCH_OUTCOME_RECORD_H
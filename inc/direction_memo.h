@@ -0,0 +1,41 @@
+#ifndef CHAMPSIM_PT_DIRECTION_MEMO_H
+#define CHAMPSIM_PT_DIRECTION_MEMO_H
+
+#include <cstdint>
+
+/*
+ * Last direction predicted for each branch, for predictors whose prediction has side effects
+ * (TAGE, TAGE-SC-L). predict_branch() records every prediction, and peek_direction() answers
+ * from here without touching predictor state. The table is direct-mapped and tagged with the
+ * full ip, so a miss (never predicted, or evicted by another branch) is reported and the
+ * predictor falls back to its read-only base prediction.
+ */
+template<uint64_t LOG_ENTRIES>
+class DirectionMemo {
+    struct Entry {
+        uint64_t ip = 0;
+        uint8_t taken = 0;
+    };
+
+    Entry entries[1 << LOG_ENTRIES];
+
+    static uint64_t index(uint64_t ip) {
+        return ((ip >> 2) ^ (ip >> (2 + LOG_ENTRIES))) & ((1 << LOG_ENTRIES) - 1);
+    }
+
+public:
+    void record(uint64_t ip, uint8_t taken) {
+        auto &entry = entries[index(ip)];
+        entry.ip = ip;
+        entry.taken = taken;
+    }
+
+    bool lookup(uint64_t ip, uint8_t &taken) const {
+        auto &entry = entries[index(ip)];
+        if (entry.ip != ip || ip == 0) return false;
+        taken = entry.taken;
+        return true;
+    }
+};
+
+#endif //CHAMPSIM_PT_DIRECTION_MEMO_H
@@ -125,6 +125,7 @@ struct ooo_model_instr {
 
     uint8_t branch_type = NOT_BRANCH;
     uint64_t branch_target = 0;
+    uint8_t temperature_hint = 0; // Sidecar Thermometer hint (temperature_hint.h), 0 if none
 
     uint8_t translated = 0,
             fetched = 0,
@@ -2,6 +2,7 @@
 #define OOO_CPU_H
 
 #include <array>
+#include <deque>
 #include <functional>
 #include <set>
 #include <unordered_map>
@@ -10,7 +11,11 @@
 #include "delay_queue.hpp"
 #include "instruction.h"
 #include "cache.h"
+#include "artifact_store.h"
 #include "instruction.h"
+#include "shotgun_footprint.h"
+#include "predecoder.h"
+#include "twig_footprint.h"
 
 #define DEADLOCK_CYCLE 1000000
 
@@ -43,8 +48,11 @@ public:
 
     uint64_t predicted_taken_branch_count = 0, btb_miss_taken_branch_count = 0;
 
-    // Prefetch of shotgun
-    unordered_map<uint64_t, vector<uint64_t>> shotgun_prefetch_region;
+    // Prefetch of shotgun: the footprint a U-BTB hit published, keyed by the ip the runahead reaches
+    unordered_map<uint64_t, ShotgunFootprint> shotgun_prefetch_region;
+
+    // BTB prefetching from predecoded L1I fills, off unless -predecoder is given
+    Predecoder predecoder;
 
     // instruction
     input_instr current_instr;
@@ -254,15 +262,36 @@ public:
 
     // branch predictor
     uint8_t predict_branch(uint64_t ip, uint64_t predicted_target, uint8_t always_taken, uint8_t branch_type);
+    // Direction of ip for BTB replacement: cheap and never changes predictor state, so it may
+    // differ from what predict_branch() would return.
+    uint8_t peek_direction(uint64_t ip);
+    // Name of the direction predictor, keys its branch outcome records (branch_outcome_record.h).
+    string branch_predictor_name();
 
     void initialize_branch_predictor(),
             last_branch_result(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type);
+    // Delayed update (-bp_update_delay), split like a pipeline with speculative history:
+    // update_branch_history() runs right after predict_branch() and updates the histories the
+    // next prediction uses, keeping this branch's prediction state (indices, tags, sums).
+    // train_branch() trains the tables with the oldest kept state, bp_update_delay branches
+    // later. Both are called in fetch order.
+    void update_branch_history(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type);
+    void train_branch(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type);
+
+    // Outcomes waiting to train the predictor tables, oldest first.
+    struct BranchUpdate {
+        uint64_t ip, branch_target;
+        uint8_t taken, branch_type;
+    };
+    std::deque<BranchUpdate> bp_update_queue;
 
     // btb
     std::pair<uint64_t, uint8_t> btb_prediction(uint64_t ip, uint8_t branch_type, uint64_t *latency = nullptr);
 
     void initialize_btb();
-    void update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type);
+    // temperature_hint is the sidecar Thermometer hint of the branch (temperature_hint.h), 0 if none.
+    void update_btb(uint64_t ip, uint64_t branch_target, uint8_t taken, uint8_t branch_type,
+                    uint8_t temperature_hint);
     void prefetch_btb(uint64_t ip, uint64_t branch_target, uint8_t branch_type, bool taken, bool to_stream_buffer = false);
     void btb_final_stats();
 
@@ -274,20 +303,47 @@ public:
 
     static std::string find_trace_short_name(std::string &full_path, NameKind name_kind);
 
+    // TRAIN short names, one per input of a comma-separated -input_generalization list.
+    static std::vector<std::string> find_train_short_names(std::string &full_path);
+
+    // OPT records of the trace and its length for this front end. opt_prepass writes the same
+    // record from the trace alone under its own producer.
+    Artifact btb_record_artifact(const string &kind, const string &producer = "simulator") {
+        return Artifact(kind, find_trace_short_name(trace_name, O3_CPU::NameKind::TRACE), ".txt")
+                .with("producer", producer)
+                .with("ifetch_buffer_size", IFETCH_BUFFER_SIZE)
+                .with("warmup_instructions", warmup_instructions)
+                .with("simulation_instructions", simulation_instructions);
+    }
+
+    string btb_record_path(const string &kind, const string &legacy, bool write) {
+        auto artifact = btb_record_artifact(kind);
+        if (write) {
+            return artifact.write_path(legacy).string();
+        }
+        // Records of the simulator itself are preferred over opt_prepass ones.
+        auto prepass = btb_record_artifact(kind, "opt_prepass");
+        return artifact.read_path(prepass.read_path(legacy)).string();
+    }
+
     void open_btb_record(const char *mode, bool is_shotgun) {
         string directory_name = "/mnt/storage/shixins/champsim_pt/";
         auto filename = find_trace_short_name(trace_name, O3_CPU::NameKind::TRACE) + ".txt";
+        bool write = mode[0] == 'w';
         if (is_shotgun) {
-            string cond_dir_name = directory_name + "btb_conditional_record/" + filename;
+            string cond_dir_name = btb_record_path("btb_conditional_record",
+                                                   directory_name + "btb_conditional_record/" + filename, write);
             btb_conditional_record = fopen(cond_dir_name.c_str(), mode);
-            string uncond_dir_name = directory_name + "btb_unconditional_record/" + filename;
+            string uncond_dir_name = btb_record_path("btb_unconditional_record",
+                                                     directory_name + "btb_unconditional_record/" + filename, write);
             btb_unconditional_record = fopen(uncond_dir_name.c_str(), mode);
             assert(btb_conditional_record != nullptr && btb_unconditional_record != nullptr);
         } else {
             if (IFETCH_BUFFER_SIZE != 192) {
                 filename = ("fdip" + std::to_string(IFETCH_BUFFER_SIZE)) + "_" + filename;
             }
-            string dir_name = directory_name + "btb_record_insert_taken/" + filename;
+            string dir_name = btb_record_path("btb_record_insert_taken",
+                                              directory_name + "btb_record_insert_taken/" + filename, write);
             cout << "Open btb record file " << dir_name << endl;
             btb_record = fopen(dir_name.c_str(), mode);
             assert(btb_record != nullptr);
@@ -322,7 +378,7 @@ public:
         program_name = full_path_str.substr(pos + 1);
     }
 
-    unordered_map<uint64_t, vector<pair<uint64_t, uint64_t>>> *twig_prefetch_match = nullptr;
+    TwigFootprint *twig_prefetch_match = nullptr;
 };
 
 #endif
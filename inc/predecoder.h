@@ -0,0 +1,203 @@
+#ifndef CHAMPSIM_PT_PREDECODER_H
+#define CHAMPSIM_PT_PREDECODER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "champsim_constants.h"
+
+struct PredecodedBranch {
+    uint64_t ip;
+    uint64_t target;
+    uint8_t branch_type;
+    bool taken;
+};
+
+/*
+ * The pipeline between an instruction line reaching the predecoder and its branches reaching
+ * the BTB: every branch is ready latency + 1 cycles after it is pushed, and at most
+ * bandwidth branches (0 means no limit) leave per cycle, oldest first. The ready cycle is
+ * stored at push, so a cycle costs O(1) plus the branches it issues.
+ */
+class PredecodeQueue {
+    struct Entry {
+        PredecodedBranch branch;
+        uint64_t ready;
+    };
+
+    std::deque<Entry> queue;
+    uint64_t cycle = 0; // Number of operate calls so far
+
+public:
+    uint64_t latency = 0;
+    uint64_t bandwidth = 0;
+
+    void push(const PredecodedBranch &branch) {
+        queue.push_back({branch, cycle + latency + 1});
+    }
+
+    uint64_t size() const {
+        return queue.size();
+    }
+
+    // Advances one cycle and passes every branch that leaves to issue.
+    template<typename F>
+    void operate(F issue) {
+        cycle++;
+        for (uint64_t issued = 0; !queue.empty() && queue.front().ready <= cycle &&
+                                  (bandwidth == 0 || issued < bandwidth); issued++) {
+            issue(queue.front().branch);
+            queue.pop_front();
+        }
+    }
+};
+
+/*
+ * Predecoder BTB prefetching as a core pipeline stage (-predecoder btb|stream_buffer).
+ *
+ * Every L1I fill looks up the branches of the filled line in a per-line branch index and
+ * queues them in a PredecodeQueue (-predecode_latency, -predecode_bandwidth); the branches
+ * that leave go to prefetch_btb() of whatever BTB module is linked, into the BTB itself or
+ * into its prefetch stream buffer. The index is learned from the trace as branches are
+ * fetched, or loaded once from -predecoder_branch_map, a static map of the binary with one
+ * "ip target branch_type" line per branch (ip and target in hex), as written by the
+ * predecoder_map tool.
+ */
+class Predecoder {
+public:
+    enum class Mode {
+        OFF,
+        BTB,
+        STREAM_BUFFER
+    };
+
+private:
+    Mode mode = Mode::OFF;
+    bool static_map = false;
+    std::unordered_map<uint64_t, std::vector<PredecodedBranch>> lines; // block -> branches of the line
+    PredecodeQueue queue;
+
+    uint64_t fills = 0;
+    uint64_t fills_with_branches = 0;
+    uint64_t queued = 0;
+    uint64_t issued = 0;
+
+    // A predecoder knows the direct target of a branch whatever its last direction was, so a
+    // not-taken instance only updates the direction and keeps the last known target.
+    void add(const PredecodedBranch &branch) {
+        auto &line = lines[branch.ip >> LOG2_BLOCK_SIZE];
+        for (auto &known : line) {
+            if (known.ip == branch.ip) {
+                known.branch_type = branch.branch_type;
+                known.taken = branch.taken;
+                if (branch.target != 0) {
+                    known.target = branch.target;
+                }
+                return;
+            }
+        }
+        line.push_back(branch);
+    }
+
+public:
+    static bool parse_mode(const std::string &name, Mode &parsed) {
+        if (name == "off") {
+            parsed = Mode::OFF;
+        } else if (name == "btb") {
+            parsed = Mode::BTB;
+        } else if (name == "stream_buffer") {
+            parsed = Mode::STREAM_BUFFER;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void init(uint32_t cpu, const std::string &mode_name, uint64_t latency, uint64_t bandwidth,
+              const std::string &branch_map) {
+        parse_mode(mode_name, mode);
+        if (mode == Mode::OFF) {
+            return;
+        }
+        queue.latency = latency;
+        queue.bandwidth = bandwidth;
+        if (!branch_map.empty()) {
+            std::ifstream in(branch_map);
+            if (!in) {
+                std::cerr << "Cannot open predecoder branch map " << branch_map << std::endl;
+                exit(1);
+            }
+            uint64_t ip, target;
+            int branch_type;
+            while (in >> std::hex >> ip >> target >> std::dec >> branch_type) {
+                add({ip, target, (uint8_t) branch_type, target != 0});
+            }
+            static_map = true;
+        }
+        std::cout << "CPU " << cpu << " predecoder into " << mode_name << " latency: " << latency
+                  << " bandwidth: " << bandwidth;
+        if (static_map) {
+            std::cout << " branch map: " << branch_map << " lines: " << lines.size();
+        }
+        std::cout << std::endl;
+    }
+
+    bool enabled() const {
+        return mode != Mode::OFF;
+    }
+
+    bool to_stream_buffer() const {
+        return mode == Mode::STREAM_BUFFER;
+    }
+
+    // A branch entering the front end, used to learn the index unless a static map is loaded.
+    void branch_operate(uint64_t ip, uint64_t target, uint8_t branch_type) {
+        if (!static_map) {
+            add({ip, target, branch_type, target != 0});
+        }
+    }
+
+    void fill(uint64_t v_addr) {
+        fills++;
+        auto line = lines.find(v_addr >> LOG2_BLOCK_SIZE);
+        if (line == lines.end()) {
+            return;
+        }
+        fills_with_branches++;
+        for (auto &branch : line->second) {
+            // No target is known for a branch that was never taken, so there is nothing to prefetch
+            if (branch.target != 0) {
+                queue.push(branch);
+                queued++;
+            }
+        }
+    }
+
+    // Advances the pipeline one cycle and passes every branch that leaves to issue.
+    template<typename F>
+    void operate(F issue) {
+        queue.operate([&](const PredecodedBranch &branch) {
+            issued++;
+            issue(branch);
+        });
+    }
+
+    void print_final_stats(uint32_t cpu) const {
+        if (mode == Mode::OFF) {
+            return;
+        }
+        std::cout << "CPU " << cpu << " predecoder fills: " << fills
+                  << " fills with branches: " << fills_with_branches
+                  << " branches queued: " << queued
+                  << " issued: " << issued
+                  << " still queued: " << queue.size() << std::endl;
+    }
+};
+
+#endif //CHAMPSIM_PT_PREDECODER_H
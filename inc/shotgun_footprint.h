@@ -0,0 +1,58 @@
+#ifndef CHAMPSIM_PT_SHOTGUN_FOOTPRINT_H
+#define CHAMPSIM_PT_SHOTGUN_FOOTPRINT_H
+
+#include <cstdint>
+
+#include "champsim_constants.h"
+
+/*
+ * Spatial footprint of a Shotgun U-BTB entry: the cache blocks around a call target (call
+ * footprint) or around the call site a return comes back to (return footprint) that held
+ * taken conditional branches the last time the region ran.
+ *
+ * The footprint is a fixed-width bit vector over the SHOTGUN_FOOTPRINT_BLOCKS blocks from
+ * SHOTGUN_FOOTPRINT_BEFORE blocks before the region's block to SHOTGUN_FOOTPRINT_AFTER after
+ * it, so a U-BTB entry carries two 16-bit vectors and no heap storage. Accesses outside
+ * the window are not recorded.
+ */
+constexpr uint64_t SHOTGUN_FOOTPRINT_BEFORE = 2;
+constexpr uint64_t SHOTGUN_FOOTPRINT_AFTER = 6;
+constexpr uint64_t SHOTGUN_FOOTPRINT_BLOCKS = SHOTGUN_FOOTPRINT_BEFORE + 1 + SHOTGUN_FOOTPRINT_AFTER;
+
+struct ShotgunFootprint {
+    uint64_t region_block = 0; // Block the window is centered on
+    uint16_t blocks = 0; // Bit i is block region_block - SHOTGUN_FOOTPRINT_BEFORE + i
+
+    bool empty() const {
+        return blocks == 0;
+    }
+
+    void clear() {
+        blocks = 0;
+    }
+
+    // Records a taken conditional branch at access_block while the region runs.
+    void record(uint64_t block, uint64_t access_block) {
+        if (block != region_block) {
+            // The region moved (a new target), so the old bits describe other code.
+            region_block = block;
+            blocks = 0;
+        }
+        if (access_block + SHOTGUN_FOOTPRINT_BEFORE < block || access_block > block + SHOTGUN_FOOTPRINT_AFTER) {
+            return;
+        }
+        blocks |= (uint16_t) (1u << (access_block + SHOTGUN_FOOTPRINT_BEFORE - block));
+    }
+
+    // Calls f(block address) for every block of the footprint, lowest first.
+    template<typename F>
+    void for_each_block(F f) const {
+        for (uint64_t i = 0; i < SHOTGUN_FOOTPRINT_BLOCKS; i++) {
+            if ((blocks >> i) & 1) {
+                f((region_block + i - SHOTGUN_FOOTPRINT_BEFORE) << LOG2_BLOCK_SIZE);
+            }
+        }
+    }
+};
+
+#endif //CHAMPSIM_PT_SHOTGUN_FOOTPRINT_H
@@ -0,0 +1,103 @@
+#ifndef CHAMPSIM_PT_TEMPERATURE_HINT_H
+#define CHAMPSIM_PT_TEMPERATURE_HINT_H
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+/*
+ * Thermometer temperature hints in a sidecar stream aligned with the trace.
+ *
+ * The temperature_hints tool writes one byte per instruction returned by the trace reader, in
+ * the same order, gzip compressed (hints are 0 for everything but branches, so the stream is
+ * small). The simulator attaches the byte to ooo_model_instr::temperature_hint and passes it
+ * to update_btb(), and the hot_warm_cold BTBs (plain, predecoder and shotgun) read the category
+ * from it on insert instead of looking the branch up in the profile, which models
+ * compiler-inserted hint bits. Instructions past the end of the
+ * stream have no hint and fall back to the profile.
+ */
+namespace temperature_hint {
+    const uint8_t VALID = 0x80;     // The instruction is a branch the tool has seen
+    const uint8_t BYPASS = 0x40;    // OPT never hits this branch, so it is not worth inserting
+    const uint8_t UNTRAINED = 0x20; // The branch is not in the profile
+    const uint8_t CATEGORY_MASK = 0x0f;
+
+    inline uint8_t category(uint8_t hint) {
+        return hint & CATEGORY_MASK;
+    }
+}
+
+class TemperatureHintWriter {
+    gzFile file = nullptr;
+    std::vector<uint8_t> buffer;
+
+public:
+    bool open(const char *path) {
+        file = gzopen(path, "wb");
+        buffer.reserve(1 << 16);
+        return file != nullptr;
+    }
+
+    void append(uint8_t hint) {
+        buffer.push_back(hint);
+        if (buffer.size() == buffer.capacity()) flush();
+    }
+
+    void flush() {
+        if (!buffer.empty()) {
+            auto written = gzwrite(file, buffer.data(), (unsigned) buffer.size());
+            assert(written == (int) buffer.size());
+            buffer.clear();
+        }
+    }
+
+    void close() {
+        if (file == nullptr) return;
+        flush();
+        gzclose(file);
+        file = nullptr;
+    }
+};
+
+class TemperatureHintReader {
+    gzFile file = nullptr;
+    std::vector<uint8_t> buffer;
+    size_t position = 0;
+    bool finished = false;
+
+    void refill() {
+        buffer.resize(1 << 16);
+        auto read = gzread(file, buffer.data(), (unsigned) buffer.size());
+        buffer.resize(read > 0 ? read : 0);
+        position = 0;
+        finished = buffer.empty();
+    }
+
+public:
+    TemperatureHintReader() = default;
+
+    TemperatureHintReader(const TemperatureHintReader &other) = delete;
+
+    ~TemperatureHintReader() {
+        if (file != nullptr) gzclose(file);
+    }
+
+    bool open(const char *path) {
+        file = gzopen(path, "rb");
+        return file != nullptr;
+    }
+
+    // Hint of the next instruction; 0 (no hint) once the stream ends.
+    uint8_t get() {
+        if (finished) return 0;
+        if (position == buffer.size()) {
+            refill();
+            if (finished) return 0;
+        }
+        return buffer[position++];
+    }
+};
+
+#endif //CHAMPSIM_PT_TEMPERATURE_HINT_H
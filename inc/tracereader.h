@@ -28,5 +28,8 @@ class tracereader
         virtual ooo_model_instr get() = 0;
 };
 
+// Register-based branch classification for non-PT (ChampSim format) traces.
+void classify_branch(ooo_model_instr &arch_instr);
+
 tracereader* get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite, bool is_pt);
 
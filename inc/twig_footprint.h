@@ -0,0 +1,210 @@
+#ifndef CHAMPSIM_PT_TWIG_FOOTPRINT_H
+#define CHAMPSIM_PT_TWIG_FOOTPRINT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::vector;
+
+/*
+ * Twig prefetch footprint: for every function start, the (pc, target) of the branches Twig
+ * prefetches into the BTB when the function is entered.
+ *
+ * The text footprint from the Twig analysis (footprint.txt) has one line per function,
+ * "function_start entry_count pc target pc target ..." in decimal. The binary footprint
+ * written by twig_profile holds the same table in CSR form, sorted by function start:
+ *
+ *   TwigFootprintHeader
+ *   starts:  num_functions uint64_t, ascending
+ *   offsets: num_functions + 1 uint64_t, the span of starts[i] is entries[offsets[i], offsets[i + 1])
+ *   entries: num_entries TwigFootprintEntry
+ *
+ * The loader maps a binary footprint as it is, and parses a text one line by line straight
+ * into the same arrays. A function listed twice keeps its last line, as before.
+ */
+const uint64_t TWIG_FOOTPRINT_MAGIC = 0x3130504647495754ULL; // "TWIGFP01"
+
+struct TwigFootprintHeader {
+    uint64_t magic;
+    uint64_t num_functions;
+    uint64_t num_entries;
+};
+
+struct TwigFootprintEntry {
+    uint64_t pc;
+    uint64_t target;
+};
+
+// The entries of one function; empty if the function has no footprint.
+struct TwigFootprintSpan {
+    const TwigFootprintEntry *first = nullptr;
+    const TwigFootprintEntry *last = nullptr;
+
+    const TwigFootprintEntry *begin() const { return first; }
+
+    const TwigFootprintEntry *end() const { return last; }
+
+    bool empty() const { return first == last; }
+
+    uint64_t size() const { return last - first; }
+};
+
+class TwigFootprint {
+    void *map = nullptr;
+    uint64_t map_size = 0;
+    vector<uint64_t> owned_starts;
+    vector<uint64_t> owned_offsets;
+    vector<TwigFootprintEntry> owned_entries;
+    const uint64_t *starts = nullptr;
+    const uint64_t *offsets = nullptr;
+    const TwigFootprintEntry *entries = nullptr;
+    uint64_t num_functions = 0;
+    uint64_t num_entries = 0;
+
+    void unmap() {
+        if (map != nullptr) {
+            munmap(map, map_size);
+            map = nullptr;
+        }
+    }
+
+    static uint64_t file_size(uint64_t functions, uint64_t entries) {
+        return sizeof(TwigFootprintHeader) + (2 * functions + 1) * sizeof(uint64_t) +
+               entries * sizeof(TwigFootprintEntry);
+    }
+
+    // Maps a binary footprint; returns false if path is not one.
+    bool map_binary(const char *path) {
+        FILE *in = fopen(path, "rb");
+        if (in == nullptr) return false;
+        struct stat st = {};
+        fstat(fileno(in), &st);
+        auto size = (uint64_t) st.st_size;
+        TwigFootprintHeader header = {};
+        if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != TWIG_FOOTPRINT_MAGIC) {
+            fclose(in);
+            return false;
+        }
+        assert(file_size(header.num_functions, header.num_entries) <= size);
+        unmap();
+        map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+        fclose(in);
+        assert(map != MAP_FAILED);
+        map_size = size;
+        num_functions = header.num_functions;
+        num_entries = header.num_entries;
+        starts = (const uint64_t *) ((const uint8_t *) map + sizeof(header));
+        offsets = starts + num_functions;
+        entries = (const TwigFootprintEntry *) (offsets + num_functions + 1);
+        return true;
+    }
+
+    // Parses a text footprint; returns false if the file cannot be opened.
+    bool read_text(const char *path) {
+        FILE *in = fopen(path, "r");
+        if (in == nullptr) return false;
+        // (function start, line) of every line, then the entries of every line in file order
+        vector<std::pair<uint64_t, uint64_t>> functions;
+        vector<uint64_t> line_offsets;
+        vector<TwigFootprintEntry> line_entries;
+        char *line = nullptr;
+        size_t capacity = 0;
+        while (getline(&line, &capacity, in) > 0) {
+            char *p = line, *end;
+            uint64_t function_start = strtoull(p, &end, 10);
+            if (end == p) continue; // blank line
+            p = end;
+            uint64_t entry_count = strtoull(p, &end, 10);
+            if (end == p) {
+                std::cout << "Wrong format of PGO prefetcher footprint file" << std::endl;
+                assert(0);
+            }
+            functions.emplace_back(function_start, functions.size());
+            line_offsets.push_back(line_entries.size());
+            for (uint64_t i = 0; i < entry_count; i++) {
+                p = end;
+                uint64_t pc = strtoull(p, &end, 10);
+                assert(end != p);
+                p = end;
+                uint64_t target = strtoull(p, &end, 10);
+                assert(end != p);
+                line_entries.push_back({pc, target});
+            }
+            p = end;
+            strtoull(p, &end, 10);
+            assert(end == p); // exactly entry_count pairs
+        }
+        line_offsets.push_back(line_entries.size());
+        free(line);
+        fclose(in);
+
+        // Sort by function start; of the lines of one function the last one wins
+        std::stable_sort(functions.begin(), functions.end(),
+                         [](const std::pair<uint64_t, uint64_t> &a, const std::pair<uint64_t, uint64_t> &b) {
+                             return a.first < b.first;
+                         });
+        unmap();
+        owned_starts.clear();
+        owned_offsets.assign(1, 0);
+        owned_entries.clear();
+        for (uint64_t i = 0; i < functions.size(); i++) {
+            if (i + 1 < functions.size() && functions[i + 1].first == functions[i].first) continue;
+            auto l = functions[i].second;
+            owned_starts.push_back(functions[i].first);
+            owned_entries.insert(owned_entries.end(), line_entries.begin() + line_offsets[l],
+                                 line_entries.begin() + line_offsets[l + 1]);
+            owned_offsets.push_back(owned_entries.size());
+        }
+        starts = owned_starts.data();
+        offsets = owned_offsets.data();
+        entries = owned_entries.data();
+        num_functions = owned_starts.size();
+        num_entries = owned_entries.size();
+        return true;
+    }
+
+public:
+    TwigFootprint() = default;
+    TwigFootprint(const TwigFootprint &other) = delete;
+    TwigFootprint &operator=(const TwigFootprint &other) = delete;
+
+    ~TwigFootprint() { unmap(); }
+
+    // Maps a binary footprint, or parses path as a text footprint if it is not one.
+    bool load(const char *path) {
+        return map_binary(path) || read_text(path);
+    }
+
+    bool write(const char *path) const {
+        FILE *out = fopen(path, "wb");
+        if (out == nullptr) return false;
+        TwigFootprintHeader header = {TWIG_FOOTPRINT_MAGIC, num_functions, num_entries};
+        fwrite(&header, sizeof(header), 1, out);
+        fwrite(starts, sizeof(uint64_t), num_functions, out);
+        fwrite(offsets, sizeof(uint64_t), num_functions + 1, out);
+        fwrite(entries, sizeof(TwigFootprintEntry), num_entries, out);
+        fclose(out);
+        return true;
+    }
+
+    TwigFootprintSpan find(uint64_t function_start) const {
+        auto it = std::lower_bound(starts, starts + num_functions, function_start);
+        if (it == starts + num_functions || *it != function_start) return {};
+        auto i = it - starts;
+        return {entries + offsets[i], entries + offsets[i + 1]};
+    }
+
+    uint64_t function_count() const { return num_functions; }
+
+    uint64_t entry_count() const { return num_entries; }
+};
+
+#endif //CHAMPSIM_PT_TWIG_FOOTPRINT_H
@@ -0,0 +1,130 @@
+#ifndef CHAMPSIM_PT_TWIG_LOG_H
+#define CHAMPSIM_PT_TWIG_LOG_H
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <zlib.h>
+
+#include "instruction.h"
+
+/*
+ * Twig BTB log (-twig): one record per BTB lookup and update of a taken direct branch.
+ *
+ * The log is gzip-compressed binary: TWIG_LOG_MAGIC, then fixed-size TwigLogRecords. The
+ * writer buffers records and compresses them in large blocks at the fastest level, so a
+ * BTB access costs a copy into the buffer instead of a gzprintf call. twig_profile -dump
+ * prints a log as the text lines the Twig analysis reads:
+ *
+ *   BTB-Lookup: <cycle> 0 <CF_BR|CF_CBR|CF_CALL> <ip> <target> <0 hit, 1 miss, 2 wrong target>
+ *   BTB-Update: <cycle> 0 <CF_BR|CF_CBR|CF_CALL> <ip> <target> <0 hit, 1 miss or wrong target>
+ */
+const uint64_t TWIG_LOG_MAGIC = 0x31474F4C47495754ULL; // "TWIGLOG1"
+
+enum class BTBOperation : uint8_t {
+    LOOKUP,
+    UPDATE,
+};
+
+struct TwigLogRecord {
+    uint64_t cycle;
+    uint64_t ip;
+    uint64_t target;
+    BTBOperation operation;
+    uint8_t branch_type;
+    uint8_t miss_type; // As printed for the operation, see above
+    uint8_t padding[5];
+};
+
+static_assert(sizeof(TwigLogRecord) == 32, "TwigLogRecord is written as is");
+
+inline const char *twig_branch_type_name(uint8_t branch_type) {
+    switch (branch_type) {
+        case BRANCH_DIRECT_JUMP:
+            return "CF_BR";
+        case BRANCH_CONDITIONAL:
+            return "CF_CBR";
+        case BRANCH_DIRECT_CALL:
+            return "CF_CALL";
+        default:
+            return nullptr;
+    }
+}
+
+class TwigLogWriter {
+    static const uint64_t BUFFER_RECORDS = 1 << 15;
+
+    gzFile file = nullptr;
+    std::vector<TwigLogRecord> buffer;
+
+public:
+    bool open(const char *path) {
+        file = gzopen(path, "wb1");
+        if (file == nullptr) return false;
+        buffer.reserve(BUFFER_RECORDS);
+        gzwrite(file, &TWIG_LOG_MAGIC, sizeof(TWIG_LOG_MAGIC));
+        return true;
+    }
+
+    bool is_open() const {
+        return file != nullptr;
+    }
+
+    void write(BTBOperation operation, uint64_t cycle, uint64_t ip, uint64_t target, uint8_t branch_type,
+               uint8_t miss_type) {
+        buffer.push_back({cycle, ip, target, operation, branch_type, miss_type, {}});
+        if (buffer.size() == BUFFER_RECORDS) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (!buffer.empty()) {
+            gzwrite(file, buffer.data(), (unsigned) (buffer.size() * sizeof(TwigLogRecord)));
+            buffer.clear();
+        }
+    }
+
+    void close() {
+        if (file != nullptr) {
+            flush();
+            gzclose(file);
+            file = nullptr;
+        }
+    }
+};
+
+class TwigLogReader {
+    gzFile file = nullptr;
+
+public:
+    ~TwigLogReader() {
+        if (file != nullptr) gzclose(file);
+    }
+
+    // Returns false if path cannot be opened or is not a binary Twig log.
+    bool open(const char *path) {
+        file = gzopen(path, "rb");
+        if (file == nullptr) return false;
+        gzbuffer(file, 1 << 20);
+        uint64_t magic = 0;
+        return gzread(file, &magic, sizeof(magic)) == sizeof(magic) && magic == TWIG_LOG_MAGIC;
+    }
+
+    bool next(TwigLogRecord &record) {
+        return gzread(file, &record, sizeof(record)) == sizeof(record);
+    }
+
+    // Prints record as a line of the text log.
+    static void print(const TwigLogRecord &record, FILE *out) {
+        auto type_name = twig_branch_type_name(record.branch_type);
+        assert(type_name != nullptr);
+        fprintf(out, "%s %" PRIu64 " 0 %s %" PRIu64 " %" PRIu64 " %d\n",
+                record.operation == BTBOperation::LOOKUP ? "BTB-Lookup:" : "BTB-Update:",
+                record.cycle, type_name, record.ip, record.target, record.miss_type);
+    }
+};
+
+#endif //CHAMPSIM_PT_TWIG_LOG_H
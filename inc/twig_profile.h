@@ -6,13 +6,13 @@
 #define CHAMPSIM_PT_TWIG_PROFILE_H
 
 #include "ooo_cpu.h"
+#include "twig_log.h"
 #include <unordered_map>
 #include <vector>
 #include <map>
 #include <fstream>
 #include <iostream>
 #include <boost/filesystem.hpp>
-#include <zlib.h>
 namespace fs = boost::filesystem;
 
 using std::string;
@@ -24,12 +24,6 @@ extern uint8_t total_btb_ways;
 extern uint64_t total_btb_entries;
 
 
-enum class BTBOperation {
-    LOOKUP,
-    UPDATE,
-};
-
-
 struct BranchEntry {
     uint64_t ip;
     uint64_t target;
@@ -58,33 +52,9 @@ struct BranchEntry {
             return 1;
     }
 
-    [[nodiscard]] string get_branch_type_name() const {
-        if (branch_type == BRANCH_DIRECT_JUMP) {
-            return "CF_BR";
-        } else if (branch_type == BRANCH_CONDITIONAL) {
-            return "CF_CBR";
-        } else if (branch_type == BRANCH_DIRECT_CALL) {
-            return "CF_CALL";
-        } else {
-            cout << "Invalid branch type in BTB" << endl;
-            assert(0);
-        }
-    }
-
-    void write_log(BTBOperation btb_operation, uint64_t cycle_count, gzFile output_file) {
-        if (btb_operation == BTBOperation::LOOKUP) {
-            gzprintf(
-                    output_file,
-                    "BTB-Lookup: %llu %llu %s %llu %llu %d\n",
-                    cycle_count, 0, get_branch_type_name().c_str(), ip, target, miss_type
-                    );
-        } else {
-            gzprintf(
-                    output_file,
-                    "BTB-Update: %llu %llu %s %llu %llu %d\n",
-                    cycle_count, 0, get_branch_type_name().c_str(), ip, target, get_miss_or_hit()
-            );
-        }
+    void write_log(BTBOperation btb_operation, uint64_t cycle_count, TwigLogWriter &output_file) const {
+        output_file.write(btb_operation, cycle_count, ip, target, branch_type,
+                          btb_operation == BTBOperation::LOOKUP ? miss_type : get_miss_or_hit());
     }
 };
 
@@ -92,25 +62,36 @@ struct BranchEntry {
 class TwigRecord {
     // TODO: only consider single cpu
     unordered_map<uint64_t, BranchEntry> lookup_history;
-    gzFile output_trace = nullptr;
+    TwigLogWriter output_trace;
     bool gen = false;
+    Artifact artifact = Artifact("twig_record", "", ".gz");
 
 public:
     ~TwigRecord() {
         cout << "Num of updated instructions: " << lookup_history.size() << endl;
-        if (output_trace != nullptr) {
-            gzclose(output_trace);
+        if (output_trace.is_open()) {
+            output_trace.close();
+            artifact.commit();
         }
     }
 
-    void init(string &short_name, bool generate_twig_trace) {
+    void init(string &short_name, bool generate_twig_trace, uint64_t warmup_instructions,
+              uint64_t simulation_instructions) {
         gen = generate_twig_trace;
         if (!gen) {
             return;
         }
         fs::path twig_record_dir = ("/mnt/storage/shixins/champsim_pt/twig_record");
 //        fs::path twig_record_dir = ("pt_traces/twig_record");
-        fs::create_directory(twig_record_dir);
+        artifact = Artifact("twig_record", short_name, ".gz")
+                .with("btb_ways", total_btb_ways)
+                .with("btb_entries", total_btb_entries)
+                .with("ifetch_buffer_size", IFETCH_BUFFER_SIZE)
+                .with("warmup_instructions", warmup_instructions)
+                .with("simulation_instructions", simulation_instructions);
+        if (!Artifact::enabled()) {
+            fs::create_directory(twig_record_dir);
+        }
         string sub_dir = "way" + std::to_string(total_btb_ways);
         if (total_btb_entries != 8 && total_btb_entries != 8192) {
             if (total_btb_entries % 1024 == 0) {
@@ -122,11 +103,12 @@ public:
         if (IFETCH_BUFFER_SIZE != 192) {
             sub_dir += ("_fdip" + std::to_string(IFETCH_BUFFER_SIZE));
         }
-        fs::create_directory(twig_record_dir / sub_dir);
-        auto filename = twig_record_dir / sub_dir / (short_name + ".gz");
-        output_trace = gzopen(filename.c_str(), "wb");
-        if (output_trace == nullptr) {
-            cout << "Cannot open twig record file to write " << output_trace << endl;
+        if (!Artifact::enabled()) {
+            fs::create_directory(twig_record_dir / sub_dir);
+        }
+        auto filename = artifact.write_path(twig_record_dir / sub_dir / (short_name + ".gz"));
+        if (!output_trace.open(filename.c_str())) {
+            cout << "Cannot open twig record file to write " << filename << endl;
             assert(0);
         }
     }
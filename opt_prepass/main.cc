@@ -0,0 +1,181 @@
+/*
+ * Trace-only OPT pre-pass.
+ *
+ * The OPT BTB replays the demand access stream recorded by ChampSim_*_opt_generate.
+ * That stream only depends on trace order: update_btb() is called once per branch in
+ * init_instruction, the timestamp advances on every non-return, non-indirect branch,
+ * and the branch is recorded when it is taken. This tool walks the trace directly and
+ * writes the same record (binary OPT access format), so the detailed _generate
+ * simulation can be skipped. Next-use information is rebuilt from the record in one
+ * linear pass when the OPT BTB loads it (NextUseIndex).
+ *
+ * The simulator does not stop reading the trace at warmup + simulation instructions: it stops
+ * once that many have retired, and by then the front end has read up to a full IFETCH, decode
+ * and dispatch buffer and ROB further (plus up to a retire width of overshoot at the end of the
+ * warmup and of the simulation). Those instructions go through update_btb as well, so the walk
+ * continues for -fetch_ahead more instructions, by default that bound for the fdip front ends
+ * with -ifetch_buffer_size. The record then covers every access of the simulation; the accesses
+ * past the ones the simulator made only give OPT the real next uses at the end of the run.
+ *
+ * With -artifact_store, the record goes into the artifact store under -name (the trace short
+ * name the simulator derives), where ChampSim_*_opt finds it when the simulator has not
+ * recorded one itself, and a record this binary already produced for the same trace and
+ * instruction counts is not regenerated. The record does not depend on the front end, but the
+ * key still carries -ifetch_buffer_size (default 192) so it is only found by simulators built
+ * with that IFETCH_BUFFER_SIZE, like their own records.
+ *
+ * Usage: opt_prepass [-pt] [-cloudsuite] -warmup_instructions N -simulation_instructions N
+ *                    [-ifetch_buffer_size N] [-fetch_ahead N]
+ *                    (-output <btb_record> | -artifact_store <dir> -name <short name>) <trace>
+ */
+
+#include <getopt.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+#include "tracereader.h"
+#include "artifact_store.h"
+#include "../btb/opt_access_stream.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+uint8_t MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS;
+std::string artifact_store;
+
+// Front end of the fdip configurations besides the IFETCH buffer (cmake_configs/fdip*.cmake)
+const uint64_t DECODE_BUFFER_SIZE = 60;
+const uint64_t DISPATCH_BUFFER_SIZE = 32;
+const uint64_t ROB_SIZE = 352;
+const uint64_t RETIRE_WIDTH = 5;
+
+int main(int argc, char **argv) {
+    uint64_t warmup_instructions = 0, simulation_instructions = 0, ifetch_buffer_size = 192;
+    int64_t fetch_ahead = -1;
+    bool knob_cloudsuite = false, pt = false;
+    string output, name;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"warmup_instructions", required_argument, 0, 'w'},
+            {"simulation_instructions", required_argument, 0, 'i'},
+            {"cloudsuite", no_argument, 0, 'c'},
+            {"pt", no_argument, 0, 'p'},
+            {"output", required_argument, 0, 'o'},
+            {"artifact_store", required_argument, 0, 's'},
+            {"name", required_argument, 0, 'n'},
+            {"ifetch_buffer_size", required_argument, 0, 'f'},
+            {"fetch_ahead", required_argument, 0, 'a'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'w':
+                warmup_instructions = atol(optarg);
+                break;
+            case 'i':
+                simulation_instructions = atol(optarg);
+                break;
+            case 'c':
+                knob_cloudsuite = true;
+                MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS_SPARC;
+                break;
+            case 'p':
+                pt = true;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 's':
+                artifact_store = optarg;
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            case 'f':
+                ifetch_buffer_size = atol(optarg);
+                break;
+            case 'a':
+                fetch_ahead = atol(optarg);
+                break;
+            default:
+                abort();
+        }
+    }
+
+    if (optind != argc - 1 || warmup_instructions + simulation_instructions == 0 ||
+        (Artifact::enabled() ? name.empty() : output.empty())) {
+        cerr << "Usage: " << argv[0] << " [-pt] [-cloudsuite] -warmup_instructions N -simulation_instructions N"
+             << " [-ifetch_buffer_size N] [-fetch_ahead N] (-output <btb_record> | -artifact_store <dir> -name <short name>) <trace>" << endl;
+        return 1;
+    }
+
+    // Same key as O3_CPU::btb_record_artifact
+    auto artifact = Artifact("btb_record_insert_taken", name, ".txt")
+            .with("producer", "opt_prepass")
+            .with("ifetch_buffer_size", ifetch_buffer_size)
+            .with("warmup_instructions", warmup_instructions)
+            .with("simulation_instructions", simulation_instructions);
+    if (artifact.current()) {
+        cout << "OPT record " << artifact.path() << " is up to date" << endl;
+        return 0;
+    }
+    output = artifact.write_path(output).string();
+
+    if (fetch_ahead < 0)
+        fetch_ahead = ifetch_buffer_size + DECODE_BUFFER_SIZE + DISPATCH_BUFFER_SIZE + ROB_SIZE + 2 * RETIRE_WIDTH;
+
+    // The trace readers rewind at the end of the trace, so the instruction count bounds the walk.
+    auto total_instructions = warmup_instructions + simulation_instructions + fetch_ahead;
+    tracereader *reader = get_tracereader(argv[optind], 0, knob_cloudsuite, pt);
+
+    FILE *btb_record = fopen(output.c_str(), "w");
+    assert(btb_record != nullptr);
+    OptAccessWriter writer;
+    writer.open(btb_record);
+
+    uint64_t timestamp = 0, recorded = 0;
+    std::unordered_map<uint64_t, uint64_t> access_count;
+    for (uint64_t i = 0; i < total_instructions; i++) {
+        auto arch_instr = reader->get();
+        if (!pt)
+            classify_branch(arch_instr);
+        if (!arch_instr.is_branch)
+            continue;
+        auto branch_type = arch_instr.branch_type;
+        if (branch_type == BRANCH_RETURN || branch_type == BRANCH_INDIRECT || branch_type == BRANCH_INDIRECT_CALL)
+            continue;
+        // Same condition as opt_btb_generate: misses insert taken branches with a target, hits record taken
+        if (arch_instr.branch_taken && arch_instr.branch_target != 0) {
+            writer.append(arch_instr.ip, timestamp);
+            access_count[arch_instr.ip]++;
+            recorded++;
+        }
+        timestamp++;
+    }
+    writer.close();
+    fclose(btb_record);
+    artifact.commit();
+
+    uint64_t single_use = 0;
+    for (auto &a : access_count) {
+        if (a.second == 1) single_use++;
+    }
+    cout << "Instructions: " << total_instructions << " (fetch ahead: " << fetch_ahead << ") BTB timestamps: " << timestamp
+         << " taken accesses: " << recorded << " branches: " << access_count.size()
+         << " never reused: " << single_use << endl;
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Check of opt_prepass against the OPT record of the simulator.
+ *
+ * This tool writes a random ChampSim trace (basic blocks ending in conditional branches and
+ * direct jumps, with loads to keep the ROB busy), runs a ChampSim_*_opt_generate simulator
+ * and opt_prepass on it with the same instruction counts, and compares the two records. The
+ * simulator reads the trace past the instructions it retires, so its record has to be a prefix
+ * of the opt_prepass one; it also has to be longer than a walk of exactly warmup + simulation
+ * instructions (-fetch_ahead 0), or the trace does not exercise the fetch-ahead window. It
+ * exits with 1 on the first mismatch and keeps the work directory then.
+ *
+ * Usage: opt_prepass_check -simulator <ChampSim_fdip_opt_generate> -prepass <opt_prepass>
+ *                          [-seed N] [-warmup_instructions N] [-simulation_instructions N]
+ */
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <zlib.h>
+
+#include "instruction.h"
+#include "../btb/opt_access_stream.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+namespace fs = boost::filesystem;
+
+const uint64_t NUM_BLOCKS = 2048;
+const uint64_t BLOCK_INSTRUCTIONS = 8;
+const uint64_t TRACE_INSTRUCTIONS = 400000;
+
+// Block k holds BLOCK_INSTRUCTIONS 4-byte instructions at block_ip(k), the last one a branch.
+uint64_t block_ip(uint64_t block) {
+    return 0x400000 + block * BLOCK_INSTRUCTIONS * 4;
+}
+
+bool write_trace(const string &path, uint64_t seed) {
+    gzFile out = gzopen(path.c_str(), "wb1");
+    if (out == nullptr) return false;
+    std::mt19937_64 rng(seed);
+    uint64_t block = 0;
+    for (uint64_t written = 0; written < TRACE_INSTRUCTIONS; written += BLOCK_INSTRUCTIONS) {
+        for (uint64_t i = 0; i + 1 < BLOCK_INSTRUCTIONS; i++) {
+            input_instr instr;
+            instr.ip = block_ip(block) + i * 4;
+            instr.destination_registers[0] = 1 + rng() % 8;
+            instr.source_registers[0] = 1 + rng() % 8;
+            if (rng() % 4 == 0)
+                instr.source_memory[0] = 0x10000000 + (rng() % (1 << 20)) * 64;
+            gzwrite(out, &instr, sizeof(instr));
+        }
+        input_instr branch;
+        branch.ip = block_ip(block) + (BLOCK_INSTRUCTIONS - 1) * 4;
+        branch.is_branch = 1;
+        branch.destination_registers[0] = REG_INSTRUCTION_POINTER;
+        branch.source_registers[0] = REG_INSTRUCTION_POINTER;
+        // Mostly short hops, so blocks are reused at all distances
+        auto target = (block + 1 + rng() % 64) % NUM_BLOCKS;
+        if (rng() % 4 == 0) {
+            branch.branch_taken = 1; // direct jump
+        } else {
+            branch.source_registers[1] = REG_FLAGS; // conditional branch
+            branch.branch_taken = rng() % 2;
+        }
+        gzwrite(out, &branch, sizeof(branch));
+        block = branch.branch_taken ? target : (block + 1) % NUM_BLOCKS;
+    }
+    return gzclose(out) == Z_OK;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> read_record(const fs::path &path) {
+    std::vector<std::pair<uint64_t, uint64_t>> accesses;
+    FILE *in = fopen(path.c_str(), "r");
+    if (in == nullptr) return accesses;
+    OptAccessReader::for_each(in, [&](uint64_t ip, uint64_t timestamp) {
+        accesses.emplace_back(ip, timestamp);
+    });
+    fclose(in);
+    return accesses;
+}
+
+// Runs command in directory with its output in log; the exit status is not checked, the
+// caller checks the record the command writes.
+void run(const fs::path &directory, const string &command, const string &log) {
+    auto line = "cd '" + directory.string() + "' && " + command + " > " + log + " 2>&1";
+    if (system(line.c_str()) != 0)
+        cout << "Note: " << command << " exited with an error, see " << (directory / log).string() << endl;
+}
+
+int main(int argc, char **argv) {
+    uint64_t seed = 1, warmup_instructions = 20000, simulation_instructions = 200000;
+    string simulator, prepass;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"simulator", required_argument, 0, 'm'},
+            {"prepass", required_argument, 0, 'p'},
+            {"seed", required_argument, 0, 's'},
+            {"warmup_instructions", required_argument, 0, 'w'},
+            {"simulation_instructions", required_argument, 0, 'i'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'm':
+                simulator = optarg;
+                break;
+            case 'p':
+                prepass = optarg;
+                break;
+            case 's':
+                seed = atol(optarg);
+                break;
+            case 'w':
+                warmup_instructions = atol(optarg);
+                break;
+            case 'i':
+                simulation_instructions = atol(optarg);
+                break;
+            default:
+                abort();
+        }
+    }
+    if (simulator.empty() || prepass.empty()) {
+        cerr << "Usage: " << argv[0] << " -simulator <ChampSim_*_opt_generate> -prepass <opt_prepass>"
+             << " [-seed N] [-warmup_instructions N] [-simulation_instructions N]" << endl;
+        return 1;
+    }
+
+    auto directory = fs::temp_directory_path() / fs::unique_path("opt_prepass_check-%%%%%%%%");
+    fs::create_directories(directory);
+    auto trace = directory / "check.champsimtrace.gz";
+    if (!write_trace(trace.string(), seed)) {
+        cerr << "Cannot write " << trace.string() << endl;
+        return 1;
+    }
+
+    auto counts = " -warmup_instructions " + std::to_string(warmup_instructions) +
+                  " -simulation_instructions " + std::to_string(simulation_instructions);
+    run(directory, "'" + simulator + "' -artifact_store store" + counts + " -traces " + trace.string(),
+        "simulator.log");
+    run(directory, "'" + prepass + "'" + counts + " -output prepass.txt " + trace.string(), "prepass.log");
+    run(directory, "'" + prepass + "'" + counts + " -fetch_ahead 0 -output exact.txt " + trace.string(),
+        "exact.log");
+
+    fs::path simulator_record;
+    auto record_directory = directory / "store" / "btb_record_insert_taken";
+    if (fs::is_directory(record_directory)) {
+        for (auto &entry : fs::directory_iterator(record_directory)) {
+            if (entry.path().extension() == ".txt")
+                simulator_record = entry.path();
+        }
+    }
+    if (simulator_record.empty()) {
+        cerr << "The simulator did not commit an OPT record in " << record_directory.string() << endl;
+        return 1;
+    }
+
+    auto expected = read_record(simulator_record);
+    auto actual = read_record(directory / "prepass.txt");
+    auto exact = read_record(directory / "exact.txt");
+    cout << "OPT record accesses: simulator " << expected.size() << ", opt_prepass " << actual.size()
+         << ", without fetch ahead " << exact.size() << endl;
+    if (expected.empty() || actual.size() < expected.size()) {
+        cerr << "opt_prepass record does not cover the simulator record, see " << directory.string() << endl;
+        return 1;
+    }
+    for (uint64_t i = 0; i < expected.size(); i++) {
+        if (expected[i] != actual[i]) {
+            cerr << "Access " << i << ": simulator ip " << std::hex << expected[i].first << std::dec << " at "
+                 << expected[i].second << ", opt_prepass ip " << std::hex << actual[i].first << std::dec
+                 << " at " << actual[i].second << ", see " << directory.string() << endl;
+            return 1;
+        }
+    }
+    if (exact.size() >= expected.size()) {
+        cerr << "The simulator did not read past warmup + simulation instructions, see "
+             << directory.string() << endl;
+        return 1;
+    }
+
+    fs::remove_all(directory);
+    cout << "opt_prepass record matches the simulator record and covers its "
+         << expected.size() - exact.size() << " fetched-ahead accesses" << endl;
+    return 0;
+}
@@ -1,4 +1,5 @@
 import enum
+import gzip
 import math
 import statistics
 from pathlib import Path
@@ -40,6 +41,36 @@ class RecordType(enum.Enum):
     evict = 3
 
 
+class RunLengthRecord:
+    """Reads a run-length access record (*.rle.csv.gz) line by line in the full format."""
+
+    def __init__(self, input_path: Path):
+        self.input_file = gzip.open(str(input_path), mode="rt")
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.input_file.close()
+
+    def readline(self):
+        line = self.input_file.readline()
+        if not line or "*" not in line:
+            return line
+        words = line.rstrip().split(",")
+        expanded = words[:3]
+        for word in words[3:]:
+            record, _, length = word.partition("*")
+            expanded.extend([record] * int(length or 1))
+        return ",".join(expanded) + "\n"
+
+
+def open_access_record(input_path: Path):
+    if input_path.name.endswith(".rle.csv.gz"):
+        return RunLengthRecord(input_path)
+    return input_path.open(mode="r")
+
+
 class HWCType(enum.Enum):
     cold = 0
     warm = 1
@@ -120,7 +151,7 @@ def plot_hit_access_misclassify(
     all_warm_misclassify_hot = []
     all_hot_misclassify_warm = []
     all_warm_misclassify_cold = []
-    with input_path.open(mode="r") as input_file:
+    with open_access_record(input_path) as input_file:
         if not input_file:
             print("cannot open")
             return
@@ -192,7 +223,7 @@ def plot_hit_access_variance(input_path: Path, output_dir: Path):
     print(trace)
     all_variance = []
     zero_count = 0
-    with input_path.open(mode="r") as input_file:
+    with open_access_record(input_path) as input_file:
         if not input_file:
             print("cannot open")
             return
@@ -240,7 +271,7 @@ def dynamic_execution_cdf(input_path: Path, special_cdf: list, csv_output):
     print(trace)
     total_access_count = 0
     all_set = []
-    with input_path.open(mode="r") as input_file:
+    with open_access_record(input_path) as input_file:
         if not input_file:
             print("cannot open")
             return
@@ -322,7 +353,7 @@ def cal_correlation(input_path: Path, csv_output):
         "miss with insertion / all miss": [],
         "num of consecutive hits": [],
     }
-    with input_path.open(mode="r") as input_file:
+    with open_access_record(input_path) as input_file:
         if not input_file:
             print("cannot open")
             return
@@ -374,7 +405,7 @@ def plot_hit_miss_hist(input_path: Path, output_dir: Path):
     trace = filename.split(".")[0]
     print(trace)
     all_set = []
-    with input_path.open(mode="r") as input_file:
+    with open_access_record(input_path) as input_file:
         if not input_file:
             print("cannot open")
             return
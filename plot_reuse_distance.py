@@ -6,6 +6,8 @@ import numpy as np
 from matplotlib import colors
 from matplotlib.ticker import PercentFormatter
 
+from plots.scripts.utils import reuse_distances
+
 reuse_distance_dirname = "/mnt/storage/shixins/champsim_pt/reuse_distance_taken/"
 result_dir = "/mnt/storage/shixins/champsim_pt/reuse_distance_friendly_plot"
 
@@ -81,10 +83,10 @@ def plot_friendly_unfriendly(data: list, title: str, output_dir: str):
 def count(vec: list, bin_num: int):
     result = [0] * (bin_num + 1)
     for s in vec:
-        if int(s, 16) == 0:
+        if s == 0:
             result[0] += 1
             continue
-        length = int(math.log(int(s, 16), 4))
+        length = int(math.log(s, 4))
         if length >= bin_num:
             result[bin_num] += 1
         else:
@@ -110,7 +112,7 @@ def branch_type_classify(trace: str, num_bins: int):
                 break
             all_words = line.split(",")
             # TODO: Add count according to branch_type
-            line_count = count(all_words[4:], num_bins)
+            line_count = count(reuse_distances(all_words[4:]), num_bins)
             for i, num in enumerate(line_count):
                 counts[all_words[2]][i].append(num)
     for key, value in counts.items():
@@ -165,7 +167,7 @@ def branch_target_classify(trace: str, num_bins: int):
             ip = int(all_words[0], 16)
             target = int(all_words[1], 16)
             distance = ip - target if ip >= target else target - ip
-            line_count = count(all_words[4:], num_bins)
+            line_count = count(reuse_distances(all_words[4:]), num_bins)
             for i, num in enumerate(line_count):
                 if distance < 2 ** 14:
                     counts[0][i].append(num)
@@ -187,7 +189,7 @@ def no_classify(trace: str, num_bins: int):
             line = file.readline().rstrip()
             if not line:
                 break
-            words = line.split(",")[4:]
+            words = reuse_distances(line.split(",")[4:])
             line_count = count(words, num_bins)
             for i, num in enumerate(line_count):
                 counts[i].append(num)
@@ -199,8 +201,7 @@ def friendly_range_percentage(distances: list, num_ways: int):
     last_is_zero = False
     friendly_num = 0
     unfriendly_num = 0
-    for distance in distances:
-        dist = int(distance, 16)
+    for dist in distances:
         if dist == 0:
             friendly_num += 0 if last_is_zero else 1
             last_is_zero = True
@@ -216,8 +217,7 @@ def friendly_range_percentage(distances: list, num_ways: int):
 def friendly_single_percentage(distances: list, num_ways: int):
     friendly_num = 0
     unfriendly_num = 0
-    for distance in distances:
-        dist = int(distance, 16)
+    for dist in distances:
         if dist < num_ways:
             friendly_num += 1
         else:
@@ -274,9 +274,9 @@ def plot_friendly_histogram(
             #         unfriendly_count += 1
             # friendly_percentage = float(friendly_count) / (float(friendly_count) + float(unfriendly_count))
             if range_count:
-                friendly_percentage = friendly_range_percentage(words[4:], num_ways)
+                friendly_percentage = friendly_range_percentage(reuse_distances(words[4:]), num_ways)
             else:
-                friendly_percentage = friendly_single_percentage(words[4:], num_ways)
+                friendly_percentage = friendly_single_percentage(reuse_distances(words[4:]), num_ways)
             judge = []
             for standard in judge_friendly:
                 if friendly_percentage > standard:
@@ -375,9 +375,9 @@ def plot_detailed_friendly_histogram(
             #         unfriendly_count += 1
             # friendly_percentage = float(friendly_count) / (float(friendly_count) + float(unfriendly_count))
             if range_count:
-                friendly_percentage = friendly_range_percentage(words[4:], num_ways)
+                friendly_percentage = friendly_range_percentage(reuse_distances(words[4:]), num_ways)
             else:
-                friendly_percentage = friendly_single_percentage(words[4:], num_ways)
+                friendly_percentage = friendly_single_percentage(reuse_distances(words[4:]), num_ways)
             judge = []
             for standard in judge_friendly:
                 if friendly_percentage > standard:
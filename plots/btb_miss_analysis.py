@@ -9,10 +9,14 @@ from pathlib import Path
 # echo "BTB-Lookup: 1 0 CF_CALL 140299761704680 140299761717344 1\nBTB-Update: 1 0 CF_CALL 140299761704681 140299761717344 1" | awk '/BTB-Lookup:/{printf("r %d 1\n",$5);}'
 
 
+# The twig record is a binary log (inc/twig_log.h); twig_profile -dump prints it as the text lines above.
+twig_profile_path = Path(__file__).resolve().parent.parent / "cmake-build-release" / "twig_profile"
+
+
 def parse_one_file(input_path: Path, output_path: Path, binary_path: Path, btb_size: int):
     awk_command = """awk '/BTB-Lookup:/{printf("r %d 1\\n",$5);}'"""
     dineroIV_command = f"{binary_path} -l1-dbsize 1 -l1-dsize {btb_size} -l1-dassoc 4 -l1-drepl l -l1-dccc -informat D"
-    cmd = f"""zcat {input_path} | {awk_command} | {dineroIV_command}"""
+    cmd = f"""{twig_profile_path} -dump {input_path} | {awk_command} | {dineroIV_command}"""
     # print(cmd)
     p = subprocess.Popen(cmd, shell=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     stdout, stderr = p.communicate()
@@ -18,7 +18,7 @@ from typing import Callable
 import scipy.stats as ss
 
 import plot_functions
-from .utils import scripts_dir, plots_dir, project_dir, pt_traces
+from .utils import scripts_dir, plots_dir, project_dir, pt_traces, reuse_distances
 
 
 def read_one_file(
@@ -40,7 +40,7 @@ def cal_average_variance(line: pd.Series) -> pd.Series:
     row = line[0].split(",")
     pc = row[0]
     # First entry of reuse distance is always 0, which should not be considered.
-    data = np.array(list(map(lambda x: int(x, 16), row[5:])), dtype=int)
+    data = np.array(reuse_distances(row[4:])[1:], dtype=int)
     mean = np.mean(data)
     return pd.Series([pc, mean], index=["PC", "ReuseMean"])
 
@@ -23,7 +23,7 @@ from dataclasses import dataclass
 from matplotlib.patches import Ellipse
 
 import plot_functions
-from .utils import scripts_dir, plots_dir, project_dir, pt_traces
+from .utils import scripts_dir, plots_dir, project_dir, pt_traces, reuse_distances
 
 
 rc("font", **{"size": "23", "family": "serif", "serif": ["Palatino"]})
@@ -45,7 +45,7 @@ def cal_average_variance(line: pd.Series) -> pd.Series:
     row = line[0].split(",")
     pc = row[0]
     # First entry of reuse distance is always 0, which should not be considered.
-    data = np.array(list(map(lambda x: int(x, 16), row[5:])), dtype=int)
+    data = np.array(reuse_distances(row[4:])[1:], dtype=int)
     mean = np.mean(data)
     variance = np.var(data)
     return pd.Series([pc, mean, variance], index=["PC", "Mean", "Variance"])
@@ -54,7 +54,7 @@ def cal_average_variance(line: pd.Series) -> pd.Series:
 def cal_difference_average_variance(line: pd.Series) -> pd.Series:
     row = line[0].split(",")
     pc = row[0]
-    data = np.array(list(map(lambda x: int(x, 16), row[5:])), dtype=int)
+    data = np.array(reuse_distances(row[4:])[1:], dtype=int)
     difference = np.diff(data)
     mean = np.mean(data)
     variance = 0 if len(difference) == 0 else sum(difference ** 2) / len(difference)
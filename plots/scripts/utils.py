@@ -19,3 +19,13 @@ pt_traces = [
     "verilator",
     "wordpress",
 ]
+
+
+def reuse_distances(fields: list) -> list:
+    # Reuse distance record fields (hex) in access order; "distance*count" is a run of count
+    # equal distances.
+    distances = []
+    for field in fields:
+        distance, _, count = field.partition("*")
+        distances.extend([int(distance, 16)] * (int(count, 16) if count else 1))
+    return distances
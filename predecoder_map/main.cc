@@ -0,0 +1,125 @@
+/*
+ * Predecoder branch map generator.
+ *
+ * A predecoder finds the branches of a line and their direct targets by decoding the line,
+ * which a trace-driven model cannot do for lines it has not fetched yet. This tool walks the
+ * trace with the same reader as the simulator and writes every branch it sees as one
+ * "ip target branch_type" line (ip and target in hex), the static map -predecoder_branch_map
+ * reads (inc/predecoder.h). The target of a branch is its last taken target, 0 if it was
+ * never taken; such branches are in the map but the predecoder does not prefetch them.
+ *
+ * Usage: predecoder_map [-pt] [-cloudsuite] -warmup_instructions N -simulation_instructions N
+ *                       -output <map> <trace>
+ */
+
+#include <getopt.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tracereader.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+uint8_t MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS;
+
+struct MappedBranch {
+    uint64_t target = 0;
+    uint8_t branch_type = NOT_BRANCH;
+};
+
+int main(int argc, char **argv) {
+    uint64_t warmup_instructions = 0, simulation_instructions = 0;
+    bool knob_cloudsuite = false, pt = false;
+    string output;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"warmup_instructions", required_argument, 0, 'w'},
+            {"simulation_instructions", required_argument, 0, 'i'},
+            {"cloudsuite", no_argument, 0, 'c'},
+            {"pt", no_argument, 0, 'p'},
+            {"output", required_argument, 0, 'o'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'w':
+                warmup_instructions = atol(optarg);
+                break;
+            case 'i':
+                simulation_instructions = atol(optarg);
+                break;
+            case 'c':
+                knob_cloudsuite = true;
+                MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS_SPARC;
+                break;
+            case 'p':
+                pt = true;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                abort();
+        }
+    }
+
+    if (optind != argc - 1 || output.empty() || warmup_instructions + simulation_instructions == 0) {
+        cerr << "Usage: " << argv[0] << " [-pt] [-cloudsuite] -warmup_instructions N"
+             << " -simulation_instructions N -output <map> <trace>" << endl;
+        return 1;
+    }
+
+    // The trace readers rewind at the end of the trace, so the instruction count bounds the walk.
+    auto total_instructions = warmup_instructions + simulation_instructions;
+    tracereader *reader = get_tracereader(argv[optind], 0, knob_cloudsuite, pt);
+
+    std::unordered_map<uint64_t, MappedBranch> branches;
+    for (uint64_t i = 0; i < total_instructions; i++) {
+        auto arch_instr = reader->get();
+        if (!pt)
+            classify_branch(arch_instr);
+        if (!arch_instr.is_branch)
+            continue;
+        auto &branch = branches[arch_instr.ip];
+        branch.branch_type = arch_instr.branch_type;
+        if (arch_instr.branch_taken && arch_instr.branch_target != 0)
+            branch.target = arch_instr.branch_target;
+    }
+
+    std::vector<uint64_t> ips;
+    for (auto &branch : branches) ips.push_back(branch.first);
+    std::sort(ips.begin(), ips.end());
+    FILE *out = fopen(output.c_str(), "w");
+    if (out == nullptr) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    uint64_t with_target = 0;
+    for (auto ip : ips) {
+        auto &branch = branches[ip];
+        fprintf(out, "%" PRIx64 " %" PRIx64 " %d\n", ip, branch.target, branch.branch_type);
+        with_target += branch.target != 0;
+    }
+    fclose(out);
+
+    cout << "Instructions: " << total_instructions << " branches: " << ips.size()
+         << " with a target: " << with_target << endl;
+    return 0;
+}
@@ -0,0 +1,148 @@
+#ifndef CHAMPSIM_PT_BRANCH_RECORD_H
+#define CHAMPSIM_PT_BRANCH_RECORD_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern uint64_t fdip_branch_record_entries;
+extern uint32_t fdip_branch_record_ways;
+extern std::string fdip_branch_record_policy;
+
+/*
+ * The FDIP runahead's view of the branches it has seen: the Instr of a branch, written when
+ * the branch is predicted and read whenever the runahead or a predecoder reaches its ip.
+ *
+ * It is a set-associative table of -fdip_branch_record_entries entries and
+ * -fdip_branch_record_ways ways, indexed by ip with full tags, so the runahead only knows
+ * the branches a BTB-sized shadow structure would hold. -fdip_branch_record_policy picks
+ * the victim of a fill:
+ *   - lru: least recently written or found
+ *   - fifo: least recently filled
+ *   - random: a pseudo-random way, the same sequence in every run
+ * Invalid ways are filled first under every policy.
+ */
+template <typename Instr>
+class BranchRecord {
+public:
+    enum class Policy {
+        LRU,
+        FIFO,
+        RANDOM
+    };
+
+private:
+    struct Entry {
+        uint64_t ip = 0;
+        uint64_t stamp = 0; // last use for LRU, fill for FIFO
+        bool valid = false;
+        Instr instr;
+    };
+
+    uint64_t sets = 0;
+    uint32_t ways = 0;
+    Policy policy = Policy::LRU;
+    std::vector<Entry> table;
+    uint64_t clock = 0;
+    uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t writes = 0;
+    uint64_t fills = 0;
+    uint64_t evictions = 0;
+
+    Entry *set_begin(uint64_t ip) {
+        return table.data() + ((ip >> 2) % sets) * ways;
+    }
+
+    Entry *find_entry(uint64_t ip) {
+        auto begin = set_begin(ip);
+        for (uint32_t way = 0; way < ways; way++) {
+            if (begin[way].valid && begin[way].ip == ip) return begin + way;
+        }
+        return nullptr;
+    }
+
+    Entry *victim(uint64_t ip) {
+        auto begin = set_begin(ip);
+        auto end = begin + ways;
+        auto invalid = std::find_if(begin, end, [](const Entry &e) { return !e.valid; });
+        if (invalid != end) return invalid;
+        evictions++;
+        if (policy == Policy::RANDOM) {
+            // xorshift64
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            return begin + random_state % ways;
+        }
+        return std::min_element(begin, end, [](const Entry &a, const Entry &b) { return a.stamp < b.stamp; });
+    }
+
+public:
+    static bool parse_policy(const std::string &name, Policy &parsed) {
+        if (name == "lru") {
+            parsed = Policy::LRU;
+        } else if (name == "fifo") {
+            parsed = Policy::FIFO;
+        } else if (name == "random") {
+            parsed = Policy::RANDOM;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void init(uint64_t entries, uint32_t table_ways, const std::string &policy_name) {
+        assert(entries > 0);
+        bool parsed = parse_policy(policy_name, policy);
+        assert(parsed);
+        (void) parsed;
+        ways = (uint32_t) std::min<uint64_t>(std::max<uint32_t>(table_ways, 1), entries);
+        sets = entries / ways;
+        table.assign(sets * ways, Entry());
+        std::cout << "FDIP branch record entries: " << table.size() << " sets: " << sets << " ways: " << ways
+                  << " policy: " << policy_name << std::endl;
+    }
+
+    // The Instr of ip, or nullptr if the record does not hold ip.
+    Instr *find(uint64_t ip) {
+        lookups++;
+        auto entry = find_entry(ip);
+        if (entry == nullptr) return nullptr;
+        hits++;
+        if (policy == Policy::LRU) entry->stamp = ++clock;
+        return &entry->instr;
+    }
+
+    void insert(uint64_t ip, const Instr &instr) {
+        writes++;
+        auto entry = find_entry(ip);
+        if (entry == nullptr) {
+            entry = victim(ip);
+            entry->ip = ip;
+            entry->valid = true;
+            entry->stamp = ++clock;
+            fills++;
+        } else if (policy == Policy::LRU) {
+            entry->stamp = ++clock;
+        }
+        entry->instr = instr;
+    }
+
+    void print_final_stats() const {
+        std::cout << "FDIP branch record lookups: " << lookups
+                  << " hits: " << hits
+                  << " misses: " << lookups - hits
+                  << " hit rate: " << (lookups ? (double) hits / (double) lookups : 0.0)
+                  << " writes: " << writes
+                  << " fills: " << fills
+                  << " evictions: " << evictions << std::endl;
+    }
+};
+
+#endif //CHAMPSIM_PT_BRANCH_RECORD_H
@@ -6,6 +6,7 @@
 #define CHAMPSIM_PT_FDIP_H
 
 #include "ooo_cpu.h"
+#include "branch_record.h"
 #include <deque>
 #include <unordered_map>
 #include <utility>
@@ -52,7 +53,7 @@ public:
 
     ~FDIP() = default;
 
-    unordered_map<uint64_t, Instr> branch_record;
+    BranchRecord<Instr> branch_record;
 
     // Only store predicted target and instr_id
     deque<pair<uint64_t, uint64_t>> FTQ;
@@ -65,14 +66,15 @@ public:
     void initialize(uint32_t cpu) {
         cout << "IFETCH_BUFFER_SIZE = " << IFETCH_BUFFER_SIZE << endl;
         cout << "CPU " << cpu << " L1I FDIP prefetcher" << endl;
+        branch_record.init(fdip_branch_record_entries, fdip_branch_record_ways, fdip_branch_record_policy);
     }
 
     void branch_operate(uint64_t ip, uint8_t branch_type, uint64_t predicted_branch_target,
                         bool predicted_branch_taken, bool always_taken,
                         uint64_t real_branch_target) {
-        branch_record[ip] = Instr(branch_type, predicted_branch_target,
-                                  predicted_branch_taken, always_taken,
-                                  real_branch_target);
+        branch_record.insert(ip, Instr(branch_type, predicted_branch_target,
+                                       predicted_branch_taken, always_taken,
+                                       real_branch_target));
     }
 
     void cycle_operate(O3_CPU *ooo_cpu, bool pt) {
@@ -89,26 +91,26 @@ public:
             if (!find_larger) return;
             // Go ahead for prediction and prefetch
             auto it = branch_record.find(runahead_ip);
-            if (it != branch_record.end()) {
+            if (it != nullptr) {
                 // Is a branch
-                if (it->second.btb_miss) {
+                if (it->btb_miss) {
                     // BTB miss
                     // TODO: Check whether the way to judge BTB miss is wrong!
-                } else if (it->second.predict_taken) {
+                } else if (it->predict_taken) {
                     // TODO: Find out the reason why the assert is failed.
-                    if (it->second.predict_target == 0) {
-                        cout << "Branch type " << (int) it->second.branch_type << endl;
-                        cout << "Real target: " << it->second.actual_target << " Taken: " << (int) it->second.actual_taken << endl;
+                    if (it->predict_target == 0) {
+                        cout << "Branch type " << (int) it->branch_type << endl;
+                        cout << "Real target: " << it->actual_target << " Taken: " << (int) it->actual_taken << endl;
                     }
-                    assert(it->second.predict_target != 0);
+                    assert(it->predict_target != 0);
                     // Prefetch target
-                    if (!ooo_cpu->prefetch_code_line(it->second.predict_target)) {
+                    if (!ooo_cpu->prefetch_code_line(it->predict_target)) {
                         // Prefetch queue is full
                         return;
                     }
                     prefetch++;
                     FTQ.emplace_back(runahead_ip, runahead_instr_unique_id);
-                    runahead_ip = it->second.predict_target;
+                    runahead_ip = it->predict_target;
                     runahead_instr_unique_id++;
                     // Taken! So directly return
                     return;
@@ -127,7 +129,7 @@ public:
                 }
                 prefetch++;
             }
-            if (it != branch_record.end()) {
+            if (it != nullptr) {
                 FTQ.emplace_back(runahead_ip, runahead_instr_unique_id);
             }
             runahead_ip += offset;
@@ -137,6 +139,7 @@ public:
 
     void final_stats(uint32_t cpu) {
         cout << "CPU " << cpu << " L1I FDIP final stats" << endl;
+        branch_record.print_final_stats();
     }
 
     void reset_ftq(ooo_model_instr &instr, bool pt) {
@@ -1,35 +1,21 @@
 #include "ooo_cpu.h"
+#include "../branch_record.h"
+#include "../fetch_target_queue.h"
 #include <deque>
 #include <unordered_map>
 #include <utility>
-#include <unordered_set>
 
 using std::cout;
 using std::endl;
 using std::deque;
 using std::unordered_map;
 using std::pair;
-using std::unordered_set;
 
 extern uint8_t predecode_latency;
+extern uint64_t predecode_bandwidth;
 extern uint8_t pt;
 
 
-struct predecode_entry {
-    uint64_t ip;
-    uint64_t target;
-    uint8_t branch_type;
-    uint8_t timer;
-    bool taken;
-
-    predecode_entry(uint64_t ip, uint64_t target, uint8_t branch_type, bool taken) :
-            ip(ip),
-            target(target),
-            branch_type(branch_type),
-            timer(0),
-            taken(taken) {}
-};
-
 struct Instr {
     uint64_t actual_target = 0;
     uint64_t predict_target = 0;
@@ -64,13 +50,13 @@ public:
 
     ~FDIP() = default;
 
-    unordered_map<uint64_t, Instr> branch_record;
+    BranchRecord<Instr> branch_record;
 
     // Only store predicted target and instr_id
-    deque<pair<uint64_t, uint64_t>> FTQ;
+    FetchTargetQueue FTQ;
 
     // Branches wait to be decoded
-    deque<predecode_entry> decode_queue;
+    PredecodeQueue decode_queue;
 
     // Structure to maintain bitmap
     unordered_map<uint64_t, vector<uint64_t>> footprint;
@@ -85,6 +71,10 @@ FDIP fdip_prefetcher;
 
 void O3_CPU::l1i_prefetcher_initialize() {
     cout << "CPU " << cpu << " L1I FDIP" << endl;
+    fdip_prefetcher.branch_record.init(fdip_branch_record_entries, fdip_branch_record_ways,
+                                       fdip_branch_record_policy);
+    fdip_prefetcher.decode_queue.latency = predecode_latency;
+    fdip_prefetcher.decode_queue.bandwidth = predecode_bandwidth;
 }
 
 void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t predicted_branch_target,
@@ -92,9 +82,9 @@ void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uin
                                            uint64_t real_branch_target) {
     // TODO: Add branch instructions to the record map
     // What should we do when meet a branch for the second time, and instr info changed?
-    fdip_prefetcher.branch_record[ip] = Instr(branch_type, predicted_branch_target,
-                                              predicted_branch_taken, always_taken,
-                                              real_branch_target);
+    fdip_prefetcher.branch_record.insert(ip, Instr(branch_type, predicted_branch_target,
+                                                   predicted_branch_taken, always_taken,
+                                                   real_branch_target));
 }
 
 void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit) {
@@ -105,21 +95,22 @@ void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, ui
         fdip_prefetcher.footprint.emplace_hint(it, block_addr, vector<uint64_t>());
         it = fdip_prefetcher.footprint.find(block_addr);
     }
-    if (fdip_prefetcher.branch_record.find(v_addr) != fdip_prefetcher.branch_record.end())
+    if (fdip_prefetcher.branch_record.find(v_addr) != nullptr)
         it->second.push_back(v_addr);
     if (!cache_hit) {
-        unordered_set<uint64_t> prefetch_set;
+        // Every ip of the footprint lies in the block, so one bit per byte offset dedups them
+        uint64_t prefetched = 0;
         // the 3 here is because of size limit of airbtb, not sure whether it's the reason of relative poor performance
         for (uint64_t i = 0; !it->second.empty(); i++) {
             auto ip = it->second.back();
             it->second.pop_back();
-            if (prefetch_set.find(ip) == prefetch_set.end()) {
+            uint64_t bit = 1ULL << (ip & (BLOCK_SIZE - 1));
+            if (!(prefetched & bit)) {
                 auto instr = fdip_prefetcher.branch_record.find(ip);
-                if (instr != fdip_prefetcher.branch_record.end()) {
-                    fdip_prefetcher.decode_queue.emplace_back(ip, instr->second.actual_target,
-                                                              instr->second.branch_type, instr->second.actual_taken);
+                if (instr != nullptr) {
+                    fdip_prefetcher.decode_queue.push({ip, instr->actual_target, instr->branch_type, instr->actual_taken});
                 }
-                prefetch_set.insert(ip);
+                prefetched |= bit;
             }
         }
         it->second.clear();
@@ -136,39 +127,30 @@ void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, ui
 
 void O3_CPU::l1i_prefetcher_cycle_operate() {
     // Handle predecode and btb prefetch
-    for (auto &a : fdip_prefetcher.decode_queue)
-        a.timer++;
-    while (!fdip_prefetcher.decode_queue.empty() && fdip_prefetcher.decode_queue.front().timer > predecode_latency) {
-        auto &a = fdip_prefetcher.decode_queue.front();
+    fdip_prefetcher.decode_queue.operate([this](const PredecodedBranch &a) {
         prefetch_btb(a.ip, a.target, a.branch_type, a.taken, true);
-        fdip_prefetcher.decode_queue.pop_front();
-    }
+    });
     // Carry out prefetch and push to FTQ if allowed
     int num_prefetches = 12;
     int prefetch = 0;
     while (prefetch < L1I_PQ_SIZE && prefetch < num_prefetches) {
-        // Judge whether runahead_instr_unique_id is in the range of IFETCH_BUFFER
-        bool find_larger = false;
-        for (auto & it : IFETCH_BUFFER) {
-            if (it.instr_id >= fdip_prefetcher.runahead_instr_unique_id)
-                find_larger = true;
-        }
-        if (!find_larger) return;
+        // Judge whether runahead_instr_unique_id is in the range of IFETCH_BUFFER (filled in instr_id order)
+        if (IFETCH_BUFFER.empty() || IFETCH_BUFFER.back().instr_id < fdip_prefetcher.runahead_instr_unique_id) return;
         // Go ahead for prediction and prefetch
         auto it = fdip_prefetcher.branch_record.find(fdip_prefetcher.runahead_ip);
-        if (it != fdip_prefetcher.branch_record.end()) {
+        if (it != nullptr) {
             // Is a branch
-            if (it->second.btb_miss) {
+            if (it->btb_miss) {
                 // BTB miss
-            } else if (it->second.predict_taken) {
+            } else if (it->predict_taken) {
                 // Prefetch target
-                if (!prefetch_code_line(it->second.predict_target)) {
+                if (!prefetch_code_line(it->predict_target)) {
                     // Prefetch queue is full
                     return;
                 }
                 prefetch++;
                 fdip_prefetcher.FTQ.emplace_back(fdip_prefetcher.runahead_ip, fdip_prefetcher.runahead_instr_unique_id);
-                fdip_prefetcher.runahead_ip = it->second.predict_target;
+                fdip_prefetcher.runahead_ip = it->predict_target;
                 fdip_prefetcher.runahead_instr_unique_id++;
                 // Taken! So directly return
                 return;
@@ -184,7 +166,7 @@ void O3_CPU::l1i_prefetcher_cycle_operate() {
             }
             prefetch++;
         }
-        if (it != fdip_prefetcher.branch_record.end()) {
+        if (it != nullptr) {
             fdip_prefetcher.FTQ.emplace_back(fdip_prefetcher.runahead_ip, fdip_prefetcher.runahead_instr_unique_id);
         }
         fdip_prefetcher.runahead_ip += offset;
@@ -199,6 +181,7 @@ void O3_CPU::l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t w
 
 void O3_CPU::l1i_prefetcher_final_stats() {
     cout << "CPU " << cpu << " L1I FDIP final stats" << endl;
+    fdip_prefetcher.branch_record.print_final_stats();
 }
 
 void reset_ftq(ooo_model_instr &instr) {
@@ -215,10 +198,8 @@ void reset_ftq(ooo_model_instr &instr) {
 void O3_CPU::l1i_prefetcher_resolved_branch_operate(ooo_model_instr &instr, bool decode_stage) {
     if (decode_stage) {
         // Only BRANCH_DIRECT_JUMP and BRANCH_DIRECT_CALL
-        auto it = std::find(fdip_prefetcher.FTQ.begin(), fdip_prefetcher.FTQ.end(), std::make_pair(instr.ip, instr.instr_id));
-        if (it != fdip_prefetcher.FTQ.end()) {
+        if (fdip_prefetcher.FTQ.erase_from(instr.ip, instr.instr_id)) {
             instr.pfc_finished = true;
-            fdip_prefetcher.FTQ.erase(it, fdip_prefetcher.FTQ.end());
             reset_ftq(instr);
         }
         return;
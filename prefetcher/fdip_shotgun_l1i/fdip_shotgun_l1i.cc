@@ -1,4 +1,6 @@
 #include "ooo_cpu.h"
+#include "../branch_record.h"
+#include "../fetch_target_queue.h"
 #include <deque>
 #include <unordered_map>
 #include <utility>
@@ -10,24 +12,10 @@ using std::unordered_map;
 using std::pair;
 
 extern uint8_t predecode_latency;
+extern uint64_t predecode_bandwidth;
 extern uint8_t pt;
 
 
-struct predecode_entry {
-    uint64_t ip;
-    uint64_t target;
-    uint8_t branch_type;
-    uint8_t timer;
-    bool taken;
-
-    predecode_entry(uint64_t ip, uint64_t target, uint8_t branch_type, bool taken) :
-            ip(ip),
-            target(target),
-            branch_type(branch_type),
-            timer(0),
-            taken(taken) {}
-};
-
 struct Instr {
     uint64_t actual_target = 0;
     uint64_t predict_target = 0;
@@ -62,13 +50,13 @@ public:
 
     ~FDIP() = default;
 
-    unordered_map<uint64_t, Instr> branch_record;
+    BranchRecord<Instr> branch_record;
 
     // Only store predicted target and instr_id
-    deque<pair<uint64_t, uint64_t>> FTQ;
+    FetchTargetQueue FTQ;
 
     // Branches wait to be decoded
-    deque<predecode_entry> decode_queue;
+    PredecodeQueue decode_queue;
 
     // Instrs wait to be prefetched (especially for those prefetched by shotgun)
     deque<uint64_t> prefetch_queue;
@@ -85,6 +73,10 @@ FDIP fdip_prefetcher;
 
 void O3_CPU::l1i_prefetcher_initialize() {
     cout << "CPU " << cpu << " L1I FDIP" << endl;
+    fdip_prefetcher.branch_record.init(fdip_branch_record_entries, fdip_branch_record_ways,
+                                       fdip_branch_record_policy);
+    fdip_prefetcher.decode_queue.latency = predecode_latency;
+    fdip_prefetcher.decode_queue.bandwidth = predecode_bandwidth;
 }
 
 void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uint64_t predicted_branch_target,
@@ -92,35 +84,34 @@ void O3_CPU::l1i_prefetcher_branch_operate(uint64_t ip, uint8_t branch_type, uin
                                            uint64_t real_branch_target) {
     // TODO: Add branch instructions to the record map
     // What should we do when meet a branch for the second time, and instr info changed?
-    fdip_prefetcher.branch_record[ip] = Instr(branch_type, predicted_branch_target,
-                                              predicted_branch_taken, always_taken,
-                                              real_branch_target);
+    fdip_prefetcher.branch_record.insert(ip, Instr(branch_type, predicted_branch_target,
+                                                   predicted_branch_taken, always_taken,
+                                                   real_branch_target));
 }
 
-void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit) {
-    // Called on each cache load
+// Pushes the branches of the block holding v_addr to the predecode queue
+void predecode_block(uint64_t v_addr) {
     auto block_addr = v_addr >> LOG2_BLOCK_SIZE;
     uint8_t offset = pt ? 1 : 4;
     for (uint64_t ip = block_addr << LOG2_BLOCK_SIZE; (ip >> LOG2_BLOCK_SIZE) == block_addr; ip += offset) {
         auto it = fdip_prefetcher.branch_record.find(ip);
-        if (it != fdip_prefetcher.branch_record.end()) {
+        if (it != nullptr) {
             // Is a branch, push to predecode queue
-            fdip_prefetcher.decode_queue.emplace_back(ip, it->second.actual_target,
-                                                      it->second.branch_type, it->second.actual_taken);
+            fdip_prefetcher.decode_queue.push({ip, it->actual_target, it->branch_type, it->actual_taken});
         }
     }
 }
 
+void O3_CPU::l1i_prefetcher_cache_operate(uint64_t v_addr, uint8_t cache_hit, uint8_t prefetch_hit) {
+    // Called on each cache load
+    predecode_block(v_addr);
+}
+
 void O3_CPU::l1i_prefetcher_cycle_operate() {
     // Handle predecode and btb prefetch
-    for (auto &a : fdip_prefetcher.decode_queue) {
-        a.timer++;
-    }
-    while (!fdip_prefetcher.decode_queue.empty() && fdip_prefetcher.decode_queue.front().timer > predecode_latency) {
-        auto &a = fdip_prefetcher.decode_queue.front();
+    fdip_prefetcher.decode_queue.operate([this](const PredecodedBranch &a) {
         prefetch_btb(a.ip, a.target, a.branch_type, a.taken, true);
-        fdip_prefetcher.decode_queue.pop_front();
-    }
+    });
 
     // TODO: Carry out remained shotgun prefetch and push to FTQ if allowed
     while (!fdip_prefetcher.prefetch_queue.empty()) {
@@ -131,35 +122,35 @@ void O3_CPU::l1i_prefetcher_cycle_operate() {
 //    int num_prefetches = 12;
     int prefetch = 0;
     while (prefetch < L1I_PQ_SIZE && fdip_prefetcher.runahead_enable) {
-        // Judge whether runahead_instr_unique_id is in the range of IFETCH_BUFFER
-        bool find_larger = false;
-        for (auto & it : IFETCH_BUFFER) {
-            if (it.instr_id >= fdip_prefetcher.runahead_instr_unique_id)
-                find_larger = true;
-        }
-        if (!find_larger) return;
+        // Judge whether runahead_instr_unique_id is in the range of IFETCH_BUFFER (filled in instr_id order)
+        if (IFETCH_BUFFER.empty() || IFETCH_BUFFER.back().instr_id < fdip_prefetcher.runahead_instr_unique_id) return;
         // Go ahead for prediction and prefetch
         auto it = fdip_prefetcher.branch_record.find(fdip_prefetcher.runahead_ip);
-        if (it != fdip_prefetcher.branch_record.end()) {
+        if (it != nullptr) {
             // Is a branch
-            if (it->second.btb_miss) {
+            if (it->btb_miss) {
                 // BTB miss
                 fdip_prefetcher.FTQ.clear();
                 fdip_prefetcher.runahead_enable = false;
                 return;
-            } else if (it->second.predict_taken) {
+            } else if (it->predict_taken) {
                 // Prefetch target
-                if (!prefetch_code_line(it->second.predict_target)) {
+                if (!prefetch_code_line(it->predict_target)) {
                     // Prefetch queue is full
                     return;
                 }
                 prefetch++;
                 // Prefetch from btb target region!!! Add to prefetch queue!!! Combine with predecode!!!
-                if (it->second.branch_type != BRANCH_CONDITIONAL) {
-                    // Shotgun prefetch
-                    auto &region = shotgun_prefetch_region[it->first];
-                    for (auto a : region) fdip_prefetcher.prefetch_queue.push_back(a);
-                    region.clear();
+                if (it->branch_type != BRANCH_CONDITIONAL) {
+                    // Shotgun prefetch: the footprint blocks go to the L1I, and their branches to the C-BTB
+                    auto region = shotgun_prefetch_region.find(fdip_prefetcher.runahead_ip);
+                    if (region != shotgun_prefetch_region.end()) {
+                        region->second.for_each_block([](uint64_t block_addr) {
+                            fdip_prefetcher.prefetch_queue.push_back(block_addr);
+                            predecode_block(block_addr);
+                        });
+                        shotgun_prefetch_region.erase(region);
+                    }
                     while (!fdip_prefetcher.prefetch_queue.empty()) {
                         if (!prefetch_code_line(fdip_prefetcher.prefetch_queue.front()))
                             break;
@@ -168,7 +159,7 @@ void O3_CPU::l1i_prefetcher_cycle_operate() {
                     }
                 }
                 fdip_prefetcher.FTQ.emplace_back(fdip_prefetcher.runahead_ip, fdip_prefetcher.runahead_instr_unique_id);
-                fdip_prefetcher.runahead_ip = it->second.predict_target;
+                fdip_prefetcher.runahead_ip = it->predict_target;
                 fdip_prefetcher.runahead_instr_unique_id++;
                 // Taken! So directly return
                 return;
@@ -184,7 +175,7 @@ void O3_CPU::l1i_prefetcher_cycle_operate() {
             }
             prefetch++;
         }
-        if (it != fdip_prefetcher.branch_record.end()) {
+        if (it != nullptr) {
             fdip_prefetcher.FTQ.emplace_back(fdip_prefetcher.runahead_ip, fdip_prefetcher.runahead_instr_unique_id);
         }
         fdip_prefetcher.runahead_ip += offset;
@@ -199,6 +190,7 @@ void O3_CPU::l1i_prefetcher_cache_fill(uint64_t v_addr, uint32_t set, uint32_t w
 
 void O3_CPU::l1i_prefetcher_final_stats() {
     cout << "CPU " << cpu << " L1I FDIP final stats" << endl;
+    fdip_prefetcher.branch_record.print_final_stats();
 }
 
 void reset_ftq(ooo_model_instr &instr) {
@@ -215,10 +207,8 @@ void reset_ftq(ooo_model_instr &instr) {
 void O3_CPU::l1i_prefetcher_resolved_branch_operate(ooo_model_instr &instr, bool decode_stage) {
     if (decode_stage) {
         // Only BRANCH_DIRECT_JUMP and BRANCH_DIRECT_CALL
-        auto it = std::find(fdip_prefetcher.FTQ.begin(), fdip_prefetcher.FTQ.end(), std::make_pair(instr.ip, instr.instr_id));
-        if (it != fdip_prefetcher.FTQ.end()) {
+        if (fdip_prefetcher.FTQ.erase_from(instr.ip, instr.instr_id)) {
             instr.pfc_finished = true;
-            fdip_prefetcher.FTQ.erase(it, fdip_prefetcher.FTQ.end());
             reset_ftq(instr);
             fdip_prefetcher.runahead_enable = true;
         }
@@ -0,0 +1,63 @@
+#ifndef CHAMPSIM_PT_FETCH_TARGET_QUEUE_H
+#define CHAMPSIM_PT_FETCH_TARGET_QUEUE_H
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * FDIP fetch target queue: the (ip, instr_id) of every branch the runahead has passed.
+ *
+ * The runahead hands out instr_ids in increasing order and a reset only ever restarts it
+ * after the last entry it keeps, so the queue is sorted by instr_id. An index from instr_id
+ * to ip answers the decode-stage lookup in O(1), and dropping the entries from a found one
+ * to the back pops them off the back, so each entry costs O(1) over its lifetime.
+ */
+class FetchTargetQueue {
+    std::deque<std::pair<uint64_t, uint64_t>> entries; // ip, instr_id
+    std::unordered_map<uint64_t, uint64_t> index; // instr_id -> ip
+
+public:
+    bool empty() const {
+        return entries.empty();
+    }
+
+    const std::pair<uint64_t, uint64_t> &front() const {
+        return entries.front();
+    }
+
+    void emplace_back(uint64_t ip, uint64_t instr_id) {
+        assert(entries.empty() || entries.back().second < instr_id);
+        entries.emplace_back(ip, instr_id);
+        index.emplace(instr_id, ip);
+    }
+
+    void pop_front() {
+        index.erase(entries.front().second);
+        entries.pop_front();
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+    }
+
+    // Drops (ip, instr_id) and every younger entry; returns false if it is not queued.
+    bool erase_from(uint64_t ip, uint64_t instr_id) {
+        auto it = index.find(instr_id);
+        if (it == index.end() || it->second != ip) {
+            return false;
+        }
+        while (entries.back().second != instr_id) {
+            index.erase(entries.back().second);
+            entries.pop_back();
+        }
+        index.erase(instr_id);
+        entries.pop_back();
+        return true;
+    }
+};
+
+#endif //CHAMPSIM_PT_FETCH_TARGET_QUEUE_H
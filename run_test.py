@@ -94,6 +94,70 @@ def get_result_dirname(
     return prefix + (result_dir_template % (program_name, total_btb_ways))
 
 
+# Targets whose BTB replays btb_record_insert_taken, which opt_prepass writes from the trace alone
+OPT_RECORD_TARGETS = ["opt", "opt_insert_taken"]
+
+
+def get_ifetch_buffer_size(run_program: str):
+    # ChampSim_<config>_<target> is built with default_config.cmake overridden by cmake_configs/<config>.cmake
+    config = run_program.split("_")[1]
+    size = None
+    for cmake_file in [project_root / "default_config.cmake", project_root / "cmake_configs" / (config + ".cmake")]:
+        for line in cmake_file.read_text().splitlines():
+            if line.startswith("set(IFETCH_BUFFER_SIZE "):
+                size = line.split()[1].rstrip(")")
+    return size
+
+
+async def execute(program, args, output_file):
+    print(" ".join(args))
+    global workers
+    while workers <= 0:
+        await asyncio.sleep(1)
+
+    workers -= 1
+    p = None
+    try:
+        p = await asyncio.create_subprocess_exec(
+            program, *args, stdout=output_file, stderr=output_file
+        )
+        await asyncio.wait_for(p.communicate(), timeout=TIMEOUT)
+    except asyncio.TimeoutError:
+        print("Error: Timeout!")
+    try:
+        p.kill()
+    except:
+        pass
+
+    workers += 1
+
+
+async def generate_opt_record(trace_file, pt: bool, run_program: str):
+    # Same legacy path as O3_CPU::open_btb_record, named after the trace file (the trace directory for PT)
+    ifetch_buffer_size = get_ifetch_buffer_size(run_program)
+    short_name = Path(trace_file).parent.name if pt else Path(trace_file).name
+    if ifetch_buffer_size != "192":
+        short_name = "fdip%s_%s" % (ifetch_buffer_size, short_name)
+    record_dir = file_root / "btb_record_insert_taken"
+    record_dir.mkdir(exist_ok=True, parents=True)
+    program = str(project_root / "cmake-build-release" / "opt_prepass")
+    args = [
+        "-warmup_instructions",
+        warmup_instructions,
+        "-simulation_instructions",
+        simulation_instructions,
+        "-ifetch_buffer_size",
+        ifetch_buffer_size,
+        "-output",
+        str(record_dir / (short_name + ".txt")),
+    ]
+    if pt:
+        args.extend(["-pt"])
+    args.append(str(trace_file))
+    with (record_dir / (short_name + ".log")).open(mode="w") as output_file:
+        await execute(program, args, output_file)
+
+
 async def run(
         trace_file,
         run_program,
@@ -137,14 +201,10 @@ async def run(
     # TODO: Modify this later
     if run_partial_benchmarks and name in bench:
         return
-    programs = []
-    partial = run_program.split("_")
-    if partial[-1] == "opt" and generate:
-        print("Generate btb record and then run %s" % run_program)
-        programs.append(
-            str(project_root / "cmake-build-release" / (run_program + "_generate"))
-        )
-    programs.append(str(project_root / "cmake-build-release" / run_program))
+    if generate and run_program.split("_", 2)[2] in OPT_RECORD_TARGETS:
+        print("Generate btb record with opt_prepass and then run %s" % run_program)
+        await generate_opt_record(trace_file, pt, run_program)
+    programs = [str(project_root / "cmake-build-release" / run_program)]
     for program in programs:
         # program = str(project_root / "bin" / run_program)
         result_dirname = get_result_dirname(
@@ -213,26 +273,8 @@ async def run(
             args.extend(["-twig_prefetch"])
 
         args.extend(["-traces", str(trace_file)])
-        print(" ".join(args))
-        global workers, count
-        while workers <= 0:
-            await asyncio.sleep(1)
-
-        workers -= 1
-        p = None
-        try:
-            p = await asyncio.create_subprocess_exec(
-                program, *args, stdout=output_file, stderr=output_file
-            )
-            await asyncio.wait_for(p.communicate(), timeout=TIMEOUT)
-        except asyncio.TimeoutError:
-            print("Error: Timeout!")
-        try:
-            p.kill()
-        except:
-            pass
-
-        workers += 1
+        await execute(program, args, output_file)
+        global count
         count += 1
         print("Finish program %s No. %s" % (run_program, count))
 
@@ -3,14 +3,19 @@
 #include <fstream>
 #include <iomanip>
 #include <signal.h>
+#include <sstream>
 #include <vector>
 #include <cstdio>
+#include <cerrno>
+#include <climits>
 
 #include "champsim_constants.h"
 #include "dram_controller.h"
 #include "ooo_cpu.h"
 #include "vmem.h"
 #include "tracereader.h"
+#include "temperature_hint.h"
+#include "branch_outcome_record.h"
 
 #define DRAM_SIZE (DRAM_CHANNELS*DRAM_RANKS*DRAM_BANKS*DRAM_ROWS*DRAM_ROW_SIZE/1024)
 
@@ -38,6 +43,39 @@ string input_generalization = "";
 bool generate_twig_trace = false;
 bool use_twig_prefetcher = false;
 
+bool record_branch_outcomes = false; // Record the direction predictor's output (see branch_outcome_record.h)
+string replay_branch_predictor = "tage-sc-l"; // Predictor whose record the replay predictor streams back
+uint64_t bp_update_delay = 0; // Branches predicted before an outcome trains the predictor tables (the history updates at once), 0 means right away
+
+uint64_t fdip_branch_record_entries = 8192; // FDIP runahead branch record entries (see prefetcher/branch_record.h)
+uint32_t fdip_branch_record_ways = 4; // FDIP runahead branch record associativity
+string fdip_branch_record_policy = "lru"; // FDIP runahead branch record replacement: lru, fifo or random
+
+uint64_t stream_buffer_capacity = 32; // Entries of the BTB prefetch stream buffer
+
+string predecoder_mode = "off"; // BTB prefetching from L1I fills: off, btb or stream_buffer (see predecoder.h)
+uint64_t predecode_bandwidth = 0; // Predecoded branches sent to the BTB per cycle, 0 means no limit
+string predecoder_branch_map = ""; // Static branch map of the binary for the predecoder, empty means learn from the trace
+
+uint64_t shotgun_conditional_btb_sets = 0; // Shotgun C-BTB sets, 0 for the BTB's default
+uint32_t shotgun_conditional_btb_ways = 0; // Shotgun C-BTB ways, 0 for the BTB's default
+uint64_t shotgun_unconditional_btb_sets = 0; // Shotgun U-BTB sets, 0 for the BTB's default
+uint32_t shotgun_unconditional_btb_ways = 0; // Shotgun U-BTB ways, 0 for the BTB's default
+
+uint64_t opt_window = 0; // OPT lookahead in BTB accesses, 0 means the whole record
+
+uint64_t thermometer_sampled_sets = 0; // Online Thermometer OPT sampler sets, 0 means all sets
+uint64_t thermometer_table_entries = 4096; // Online Thermometer temperature table entries
+double thermometer_min_confidence = 0; // Thermometer profile branches below this confidence count as not trained
+uint32_t thermometer_temperature_bits = 0; // Temperature bits per branch in hardware, 0 means exact profile ratios
+uint64_t thermometer_metadata_entries = 0; // Temperature table entries, 0 means hint bits in every branch
+uint32_t thermometer_metadata_ways = 4; // Temperature table associativity
+uint32_t thermometer_tag_bits = 0; // Temperature table partial tag bits, 0 means full tags
+int thermometer_default_category = -1; // Category of branches without temperature, -1 means random
+
+string access_record_format = "full"; // OPT access record output: full, short or rle (see access_record.h)
+string artifact_store = ""; // Root of the generated artifact store (see artifact_store.h), empty means legacy paths
+
 uint64_t warmup_instructions     = 1000000,
          simulation_instructions = 10000000,
          champsim_seed;
@@ -50,8 +88,11 @@ extern VirtualMemory vmem;
 extern std::vector<O3_CPU> ooo_cpu;
 
 extern uint64_t current_core_cycle[NUM_CPUS];
+extern BranchOutcomeRecord branch_outcome_record[NUM_CPUS];
 
 std::vector<tracereader*> traces;
+std::vector<TemperatureHintReader*> temperature_hint_readers; // nullptr for traces without hints
+string temperature_hints = ""; // Comma-separated hint sidecar per trace (temperature_hints tool)
 
 void record_roi_stats(uint32_t cpu, CACHE *cache)
 {
@@ -150,6 +191,8 @@ void print_branch_stats()
 	cout << "BRANCH_INDIRECT_CALL: " << (1000.0*ooo_cpu[i].branch_type_misses[5]/(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr)) << endl;
 	cout << "BRANCH_RETURN: " << (1000.0*ooo_cpu[i].branch_type_misses[6]/(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr)) << endl << endl;
     ooo_cpu[i].btb_final_stats();
+    ooo_cpu[i].predecoder.print_final_stats(i);
+    branch_outcome_record[i].close();
     }
 }
 
@@ -301,9 +344,28 @@ void cpu_l1i_prefetcher_cache_operate(uint32_t cpu_num, uint64_t v_addr, uint8_t
 
 void cpu_l1i_prefetcher_cache_fill(uint32_t cpu_num, uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr)
 {
+  if (ooo_cpu[cpu_num].predecoder.enabled())
+    ooo_cpu[cpu_num].predecoder.fill(addr);
   ooo_cpu[cpu_num].l1i_prefetcher_cache_fill(addr, set, way, prefetch, evicted_addr);
 }
 
+void knob_usage_error(const char *knob, const char *value, const char *expected)
+{
+    cerr << "-" << knob << " " << value << ": expected " << expected << endl;
+    exit(1);
+}
+
+// Parses a decimal knob value in [min, max], or exits with the usage error.
+long parse_knob(const char *knob, const char *value, long min, const char *expected, long max = LONG_MAX)
+{
+    char *end;
+    errno = 0;
+    auto parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || parsed < min || parsed > max)
+        knob_usage_error(knob, value, expected);
+    return parsed;
+}
+
 int main(int argc, char** argv)
 {
 	// interrupt signal hanlder
@@ -345,6 +407,32 @@ int main(int argc, char** argv)
             {"input_generalization", required_argument, 0, 'g'},
             {"twig", no_argument, 0, '0'},
             {"twig_prefetch", no_argument, 0, '1'},
+            {"opt_window", required_argument, 0, 'o'},
+            {"thermometer_sampled_sets", required_argument, 0, '2'},
+            {"thermometer_table_entries", required_argument, 0, '3'},
+            {"thermometer_min_confidence", required_argument, 0, '4'},
+            {"thermometer_temperature_bits", required_argument, 0, '5'},
+            {"thermometer_metadata_entries", required_argument, 0, '6'},
+            {"thermometer_metadata_ways", required_argument, 0, '7'},
+            {"thermometer_tag_bits", required_argument, 0, '8'},
+            {"thermometer_default_category", required_argument, 0, '9'},
+            {"temperature_hints", required_argument, 0, 'A'},
+            {"access_record_format", required_argument, 0, 'B'},
+            {"artifact_store", required_argument, 0, 'C'},
+            {"record_branch_outcomes", no_argument, 0, 'D'},
+            {"replay_branch_predictor", required_argument, 0, 'E'},
+            {"bp_update_delay", required_argument, 0, 'F'},
+            {"fdip_branch_record_entries", required_argument, 0, 'G'},
+            {"fdip_branch_record_ways", required_argument, 0, 'H'},
+            {"fdip_branch_record_policy", required_argument, 0, 'I'},
+            {"shotgun_conditional_btb_sets", required_argument, 0, 'J'},
+            {"shotgun_conditional_btb_ways", required_argument, 0, 'K'},
+            {"shotgun_unconditional_btb_sets", required_argument, 0, 'L'},
+            {"shotgun_unconditional_btb_ways", required_argument, 0, 'M'},
+            {"predecoder", required_argument, 0, 'N'},
+            {"predecode_bandwidth", required_argument, 0, 'O'},
+            {"predecoder_branch_map", required_argument, 0, 'P'},
+            {"stream_buffer_capacity", required_argument, 0, 'Q'},
 //            {"use_default_btb_record", no_argument, 0, 'd'},
             {0, 0, 0, 0}      
         };
@@ -422,6 +510,102 @@ int main(int argc, char** argv)
             case '1':
                 use_twig_prefetcher = true;
                 break;
+            case 'o':
+                opt_window = atol(optarg);
+                cout << "opt_window " << opt_window << endl;
+                break;
+            case '2':
+                thermometer_sampled_sets = atol(optarg);
+                break;
+            case '3':
+                thermometer_table_entries = atol(optarg);
+                break;
+            case '4':
+                thermometer_min_confidence = atof(optarg);
+                break;
+            case '5':
+                thermometer_temperature_bits = atoi(optarg);
+                break;
+            case '6':
+                thermometer_metadata_entries = atol(optarg);
+                break;
+            case '7':
+                thermometer_metadata_ways = atoi(optarg);
+                break;
+            case '8':
+                thermometer_tag_bits = atoi(optarg);
+                break;
+            case '9':
+                thermometer_default_category = (int) parse_knob("thermometer_default_category", optarg, -1,
+                                                                "-1 (random) or a category index",
+                                                                temperature_hint::CATEGORY_MASK);
+                break;
+            case 'A':
+                temperature_hints = optarg;
+                break;
+            case 'B':
+                access_record_format = optarg;
+                if (access_record_format != "full" && access_record_format != "short" && access_record_format != "rle")
+                    knob_usage_error("access_record_format", optarg, "full, short or rle");
+                break;
+            case 'C':
+                artifact_store = optarg;
+                break;
+            case 'D':
+                record_branch_outcomes = true;
+                break;
+            case 'E':
+                replay_branch_predictor = optarg;
+                break;
+            case 'F':
+                bp_update_delay = parse_knob("bp_update_delay", optarg, 0, "a number of branches");
+                break;
+            case 'G':
+                fdip_branch_record_entries = parse_knob("fdip_branch_record_entries", optarg, 1,
+                                                        "a positive number of entries");
+                break;
+            case 'H':
+                fdip_branch_record_ways = parse_knob("fdip_branch_record_ways", optarg, 1, "a positive number of ways");
+                break;
+            case 'I':
+                fdip_branch_record_policy = optarg;
+                if (fdip_branch_record_policy != "lru" && fdip_branch_record_policy != "fifo" &&
+                    fdip_branch_record_policy != "random")
+                    knob_usage_error("fdip_branch_record_policy", optarg, "lru, fifo or random");
+                break;
+            case 'J':
+                shotgun_conditional_btb_sets = parse_knob("shotgun_conditional_btb_sets", optarg, 1,
+                                                          "a positive number of sets");
+                break;
+            case 'K':
+                shotgun_conditional_btb_ways = parse_knob("shotgun_conditional_btb_ways", optarg, 1,
+                                                          "a positive number of ways");
+                break;
+            case 'L':
+                shotgun_unconditional_btb_sets = parse_knob("shotgun_unconditional_btb_sets", optarg, 1,
+                                                            "a positive number of sets");
+                break;
+            case 'M':
+                shotgun_unconditional_btb_ways = parse_knob("shotgun_unconditional_btb_ways", optarg, 1,
+                                                            "a positive number of ways");
+                break;
+            case 'N': {
+                Predecoder::Mode mode;
+                predecoder_mode = optarg;
+                if (!Predecoder::parse_mode(predecoder_mode, mode))
+                    knob_usage_error("predecoder", optarg, "off, btb or stream_buffer");
+                break;
+            }
+            case 'O':
+                predecode_bandwidth = parse_knob("predecode_bandwidth", optarg, 0, "a number of branches per cycle");
+                break;
+            case 'P':
+                predecoder_branch_map = optarg;
+                break;
+            case 'Q':
+                stream_buffer_capacity = parse_knob("stream_buffer_capacity", optarg, 1,
+                                                    "a positive number of entries");
+                break;
             default:
                 abort();
         }
@@ -503,6 +687,20 @@ int main(int argc, char** argv)
         printf("\n*** Not enough traces for the configured number of cores ***\n\n");
         assert(0);
     }
+
+    // Temperature hint sidecars, in the same order as the traces
+    std::stringstream temperature_hints_stream(temperature_hints);
+    string temperature_hint_path;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        TemperatureHintReader *reader = nullptr;
+        if (std::getline(temperature_hints_stream, temperature_hint_path, ',') && !temperature_hint_path.empty()) {
+            cout << "CPU " << i << " temperature hints " << temperature_hint_path << endl;
+            reader = new TemperatureHintReader();
+            bool opened = reader->open(temperature_hint_path.c_str());
+            assert(opened);
+        }
+        temperature_hint_readers.push_back(reader);
+    }
     // end trace file setup
 
     srand(seed_number);
@@ -590,6 +788,8 @@ int main(int argc, char** argv)
               do {
                   instr = traces[i]->get();
                   assert(instr.ip != 0);
+                  if (temperature_hint_readers[i] != nullptr)
+                      instr.temperature_hint = temperature_hint_readers[i]->get();
 //                  if (instr.ip == 0) {
 //                      instr = traces[i]->get();
 //                  }
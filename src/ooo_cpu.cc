@@ -1,12 +1,15 @@
 #include <algorithm>
+#include <sstream>
 #include <vector>
 
 #include "ooo_cpu.h"
 #include "instruction.h"
+#include "tracereader.h"
 #include "set.h"
 #include "vmem.h"
 #include "twig_profile.h"
 #include "twig_prefetcher.h"
+#include "branch_outcome_record.h"
 #include <boost/filesystem.hpp>
 
 namespace fs = boost::filesystem;
@@ -25,14 +28,27 @@ extern string input_generalization;
 
 extern bool generate_twig_trace;
 extern bool use_twig_prefetcher;
+extern bool record_branch_outcomes;
+extern uint64_t bp_update_delay;
+extern uint8_t predecode_latency;
+extern string predecoder_mode;
+extern uint64_t predecode_bandwidth;
+extern string predecoder_branch_map;
 
 extern VirtualMemory vmem;
 
 TwigRecord twig_record;
 TwigPrefetcher twig_prefetcher;
+BranchOutcomeRecord branch_outcome_record[NUM_CPUS];
 
 std::string O3_CPU::find_trace_short_name(std::string &full_path, O3_CPU::NameKind name_kind) {
     fs::path p = full_path;
+    if (name_kind != O3_CPU::NameKind::TRACE && input_generalization.find(',') != string::npos) {
+        // Only hot_warm_cold_btb merges several training profiles (see find_train_short_names).
+        cerr << "-input_generalization " << input_generalization
+             << ": this binary reads or writes a single training input" << endl;
+        exit(1);
+    }
     if (!input_generalization.empty()) {
         auto input_num = string(p.stem().c_str());
         auto app_name = string(p.parent_path().parent_path().filename().c_str());
@@ -50,10 +66,35 @@ std::string O3_CPU::find_trace_short_name(std::string &full_path, O3_CPU::NameKi
     }
 }
 
+std::vector<std::string> O3_CPU::find_train_short_names(std::string &full_path) {
+    std::vector<std::string> short_names;
+    if (input_generalization.find(',') == string::npos) {
+        short_names.push_back(find_trace_short_name(full_path, O3_CPU::NameKind::TRAIN));
+        return short_names;
+    }
+    fs::path p = full_path;
+    auto app_name = string(p.parent_path().parent_path().filename().c_str());
+    std::stringstream inputs(input_generalization);
+    string input;
+    while (std::getline(inputs, input, ',')) {
+        if (!input.empty())
+            short_names.push_back(app_name + "_train_" + input);
+    }
+    return short_names;
+}
+
 void O3_CPU::initialize_core() {
-    auto short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRAIN);
-    twig_record.init(short_name, generate_twig_trace);
+    // Twig records are per training input, so only name one when Twig is used.
+    string short_name;
+    if (generate_twig_trace || use_twig_prefetcher)
+        short_name = O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRAIN);
+    twig_record.init(short_name, generate_twig_trace, warmup_instructions, simulation_instructions);
     twig_prefetch_match = twig_prefetcher.init(short_name, use_twig_prefetcher);
+    if (record_branch_outcomes)
+        branch_outcome_record[cpu].open_record(O3_CPU::find_trace_short_name(trace_name, O3_CPU::NameKind::TRACE),
+                                               branch_predictor_name(), cpu, warmup_instructions,
+                                               simulation_instructions, bp_update_delay);
+    predecoder.init(cpu, predecoder_mode, predecode_latency, predecode_bandwidth, predecoder_branch_map);
 }
 
 uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
@@ -72,11 +113,7 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
     arch_instr.instr_id = instr_unique_id;
 
     if (!pt) {
-        bool reads_sp = false;
         bool writes_sp = false;
-        bool reads_flags = false;
-        bool reads_ip = false;
-        bool writes_ip = false;
         bool reads_other = false;
 
         for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
@@ -86,9 +123,6 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
                 case REG_STACK_POINTER:
                     writes_sp = true;
                     break;
-                case REG_INSTRUCTION_POINTER:
-                    writes_ip = true;
-                    break;
                 default:
                     break;
             }
@@ -127,13 +161,8 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
                 case 0:
                     break;
                 case REG_STACK_POINTER:
-                    reads_sp = true;
-                    break;
                 case REG_FLAGS:
-                    reads_flags = true;
-                    break;
                 case REG_INSTRUCTION_POINTER:
-                    reads_ip = true;
                     break;
                 default:
                     reads_other = true;
@@ -157,49 +186,10 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
             arch_instr.is_memory = 1;
 
         // determine what kind of branch this is, if any
-        if (!reads_sp && !reads_flags && writes_ip && !reads_other) {
-            // direct jump
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = 1;
-            arch_instr.branch_type = BRANCH_DIRECT_JUMP;
-        } else if (!reads_sp && !reads_flags && writes_ip && reads_other) {
-            // indirect branch
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = 1;
-            arch_instr.branch_type = BRANCH_INDIRECT;
-        } else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other) {
-            // conditional branch
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-            arch_instr.branch_type = BRANCH_CONDITIONAL;
-        } else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other) {
-            // direct call
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = 1;
-            arch_instr.branch_type = BRANCH_DIRECT_CALL;
-        } else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other) {
-            // indirect call
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = 1;
-            arch_instr.branch_type = BRANCH_INDIRECT_CALL;
-        } else if (reads_sp && !reads_ip && writes_sp && writes_ip) {
-            // return
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = 1;
-            arch_instr.branch_type = BRANCH_RETURN;
-        } else if (writes_ip) {
-            // some other branch type that doesn't fit the above categories
-            arch_instr.is_branch = 1;
-            arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-            arch_instr.branch_type = BRANCH_OTHER;
-        }
+        classify_branch(arch_instr);
 
         total_branch_types[arch_instr.branch_type]++;
 
-        if ((arch_instr.is_branch != 1) || (arch_instr.branch_taken != 1)) {
-            // clear the branch target for this instruction
-            arch_instr.branch_target = 0;
-        }
         if (arch_instr.branch_type == BRANCH_RETURN || arch_instr.branch_type == BRANCH_INDIRECT ||
             arch_instr.branch_type == BRANCH_INDIRECT_CALL) {
             assert(arch_instr.branch_target != 0);
@@ -249,6 +239,7 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
         }
         uint8_t branch_prediction = predict_branch(arch_instr.ip, predicted_branch_target, always_taken,
                                                    arch_instr.branch_type);
+        branch_outcome_record[cpu].record(branch_prediction);
         if (perfect_bpu) {
             predicted_branch_target = arch_instr.branch_target;
             branch_prediction = arch_instr.branch_taken;
@@ -276,6 +267,8 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
         l1i_prefetcher_branch_operate(arch_instr.ip, arch_instr.branch_type, predicted_branch_target,
                                       branch_prediction != 0, always_taken != 0,
                                       arch_instr.branch_target);
+        if (predecoder.enabled())
+            predecoder.branch_operate(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_type);
 
         if (predicted_branch_target != arch_instr.branch_target) {
             branch_mispredictions++;
@@ -294,8 +287,23 @@ uint32_t O3_CPU::init_instruction(ooo_model_instr arch_instr) {
             }
         }
 
-        update_btb(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken, arch_instr.branch_type);
-        last_branch_result(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken, arch_instr.branch_type);
+        update_btb(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken, arch_instr.branch_type,
+                   arch_instr.temperature_hint);
+        if (bp_update_delay == 0) {
+            last_branch_result(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken,
+                               arch_instr.branch_type);
+        } else {
+            // the history is updated now; the tables train once bp_update_delay more branches are predicted
+            update_branch_history(arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken,
+                                  arch_instr.branch_type);
+            bp_update_queue.push_back({arch_instr.ip, arch_instr.branch_target, arch_instr.branch_taken,
+                                       arch_instr.branch_type});
+            if (bp_update_queue.size() > bp_update_delay) {
+                auto &update = bp_update_queue.front();
+                train_branch(update.ip, update.branch_target, update.taken, update.branch_type);
+                bp_update_queue.pop_front();
+            }
+        }
 
 //        assert((arch_instr.branch_target != 0 && arch_instr.branch_taken == 1) ||
 //               (arch_instr.branch_target == 0 && arch_instr.branch_taken == 0));
@@ -1610,6 +1618,11 @@ void O3_CPU::operate_cache() {
 
     // also handle per-cycle prefetcher operation
     l1i_prefetcher_cycle_operate();
+    if (predecoder.enabled()) {
+        predecoder.operate([this](const PredecodedBranch &branch) {
+            prefetch_btb(branch.ip, branch.target, branch.branch_type, branch.taken, predecoder.to_stream_buffer());
+        });
+    }
 }
 
 void O3_CPU::complete_inflight_instruction() {
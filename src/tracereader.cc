@@ -18,6 +18,8 @@ using std::cout;
 using std::endl;
 using std::cerr;
 
+extern uint8_t MAX_INSTR_DESTINATIONS;
+
 static bool xedInitDone = false;
 //static size_t line_count = 0;
 
@@ -409,6 +411,91 @@ public:
     }
 };
 
+void classify_branch(ooo_model_instr &arch_instr) {
+    bool reads_sp = false;
+    bool writes_sp = false;
+    bool reads_flags = false;
+    bool reads_ip = false;
+    bool writes_ip = false;
+    bool reads_other = false;
+
+    for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++) {
+        switch (arch_instr.destination_registers[i]) {
+            case 0:
+                break;
+            case REG_STACK_POINTER:
+                writes_sp = true;
+                break;
+            case REG_INSTRUCTION_POINTER:
+                writes_ip = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (int i = 0; i < NUM_INSTR_SOURCES; i++) {
+        switch (arch_instr.source_registers[i]) {
+            case 0:
+                break;
+            case REG_STACK_POINTER:
+                reads_sp = true;
+                break;
+            case REG_FLAGS:
+                reads_flags = true;
+                break;
+            case REG_INSTRUCTION_POINTER:
+                reads_ip = true;
+                break;
+            default:
+                reads_other = true;
+                break;
+        }
+    }
+
+    if (!reads_sp && !reads_flags && writes_ip && !reads_other) {
+        // direct jump
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = 1;
+        arch_instr.branch_type = BRANCH_DIRECT_JUMP;
+    } else if (!reads_sp && !reads_flags && writes_ip && reads_other) {
+        // indirect branch
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = 1;
+        arch_instr.branch_type = BRANCH_INDIRECT;
+    } else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other) {
+        // conditional branch
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
+        arch_instr.branch_type = BRANCH_CONDITIONAL;
+    } else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other) {
+        // direct call
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = 1;
+        arch_instr.branch_type = BRANCH_DIRECT_CALL;
+    } else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other) {
+        // indirect call
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = 1;
+        arch_instr.branch_type = BRANCH_INDIRECT_CALL;
+    } else if (reads_sp && !reads_ip && writes_sp && writes_ip) {
+        // return
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = 1;
+        arch_instr.branch_type = BRANCH_RETURN;
+    } else if (writes_ip) {
+        // some other branch type that doesn't fit the above categories
+        arch_instr.is_branch = 1;
+        arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
+        arch_instr.branch_type = BRANCH_OTHER;
+    }
+
+    if ((arch_instr.is_branch != 1) || (arch_instr.branch_taken != 1)) {
+        // clear the branch target for this instruction
+        arch_instr.branch_target = 0;
+    }
+}
+
 tracereader *get_tracereader(std::string fname, uint8_t cpu, bool is_cloudsuite, bool is_pt) {
     if (is_cloudsuite) {
         return new cloudsuite_tracereader(cpu, fname);
@@ -0,0 +1,139 @@
+/*
+ * Randomized check of StreamBuffer (btb/prefetch_stream_buffer.h).
+ *
+ * StreamBuffer keeps its FIFO in linked slots with an open-addressing ip index. This tool
+ * compares it with the deque it replaced (a linear scan for every predict and update) on
+ * random prefetch, predict and update sequences over few ips, so repeated prefetches of one
+ * ip, evictions and index collisions all happen often. It exits with 1 on the first mismatch.
+ *
+ * Usage: stream_buffer_check [-seed N] [-rounds N]
+ */
+
+#include <getopt.h>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+uint64_t stream_buffer_capacity = 32;
+
+#include "../btb/prefetch_stream_buffer.h"
+
+// The deque implementation StreamBuffer replaced.
+class ReferenceStreamBuffer {
+    std::deque<pair<uint64_t, uint64_t>> buffer; // first is ip and second is target
+    uint64_t capacity;
+
+public:
+    ReferenceStreamBuffer(uint64_t capacity) : capacity(capacity) {}
+
+    void prefetch(uint64_t ip, uint64_t target) {
+        if (buffer.size() >= capacity) {
+            buffer.pop_front();
+        }
+        buffer.emplace_back(ip, target);
+    }
+
+    uint64_t stream_buffer_predict(uint64_t ip) {
+        for (auto &a : buffer) {
+            if (a.first == ip) {
+                return a.second;
+            }
+        }
+        return 0;
+    }
+
+    uint64_t stream_buffer_update(uint64_t ip) {
+        for (auto it = buffer.begin(); it != buffer.end(); it++) {
+            if (it->first == ip) {
+                auto target = it->second;
+                buffer.erase(it);
+                return target;
+            }
+        }
+        return 0;
+    }
+};
+
+// One random operation sequence; returns false on a mismatch.
+bool check_round(std::mt19937_64 &rng, uint64_t round) {
+    const uint64_t capacity = 1 + rng() % 64;
+    const uint64_t num_ips = 1 + rng() % (3 * capacity + 5);
+    const uint64_t num_operations = 1 + rng() % 20000;
+
+    StreamBuffer buffer;
+    buffer.init(capacity);
+    ReferenceStreamBuffer reference(capacity);
+    for (uint64_t i = 0; i < num_operations; i++) {
+        uint64_t ip = 0x400000 + (rng() % num_ips) * 4;
+        uint64_t expected = 0, actual = 0;
+        switch (rng() % 3) {
+            case 0: {
+                uint64_t target = rng() | 1;
+                buffer.prefetch(ip, target);
+                reference.prefetch(ip, target);
+                continue;
+            }
+            case 1:
+                expected = reference.stream_buffer_predict(ip);
+                actual = buffer.stream_buffer_predict(ip);
+                break;
+            default:
+                expected = reference.stream_buffer_update(ip);
+                actual = buffer.stream_buffer_update(ip);
+                break;
+        }
+        if (expected != actual) {
+            cerr << "Round " << round << ": capacity " << capacity << " operation " << i << " ip " << std::hex
+                 << ip << " expected " << expected << " got " << actual << std::dec << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint64_t seed = 1, rounds = 200;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"seed", required_argument, 0, 's'},
+            {"rounds", required_argument, 0, 'r'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 's':
+                seed = atol(optarg);
+                break;
+            case 'r':
+                rounds = atol(optarg);
+                break;
+            default:
+                abort();
+        }
+    }
+
+    std::mt19937_64 rng(seed);
+    for (uint64_t round = 0; round < rounds; round++) {
+        if (!check_round(rng, round)) {
+            return 1;
+        }
+    }
+    cout << "StreamBuffer matches the reference in " << rounds << " rounds" << endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Thermometer trace annotation.
+ *
+ * Temperatures are static per branch IP, so they can travel with the trace like hint bits a
+ * compiler would put into branch instructions. This tool walks the trace with the same reader
+ * as the simulator and writes one hint byte per instruction (inc/temperature_hint.h): the
+ * category of every branch under the given category boundaries, which must match the BTB
+ * setting (e.g. 0.5,0.8 for hot_warm_cold 80_50), and with -bypass also a bypass hint for
+ * branches OPT never hits. The simulator reads the sidecar with -temperature_hints.
+ *
+ * The hints cover warmup + simulation instructions; the few instructions the simulator
+ * fetches beyond them fall back to the profile.
+ *
+ * Usage: temperature_hints [-pt] [-cloudsuite] [-bypass] -warmup_instructions N
+ *                          -simulation_instructions N -profile <profile> -boundaries <b0,b1,...>
+ *                          -output <hints.gz> <trace>
+ */
+
+#include <getopt.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tracereader.h"
+#include "temperature_hint.h"
+#include "../btb/thermometer_profile.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+uint8_t MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS;
+
+int main(int argc, char **argv) {
+    uint64_t warmup_instructions = 0, simulation_instructions = 0;
+    bool knob_cloudsuite = false, pt = false, bypass = false;
+    string output, profile_path, boundaries_arg = "0.5,0.8";
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"warmup_instructions", required_argument, 0, 'w'},
+            {"simulation_instructions", required_argument, 0, 'i'},
+            {"cloudsuite", no_argument, 0, 'c'},
+            {"pt", no_argument, 0, 'p'},
+            {"profile", required_argument, 0, 'r'},
+            {"boundaries", required_argument, 0, 'b'},
+            {"bypass", no_argument, 0, 'y'},
+            {"output", required_argument, 0, 'o'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'w':
+                warmup_instructions = atol(optarg);
+                break;
+            case 'i':
+                simulation_instructions = atol(optarg);
+                break;
+            case 'c':
+                knob_cloudsuite = true;
+                MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS_SPARC;
+                break;
+            case 'p':
+                pt = true;
+                break;
+            case 'r':
+                profile_path = optarg;
+                break;
+            case 'b':
+                boundaries_arg = optarg;
+                break;
+            case 'y':
+                bypass = true;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                abort();
+        }
+    }
+
+    if (optind != argc - 1 || output.empty() || profile_path.empty() ||
+        warmup_instructions + simulation_instructions == 0) {
+        cerr << "Usage: " << argv[0] << " [-pt] [-cloudsuite] [-bypass] -warmup_instructions N"
+             << " -simulation_instructions N -profile <profile> -boundaries <b0,b1,...>"
+             << " -output <hints.gz> <trace>" << endl;
+        return 1;
+    }
+
+    std::vector<double> boundaries;
+    std::stringstream boundaries_stream(boundaries_arg);
+    string boundary;
+    while (std::getline(boundaries_stream, boundary, ',')) {
+        boundaries.push_back(atof(boundary.c_str()));
+    }
+    assert(!boundaries.empty() && boundaries.size() <= temperature_hint::CATEGORY_MASK);
+
+    ThermometerProfile profile;
+    if (!profile.load(profile_path.c_str())) {
+        cerr << "Cannot read " << profile_path << endl;
+        return 1;
+    }
+
+    TemperatureHintWriter writer;
+    if (!writer.open(output.c_str())) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+
+    // The trace readers rewind at the end of the trace, so the instruction count bounds the walk.
+    auto total_instructions = warmup_instructions + simulation_instructions;
+    tracereader *reader = get_tracereader(argv[optind], 0, knob_cloudsuite, pt);
+
+    uint64_t branches = 0, untrained = 0, bypassed = 0;
+    std::vector<uint64_t> category_count(boundaries.size() + 1, 0);
+    for (uint64_t i = 0; i < total_instructions; i++) {
+        auto arch_instr = reader->get();
+        if (!pt)
+            classify_branch(arch_instr);
+        if (!arch_instr.is_branch) {
+            writer.append(0);
+            continue;
+        }
+        branches++;
+        uint8_t hint = temperature_hint::VALID;
+        double ratio;
+        if (!profile.lookup(arch_instr.ip, ratio)) {
+            hint |= temperature_hint::UNTRAINED;
+            untrained++;
+        } else {
+            // Same categories as HotWarmCold::judge_candidate_type
+            uint8_t category = 0;
+            while (category < boundaries.size() && ratio > boundaries[category]) category++;
+            hint |= category;
+            category_count[category]++;
+            if (bypass && ratio == 0) {
+                hint |= temperature_hint::BYPASS;
+                bypassed++;
+            }
+        }
+        writer.append(hint);
+    }
+    writer.close();
+
+    cout << "Instructions: " << total_instructions << " branches: " << branches
+         << " untrained: " << untrained << " bypass: " << bypassed;
+    for (uint64_t i = 0; i < category_count.size(); i++) {
+        cout << " category " << i << ": " << category_count[i];
+    }
+    cout << endl;
+    return 0;
+}
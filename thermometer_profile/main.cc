@@ -0,0 +1,133 @@
+/*
+ * Thermometer profile converter and merger.
+ *
+ * Thermometer (hot_warm_cold BTBs) only needs the hit-to-taken ratio of each branch under
+ * OPT, but the OPT access record CSV lists every access. This tool reduces records to the
+ * binary profile in btb/thermometer_profile.h. init_record() picks up <trace>.bin next to
+ * <trace>.csv, so converting once skips the CSV parsing in every later simulation.
+ *
+ * With several inputs (CSV records or binary profiles, each optionally weighted with
+ * :<weight>), the profiles are merged by adding their counts, so every input counts in
+ * proportion to the dynamic count of each branch. -normalize weights every input so that
+ * it has the same total dynamic count. -update <profile> adds the inputs to an existing
+ * (merged) profile in place, which is the same as merging all inputs again.
+ *
+ * Usage: thermometer_profile -output <profile.bin> [-normalize] <input>[:<weight>] ...
+ *        thermometer_profile -update <profile.bin> [-normalize] <input>[:<weight>] ...
+ */
+
+#include <getopt.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../btb/thermometer_profile.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+struct ProfileInput {
+    string path;
+    double weight = 1.0;
+    vector<ThermometerProfileEntry> entries;
+    uint64_t inputs = 1;
+    double total_access = 0;
+};
+
+int main(int argc, char **argv) {
+    string output;
+    bool update = false, normalize = false;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"output", required_argument, 0, 'o'},
+            {"update", required_argument, 0, 'u'},
+            {"normalize", no_argument, 0, 'n'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'u':
+                output = optarg;
+                update = true;
+                break;
+            case 'n':
+                normalize = true;
+                break;
+            default:
+                abort();
+        }
+    }
+
+    if (optind >= argc || output.empty()) {
+        cerr << "Usage: " << argv[0] << " -output <profile.bin> [-normalize] <input>[:<weight>] ..." << endl
+             << "       " << argv[0] << " -update <profile.bin> [-normalize] <input>[:<weight>] ..." << endl;
+        return 1;
+    }
+
+    vector<ProfileInput> inputs;
+    FILE *existing = update ? fopen(output.c_str(), "rb") : nullptr;
+    if (existing != nullptr) {
+        // A missing profile is created from the new inputs.
+        fclose(existing);
+        inputs.emplace_back();
+        inputs.back().path = output;
+    }
+    for (int i = optind; i < argc; i++) {
+        inputs.emplace_back();
+        string arg = argv[i];
+        auto colon = arg.rfind(':');
+        if (colon != string::npos) {
+            inputs.back().weight = atof(arg.substr(colon + 1).c_str());
+            arg = arg.substr(0, colon);
+        }
+        inputs.back().path = arg;
+    }
+
+    double total_access = 0;
+    uint64_t total_inputs = 0;
+    for (auto &input : inputs) {
+        if (!ThermometerProfile::read(input.path.c_str(), input.entries, input.inputs)) {
+            cerr << "Cannot read " << input.path << endl;
+            return 1;
+        }
+        for (auto &entry : input.entries) input.total_access += entry.access;
+        total_access += input.total_access;
+        total_inputs += input.inputs;
+        cout << "Input " << input.path << ": " << input.entries.size() << " branches, "
+             << input.inputs << " inputs, " << (uint64_t) input.total_access << " accesses" << endl;
+    }
+
+    ThermometerProfileMerger merger;
+    for (auto &input : inputs) {
+        auto weight = input.weight;
+        if (normalize && input.total_access > 0) {
+            // Same dynamic count per input; a merged profile stands for several inputs.
+            weight *= (total_access / (double) total_inputs) * (double) input.inputs / input.total_access;
+        }
+        merger.add(input.entries, input.inputs, weight);
+    }
+    vector<ThermometerProfileEntry> entries;
+    merger.finish(entries);
+
+    if (!ThermometerProfile::write(output.c_str(), entries, merger.input_count())) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    cout << "Thermometer profile: " << entries.size() << " branches, " << merger.input_count() << " inputs, "
+         << ThermometerProfile::file_size(entries.size()) << " bytes" << endl;
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Twig profile converter.
+ *
+ * -footprint converts a text Twig footprint (footprint.txt) into the binary footprint in
+ * inc/twig_footprint.h. TwigPrefetcher picks up footprint.bin next to footprint.txt, so
+ * converting once replaces the text parse in every later -twig_prefetch run.
+ *
+ * -dump prints a binary Twig BTB log written by -twig (inc/twig_log.h) as the text lines the
+ * Twig analysis reads, e.g. twig_profile -dump <trace>.gz | awk ...
+ *
+ * Usage: twig_profile -footprint <footprint.bin> <footprint.txt>
+ *        twig_profile -dump <twig_record.gz>
+ */
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "twig_footprint.h"
+#include "twig_log.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+
+int main(int argc, char **argv) {
+    string footprint_output;
+    bool dump = false;
+
+    int c;
+    while (true) {
+        static struct option long_options[] =
+        {
+            {"footprint", required_argument, 0, 'f'},
+            {"dump", no_argument, 0, 'd'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'f':
+                footprint_output = optarg;
+                break;
+            case 'd':
+                dump = true;
+                break;
+            default:
+                abort();
+        }
+    }
+
+    if (optind + 1 != argc || footprint_output.empty() == !dump) {
+        cerr << "Usage: " << argv[0] << " -footprint <footprint.bin> <footprint.txt>" << endl
+             << "       " << argv[0] << " -dump <twig_record.gz>" << endl;
+        return 1;
+    }
+
+    if (dump) {
+        TwigLogReader reader;
+        if (!reader.open(argv[optind])) {
+            cerr << "Cannot read Twig log " << argv[optind] << endl;
+            return 1;
+        }
+        TwigLogRecord record;
+        while (reader.next(record)) {
+            TwigLogReader::print(record, stdout);
+        }
+        return 0;
+    }
+
+    TwigFootprint footprint;
+    if (!footprint.load(argv[optind])) {
+        cerr << "Cannot read " << argv[optind] << endl;
+        return 1;
+    }
+    if (!footprint.write(footprint_output.c_str())) {
+        cerr << "Cannot write " << footprint_output << endl;
+        return 1;
+    }
+    cout << "Twig footprint: " << footprint.function_count() << " functions, " << footprint.entry_count()
+         << " entries" << endl;
+    return 0;
+}